@@ -104,6 +104,7 @@ int main(int, char**) {
     // create a "program" from the parsed keywords
     LG_ProgramOptions opts;
     opts.DeterminizeDepth = UINT32_MAX;
+    opts.Partitions = 1;
 
     LG_HPROGRAM prog = lg_create_program(fsm, &opts);
     if (!prog) {
@@ -116,6 +117,11 @@ int main(int, char**) {
 
     // create a search context
     LG_ContextOptions ctxOpts;
+    ctxOpts.TraceBegin = UINT64_MAX;
+    ctxOpts.TraceEnd = UINT64_MAX;
+    ctxOpts.DedupThreads = 0;
+    ctxOpts.MaxThreads = 0;
+
     LG_HCONTEXT searcher = lg_create_context(prog, &ctxOpts);
 
     char filesigText[] = "lambs love mary.";
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "lightgrep/api.h"
+
+//
+// The library's memory comes through the hooks set by lg_set_allocator(),
+// which default to malloc and free.
+//
+
+// size bytes, aligned for any type; throws std::bad_alloc on failure
+void* lgAlloc(size_t size);
+
+void lgFree(void* p, size_t size);
+
+// As lgAlloc, but blocks of at least LG_Allocator::HugePageMin bytes are
+// mapped from the system and marked to be backed by huge pages, for
+// programs and search state large enough to miss the TLB. Must be freed
+// by lgFreeLarge(), with the same size, which frees each block the way it
+// was allocated even if HugePageMin has changed since.
+void* lgAllocLarge(size_t size);
+
+void lgFreeLarge(void* p, size_t size);
+
+// As lgAlloc, but the block records its size, for memory which the C API
+// hands out and is given back without one
+void* lgAllocSized(size_t size);
+
+void lgFreeSized(void* p);
+
+// A copy of s, to be freed by lgFreeSized(); null on failure
+char* clone_c_str(const char* s);
+
+//
+// Base for the handles, so that they are allocated through the hooks. T
+// is the handle, whose size the nothrow delete needs, as it is not given
+// one.
+//
+template <class T>
+struct HookAllocated {
+  static void* operator new(size_t size) {
+    return lgAlloc(size);
+  }
+
+  static void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+      return lgAlloc(size);
+    }
+    catch (const std::bad_alloc&) {
+      return nullptr;
+    }
+  }
+
+  static void operator delete(void* p, size_t size) noexcept {
+    lgFree(p, size);
+  }
+
+  // called if the constructor throws after the nothrow new
+  static void operator delete(void* p, const std::nothrow_t&) noexcept {
+    lgFree(p, sizeof(T));
+  }
+};
+
+//
+// Standard allocator over lgAllocLarge(), for containers which can grow
+// large during a search
+//
+template <class T>
+struct HookAllocator {
+  typedef T value_type;
+
+  HookAllocator() = default;
+
+  template <class U>
+  HookAllocator(const HookAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(lgAllocLarge(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t n) {
+    lgFreeLarge(p, n * sizeof(T));
+  }
+
+  template <class U>
+  bool operator==(const HookAllocator<U>&) const { return true; }
+
+  template <class U>
+  bool operator!=(const HookAllocator<U>&) const { return false; }
+};
+
+//
+// Bump allocation for objects which all live as long as the arena, such
+// as those made while compiling an automaton. Blocks are taken through
+// the hooks, growing from small to BlockMax, and freed all at once with
+// the arena. Destructors are not run.
+//
+class Arena {
+public:
+  Arena(): Cur(nullptr), End(nullptr), Next(1024) {}
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  ~Arena();
+
+  // size bytes, aligned to align, which may be no more than alignof(std::max_align_t)
+  void* alloc(size_t size, size_t align = alignof(std::max_align_t));
+
+  static constexpr size_t BlockMax = 64 * 1024;
+
+private:
+  std::vector<std::pair<void*, size_t>> Blocks;
+  char* Cur;
+  char* End;
+  size_t Next;
+};
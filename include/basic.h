@@ -46,12 +46,3 @@ typedef unsigned char byte;
   std::ostringstream buf; \
   buf << expression; \
   throw std::runtime_error(buf.str())
-
-inline char* clone_c_str(const char* s) {
-  try {
-    return std::strcpy(new char[std::strlen(s) + 1], s);
-  }
-  catch (std::bad_alloc&) {
-    return nullptr;
-  }
-}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+// Identifies a run of bytes by its length and a 128-bit hash of it
+struct ContentKey {
+  uint64_t Size;
+  uint64_t Hash[2];
+
+  bool operator==(const ContentKey& o) const {
+    return Size == o.Size && Hash[0] == o.Hash[0] && Hash[1] == o.Hash[1];
+  }
+
+  bool operator!=(const ContentKey& o) const { return !(*this == o); }
+};
+
+template<>
+struct std::hash<ContentKey> {
+  std::size_t operator()(const ContentKey& k) const noexcept {
+    return k.Hash[0];
+  }
+};
+
+//
+// A fast, non-cryptographic 128-bit hash which can be fed in pieces of
+// any size; the result depends only on the bytes, not on how they were
+// split.
+//
+class ContentHasher {
+public:
+  ContentHasher();
+
+  void update(const char* beg, const char* end);
+
+  ContentKey finish() const;
+
+private:
+  uint64_t A, B, Size;
+  char Tail[8];
+  unsigned int TailLen;
+};
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include "hitwriter.h"
+#include "lineindex.h"
+
+#include <lightgrep/api.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// Holds back the hits of each block until the block after it has been
+// read, so that hits and their context can be written whole wherever the
+// block boundaries fall.
+//
+// Readers keep a block valid only until the read after next, so the input
+// before the current block is kept as a copy: the last Reach bytes of it,
+// and further back if a held hit still needs it. The current and next
+// blocks are used in place. A hit whose reach lies within one of these is
+// handed to the callback with a buffer pointing into it; one which
+// straddles them has the bytes it needs stitched together into a scratch
+// buffer, which is reused by the hits near it.
+//
+// A hit is released once Reach bytes past its end have been read, or the
+// input has ended, so context is complete to Reach bytes either side of a
+// hit at any block size.
+//
+// If counting lines, the ring also sets the line of each hit as it is
+// written. Blocks are counted as they pass; only those with hits have
+// their newlines indexed.
+//
+class ContextRing {
+public:
+  ContextRing(size_t reach, bool countLines = false);
+
+  // Forget everything, for the start of a new input
+  void reset();
+
+  // Make buf, at offset off in the input, the block being searched. Must
+  // be called before the next block is requested from the reader, while
+  // the previous block is still valid.
+  void advance(const char* buf, size_t len, uint64_t off);
+
+  // Write the held hits for which enough input has been read. next is the
+  // block after the current one, and eof whether it is the last.
+  void release(const char* next, size_t nlen, bool eof, HitOutputData* hinfo, LG_HITCALLBACK_FN callback);
+
+  // Hit callback for the search, to hold each hit; userData is the ring
+  static void hold(void* userData, const LG_SearchHit* const hit);
+
+  size_t held() const { return Held.size() - First; }
+
+private:
+  // Point hinfo at the input from off to end, stitching it if need be
+  void window(uint64_t off, uint64_t end, HitOutputData* hinfo);
+
+  // Copy the input from off to end into dst
+  void copy(uint64_t off, uint64_t end, char* dst) const;
+
+  // The number of newlines in the input before off
+  uint64_t linesBefore(uint64_t off);
+
+  const size_t Reach;
+  const bool CountLines;
+
+  // copy of the input before the current block, ending at CurOff
+  std::string Kept;
+  uint64_t KeptOff;
+
+  const char* Cur;
+  size_t CurLen;
+  uint64_t CurOff;
+
+  const char* Next;
+  size_t NextLen;
+
+  uint64_t CurLines;  // newlines before the current block
+  LineIndex CurIndex, KeptIndex;
+
+  // input stitched across blocks for the hits near a boundary
+  std::string Scratch;
+  uint64_t ScratchOff;
+
+  std::vector<LG_SearchHit> Held;
+  size_t First;  // in Held, of the hits not yet written
+};
@@ -69,6 +69,10 @@ public:
     return Trans->maxByteLength();
   }
 
+  virtual bool stateless() const {
+    return Trans->stateless();
+  }
+
 private:
   std::unique_ptr<Decoder> Trans;
 };
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <memory>
+#include <sstream>
+
+#include "decoders/decoder.h"
+
+//
+// Decodes Base64, taking its input to begin a four-character group, as
+// the hits of Base64 patterns do. Each byte is reported at the character
+// which completes it, so a hit's text holds the bytes whose last bits lie
+// within it. A character outside the alphabet, such as padding or a line
+// break, is bad, and begins a new group after it.
+//
+class Base64Decoder: public Decoder {
+public:
+  Base64Decoder(const Decoder& trans):
+    Trans(trans.clone()), Acc(0), Bits(0)
+  {}
+
+  Base64Decoder(std::unique_ptr<Decoder> trans):
+    Trans(std::move(trans)), Acc(0), Bits(0)
+  {}
+
+  Base64Decoder(const Base64Decoder& other):
+    Trans(other.Trans->clone()), Acc(other.Acc), Bits(other.Bits)
+  {}
+
+  Base64Decoder(Base64Decoder&&) = default;
+
+  Base64Decoder& operator=(const Base64Decoder& other) {
+    Trans = std::unique_ptr<Decoder>(other.Trans->clone());
+    Acc = other.Acc;
+    Bits = other.Bits;
+    return *this;
+  }
+
+  Base64Decoder& operator=(Base64Decoder&&) = default;
+
+  virtual Base64Decoder* clone() const {
+    return new Base64Decoder(*this);
+  }
+
+  virtual std::string name() const {
+    std::ostringstream ss;
+    ss << "|Base64" << Trans->name();
+    return ss.str();
+  }
+
+  virtual std::pair<int32_t,const byte*> next() {
+    std::pair<int32_t,const byte*> n;
+    do {
+      n = Trans->next();
+      if (n.first == END) {
+        // the bits of an unfinished byte are dropped
+        return n;
+      }
+      else if (n.first < 0 || value(n.first) < 0) {
+        Acc = Bits = 0;
+        if (n.first >= 0) {
+          n.first = -n.first-1;
+        }
+        return n;
+      }
+
+      Acc = (Acc << 6) | value(n.first);
+      Bits += 6;
+    } while (Bits < 8);
+
+    Bits -= 8;
+    n.first = (Acc >> Bits) & 0xFF;
+    Acc &= (1u << Bits) - 1;
+    return n;
+  }
+
+  virtual void reset(const byte* beg, const byte* end) {
+    Trans->reset(beg, end);
+    Acc = Bits = 0;
+  }
+
+  virtual uint32_t maxByteLength() const {
+    // a byte spans at most two characters
+    return 2 * Trans->maxByteLength();
+  }
+
+  // the value of a character of the alphabet, or -1 if not one
+  static int32_t value(int32_t c) {
+    if ('A' <= c && c <= 'Z') {
+      return c - 'A';
+    }
+    else if ('a' <= c && c <= 'z') {
+      return c - 'a' + 26;
+    }
+    else if ('0' <= c && c <= '9') {
+      return c - '0' + 52;
+    }
+    else if (c == '+') {
+      return 62;
+    }
+    else if (c == '/') {
+      return 63;
+    }
+    else {
+      return -1;
+    }
+  }
+
+private:
+  std::unique_ptr<Decoder> Trans;
+  uint32_t Acc, Bits;
+};
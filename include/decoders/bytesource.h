@@ -57,6 +57,10 @@ public:
     return 1;
   }
 
+  virtual bool stateless() const {
+    return true;
+  }
+
  private:
   const byte* Cur;
   const byte* End;
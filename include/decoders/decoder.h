@@ -36,5 +36,10 @@ public:
 
   virtual uint32_t maxByteLength() const = 0;
 
+  // Whether what is decoded from a position depends only on the bytes
+  // from there on, so that decoding from any two starts which land on the
+  // same position yields the same from there
+  virtual bool stateless() const { return false; }
+
   static const int32_t END;
 };
@@ -79,6 +79,10 @@ public:
     return Trans->maxByteLength();
   }
 
+  virtual bool stateless() const {
+    return Trans->stateless();
+  }
+
   static const byte unOCE[];
 
 private:
@@ -79,6 +79,10 @@ public:
     return Trans->maxByteLength();
   }
 
+  virtual bool stateless() const {
+    return Trans->stateless();
+  }
+
 private:
   uint32_t Rot;
   std::unique_ptr<Decoder> Trans;
@@ -103,6 +103,11 @@ public:
     return 4*Trans->maxByteLength();
   }
 
+  virtual bool stateless() const {
+    // the queue holds only what follows the position
+    return Trans->stateless();
+  }
+
 protected:
   virtual size_t decode(const byte* beg, const byte* end, int32_t& cp) = 0;
 
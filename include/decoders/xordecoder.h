@@ -87,6 +87,10 @@ public:
     return Trans->maxByteLength();
   }
 
+  virtual bool stateless() const {
+    return Trans->stateless();
+  }
+
 private:
   byte Key;
   std::unique_ptr<Decoder> Trans;
@@ -42,5 +42,7 @@ protected:
 
   virtual void collectRanges(const UnicodeSet& user, std::vector<std::vector<ByteSet>>& v) const;
 
+  static void sortRanges(std::vector<std::vector<ByteSet>>& v);
+
   UnicodeSet Valid;
 };
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#pragma once
+
+#include "basic.h"
+#include "byteset.h"
+#include "icuconverter.h"
+#include "rangeset.h"
+
+#include <memory>
+#include <vector>
+
+//
+// The encodings of all the valid code points of an ICU encoding, as runs
+// of consecutive code points whose encodings differ only in a last byte
+// which counts up with them. Converting through ICU is slow, so the table
+// is built once per process for each encoding and shared by all the
+// encoders for it.
+//
+class EncodingTable {
+public:
+  EncodingTable(const ICUConverter& conv, const UnicodeSet& valid);
+
+  // The table for conv's encoding, building it on first use
+  static std::shared_ptr<const EncodingTable> get(const ICUConverter& conv, const UnicodeSet& valid);
+
+  // Write the encoding of cp to buf, returning its length, or 0 if cp is
+  // not in the table
+  uint32_t write(int32_t cp, byte buf[]) const;
+
+  // Append the encodings of the code points in uset, joining those which
+  // differ only in their last byte, as EncoderBase::collectRanges does
+  void collect(const UnicodeSet& uset, std::vector<std::vector<ByteSet>>& va) const;
+
+  size_t runs() const { return Runs.size(); }
+
+private:
+  struct Run {
+    uint32_t First, Last; // [First, Last)
+    uint32_t Len;
+  };
+
+  // the encoding of the first code point of run i
+  const byte* bytes(size_t i) const { return Bytes.data() + i*MaxLen; }
+
+  uint32_t MaxLen;
+  std::vector<Run> Runs;
+  std::vector<byte> Bytes;
+};
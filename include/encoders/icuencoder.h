@@ -18,6 +18,7 @@
 #pragma once
 
 #include "encoders/encoderbase.h"
+#include "encoders/encodingtable.h"
 #include "icuconverter.h"
 
 #include <memory>
@@ -47,6 +48,10 @@ public:
 
   virtual uint32_t write(const byte buf[], int32_t& cp) const;
 
+protected:
+  virtual void collectRanges(const UnicodeSet& uset, std::vector<std::vector<ByteSet>>& v) const;
+
 private:
   ICUConverter Conv;
+  std::shared_ptr<const EncodingTable> Table;
 };
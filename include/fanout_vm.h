@@ -0,0 +1,68 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "basic.h"
+#include "pattern_map.h"
+#include "vm_interface.h"
+
+//
+// Reports each hit of a pattern for the patterns added as duplicates of
+// it, too. Duplicates have no automaton of their own, so the search sees
+// only the original; each of its hits is passed on with one for each
+// duplicate, at the same offsets.
+//
+class FanOutVm: public VmInterface {
+public:
+  FanOutVm(std::shared_ptr<VmInterface> vm, const PatternMap& pmap);
+
+  virtual void startsWith(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData);
+  virtual void startsWithMany(const byte* const beg, const byte* const end, const uint64_t startOffset, const uint64_t* const offsets, const size_t num, HitCallback hitFn, void* userData);
+  virtual uint64_t search(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData);
+  virtual uint64_t searchResolve(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData);
+  virtual uint64_t searchZeros(const uint64_t count, const uint64_t startOffset, HitCallback hitFn, void* userData);
+  virtual void closeOut(HitCallback hitFn, void* userData);
+  virtual void reset();
+
+  virtual void setDedupThreads(bool dedup);
+
+  virtual void setMaxThreads(uint32_t maxThreads);
+
+  virtual uint64_t droppedThreads() const;
+
+  #ifdef LBT_TRACE_ENABLED
+  virtual void setDebugRange(uint64_t beg, uint64_t end);
+  #endif
+
+private:
+  struct Fan {
+    const FanOutVm* Self;
+    HitCallback Fn;
+    void* UserData;
+  };
+
+  static void fanOut(void* userData, const LG_SearchHit* const hit);
+
+  std::shared_ptr<VmInterface> Vm;
+
+  // the duplicates of each pattern, end to end; those of pattern i run
+  // from Begin[i] to Begin[i+1]
+  std::vector<uint32_t> Begin, Duplicates;
+};
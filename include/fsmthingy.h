@@ -23,6 +23,8 @@
 #include "encoders/encoderfactory.h"
 
 #include <memory>
+#include <utility>
+#include <vector>
 
 class FSMThingy {
 public:
@@ -33,7 +35,23 @@ public:
   NFAOptimizer Comp;
   NFAPtr Fsm;
 
+  // set once finalizeGraph() has rewritten Fsm for compilation
+  bool Finalized;
+
   void addPattern(const ParseTree& tree, const char* chain, uint32_t label);
 
   void finalizeGraph(uint32_t determinizeDepth);
+
+  // Split the patterns into at most parts groups, each with its own
+  // finalized graph in which match labels index that group's label list.
+  // Fsm itself is left as it was.
+  std::vector<std::pair<NFAPtr,std::vector<uint32_t>>> partitionGraph(uint32_t numLabels, uint32_t parts, uint32_t determinizeDepth);
+
+  // A finalized graph which matches the patterns in the XOR of adjacent
+  // bytes, for searching under any single-byte XOR key. Fsm itself is
+  // left as it was.
+  NFAPtr xorGraph(uint32_t determinizeDepth);
+
+private:
+  NFAPtr finalize(NFAPtr g, uint32_t determinizeDepth);
 };
@@ -17,43 +17,88 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "lightgrep/api.h"
 #include "lightgrep/util.h"
 
+#include "allocator.h"
 #include "basic.h"
+#include "byteset.h"
 #include "fsmthingy.h"
 #include "fwd_pointers.h"
+#include "handoff_vm.h"
 #include "parsetree.h"
 #include "pattern_map.h"
 #include "vm_interface.h"
 #include "pattern.h"
 #include "decoders/decoderfactory.h"
 
-struct PatternHandle {
+struct PatternHandle: public HookAllocated<PatternHandle> {
   Pattern   Pat;
   ParseTree Tree;
 };
 
-struct PatternMapHandle {
+struct PatternMapHandle: public HookAllocated<PatternMapHandle> {
   std::unique_ptr<PatternMap> Impl;
 };
 
-struct FSMHandle {
+struct FSMHandle: public HookAllocated<FSMHandle> {
   std::unique_ptr<FSMThingy> Impl;
   std::shared_ptr<PatternMap> PMap;
+
+  // the first pattern added under each key, its parse tree's key and
+  // encoding chain; those added later under the same key share its
+  // automaton
+  std::unordered_map<std::string,uint32_t> Originals;
 };
 
-struct ProgramHandle {
+struct ProgramHandle: public HookAllocated<ProgramHandle> {
   ProgramPtr Prog;
   std::shared_ptr<PatternMap> PMap;
+
+  // set instead of Prog when the patterns are split among several programs;
+  // PartLabels[i][j] is the pattern index of label j in Parts[i]
+  std::vector<ProgramPtr> Parts;
+  std::vector<std::vector<uint32_t>> PartLabels;
+
+  // set beside Prog by lg_create_xor_program(): Diff matches the patterns
+  // in the XOR of adjacent bytes, and XorFirst holds the bytes which can
+  // begin a match, from which the keys to try at each of its hits follow;
+  // no match is longer than XorMaxLen bytes
+  ProgramPtr Diff;
+  ByteSet XorFirst;
+  uint32_t XorMaxLen = 0;
 };
 
-struct ContextHandle {
+struct ContextHandle: public HookAllocated<ContextHandle> {
   std::shared_ptr<VmInterface> Impl;
+
+  // from the program, if made by lg_create_xor_program()
+  std::shared_ptr<VmInterface> Diff;
+  ByteSet XorFirst;
+  uint32_t XorMaxLen = 0;
+
+  // the options the context was created with, for programs swapped in
+  uint64_t TraceBegin, TraceEnd;
+  bool DedupThreads;
+  uint32_t MaxThreads;
+
+  // set by lg_swap_program(), possibly from another thread, to the VM to
+  // take over at the start of the next search
+  std::mutex SwapLock;
+  std::shared_ptr<VmInterface> Pending;
+  std::atomic<bool> HasPending{false};
+
+  // Impl, while the program swapped out resolves the matches it began
+  std::shared_ptr<HandoffVm> Handoff;
 };
 
-struct DecoderHandle {
+struct DecoderHandle: public HookAllocated<DecoderHandle> {
   DecoderFactory Factory;
 };
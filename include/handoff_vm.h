@@ -0,0 +1,125 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#pragma once
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "basic.h"
+#include "vm_interface.h"
+
+//
+// Hands a search over from one program to another at an offset, without
+// searching any of the input twice. Matches which begin before the offset
+// are found by the old program, which keeps searching only until they
+// have all been resolved; those which begin at or after it are found by
+// the new one, which starts there. The new program should give the old
+// one's patterns the same indices.
+//
+// The new program starts cold at the offset, so may find a match inside
+// one the old program is still extending, such as a+ in aaa|aaa, which
+// neither program would report alone. So while the old program runs the
+// new one's hits are held back, and once it is done, a hit of the new
+// program is reported only if it begins at or after the end of the old
+// program's last hit for the same pattern.
+//
+// The old program runs for at most limit bytes past the offset, so that
+// a match it can extend without end, such as a.*z, cannot hold back the
+// new program's hits for good; a match it has not resolved by then is
+// lost. The search which reaches that point retires the old program
+// there and reports the held hits to its callback.
+//
+// Hits from the old program may be reported after ones from the new, as
+// they may come from a later buffer.
+//
+class HandoffVm: public VmInterface {
+public:
+  static constexpr uint64_t DEFAULT_LIMIT = 1 << 20;
+
+  HandoffVm(std::shared_ptr<VmInterface> from, std::shared_ptr<VmInterface> to, uint64_t offset, uint64_t limit = DEFAULT_LIMIT);
+
+  virtual void startsWith(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData);
+  virtual void startsWithMany(const byte* const beg, const byte* const end, const uint64_t startOffset, const uint64_t* const offsets, const size_t num, HitCallback hitFn, void* userData);
+  virtual uint64_t search(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData);
+  virtual uint64_t searchResolve(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData);
+  virtual uint64_t searchZeros(const uint64_t count, const uint64_t startOffset, HitCallback hitFn, void* userData);
+  virtual void closeOut(HitCallback hitFn, void* userData);
+  virtual void reset();
+
+  virtual void setDedupThreads(bool dedup);
+
+  virtual void setMaxThreads(uint32_t maxThreads);
+
+  virtual uint64_t droppedThreads() const;
+
+  #ifdef LBT_TRACE_ENABLED
+  virtual void setDebugRange(uint64_t beg, uint64_t end);
+  #endif
+
+  // Whether the old program has finished, and the new program can no
+  // longer find a hit overlapping one of its
+  bool done() const { return !From && Ends.empty(); }
+
+  const std::shared_ptr<VmInterface>& to() const { return To; }
+
+private:
+  struct Relay {
+    HandoffVm* Vm;
+    HitCallback Fn;
+    void* UserData;
+  };
+
+  // passes on the hits of the old program which begin before the offset,
+  // noting where they end
+  static void before(void* userData, const LG_SearchHit* const hit);
+
+  // holds the hits of the new program while the old one runs, and passes
+  // on those which don't overlap the old one's afterward
+  static void after(void* userData, const LG_SearchHit* const hit);
+
+  void pass(const LG_SearchHit& hit, HitCallback hitFn, void* userData) const;
+
+  // Run fn on the old program, then the new, retiring the old if it can
+  // find no more hits which begin before the offset, or if fn takes it
+  // through its limit
+  template <class F>
+  uint64_t run(F fn, uint64_t through, HitCallback hitFn, void* userData);
+
+  // how much of count bytes from startOffset the old program may search
+  // before it is retired
+  uint64_t budget(uint64_t count, uint64_t startOffset) const;
+
+  void retire(HitCallback hitFn, void* userData);
+
+  std::shared_ptr<VmInterface> From, To;
+  const uint64_t Offset;
+
+  // the offset by which the old program is retired
+  const uint64_t Until;
+
+  // the end of the old program's last hit for each pattern, and the
+  // greatest of them
+  std::map<uint32_t,uint64_t> Ends;
+  uint64_t EndsMax;
+
+  // hits of the new program found while the old one runs
+  std::vector<LG_SearchHit> Held;
+
+  // threads the old program dropped before it was retired
+  uint64_t FromDropped;
+};
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <lightgrep/api.h>
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class HistogramKey {
+public:
+  std::string HitText;
+  std::string Pattern;
+  uint64_t UserIndex;
+
+  HistogramKey(const std::string& hit, const std::string& pat, const uint64_t indx) : HitText(hit), Pattern(pat), UserIndex(indx) {};
+
+  bool operator==(const HistogramKey& node) const {
+    return node.Pattern == Pattern && node.HitText == HitText && node.UserIndex == UserIndex;
+  }
+
+  friend std::ostream& operator<<(std::ostream& out, const HistogramKey& hKey);
+};
+
+std::ostream& operator<<(std::ostream& out, const HistogramKey& hKey);
+
+template<>
+struct std::hash<HistogramKey>
+{
+    std::size_t operator()(const HistogramKey& node) const noexcept
+    {
+        std::size_t h = std::hash<std::string>{}(node.Pattern);
+        h ^= std::hash<std::string>{}(node.HitText) + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+        h ^= std::hash<uint64_t>{}(node.UserIndex) + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+        return h;
+    }
+};
+
+using LG_Histogram = std::unordered_map<HistogramKey, uint64_t>;
+
+std::ostream& operator<<(std::ostream& out, const LG_Histogram& histogram);
+
+bool histogramKeyComp(const LG_Histogram::value_type& a, const LG_Histogram::value_type& b);
+
+std::string escapeControlChars(const std::string& str);
+
+//
+// Counts hits by pattern and hit text. Patterns are interned by text and
+// user index, so that the encodings of a pattern are counted together,
+// and hit text is kept in an arena rather than a string per entry.
+//
+// With a nonzero top K, memory is bounded: once 2K entries are held,
+// only the K with the largest counts are kept (Space-Saving, pruned in
+// batches). A pair first seen after a prune is presumed to have had as
+// many hits as the largest count pruned, which keeps any pair with more
+// than 1/K of the hits from being pruned. The counts reported are the
+// hits actually counted for each pair, a lower bound on its true count.
+//
+class HitHistogram {
+public:
+  HitHistogram(uint32_t topK = 0);
+
+  void add(uint32_t keywordIndex, const LG_PatternInfo* info, const char* text, size_t len);
+
+  size_t size() const { return Used; }
+
+  LG_Histogram toMap() const;
+
+  // Write the entries, or the top K, by descending count, then ascending
+  // user index and hit text
+  void write(std::ostream& out, char sep) const;
+
+private:
+  struct Entry {
+    uint64_t Hash;
+    uint64_t TextOff;
+    uint64_t Count;  // upper bound on hits; 0 for an empty slot
+    uint64_t Error;  // of Count, presumed rather than counted
+    uint32_t TextLen;
+    uint32_t Pattern;
+  };
+
+  uint32_t intern(const char* pattern, uint64_t userIndex);
+  Entry& slot(uint64_t hash, uint32_t pat, const char* text, size_t len);
+  void rehash(size_t capacity);
+  void prune();
+  std::vector<const Entry*> sorted() const;
+
+  uint32_t TopK;
+  uint64_t Floor;  // the largest count pruned
+  size_t Used;
+  std::vector<Entry> Slots;
+  std::string Arena;
+
+  std::vector<std::pair<std::string, uint64_t>> Patterns;
+  std::unordered_map<std::string, uint32_t> PatternIds;
+  std::vector<uint32_t> KeywordPatterns;  // pattern id by keyword index, or NONE
+
+  static constexpr uint32_t NONE = 0xFFFFFFFF;
+};
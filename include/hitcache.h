@@ -0,0 +1,58 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include "contenthash.h"
+
+#include <lightgrep/search_hit.h>
+
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Hash the contents of a file
+ContentKey hashFile(const std::string& path);
+
+//
+// Maps the contents of searched files to the hits found in them, so that
+// byte-identical files need be searched only once. The cache belongs to
+// one program, identified by a fingerprint; a cache file written for any
+// other program is ignored on load.
+//
+class HitCache {
+public:
+  HitCache(const ContentKey& program): Program(program) {}
+
+  // The hits for this content, or null if it has not been searched
+  const std::vector<LG_SearchHit>* find(const ContentKey& key) const;
+
+  void insert(const ContentKey& key, std::vector<LG_SearchHit> hits);
+
+  size_t size() const { return Entries.size(); }
+
+  // Read the entries of a cache file; returns false, adding nothing, if
+  // the file is malformed or was written for a different program
+  bool load(std::istream& in);
+
+  void save(std::ostream& out) const;
+
+private:
+  ContentKey Program;
+  std::unordered_map<ContentKey, std::vector<LG_SearchHit>> Entries;
+};
@@ -28,6 +28,8 @@
 #include <vector>
 #include <unordered_map>
 
+#include "histogram.h"
+#include "outputbuffer.h"
 #include "searchhit.h"
 
 const char* find_leading_context(const char* const bbeg, const char* const hbeg, size_t lines);
@@ -57,42 +59,6 @@ struct HitBuffer {
   }
 };
 
-class HistogramKey {
-public:
-  std::string HitText;
-  std::string Pattern;
-  uint64_t UserIndex;
-
-  HistogramKey(const std::string& hit, const std::string& pat, const uint64_t indx) : HitText(hit), Pattern(pat), UserIndex(indx) {};
-
-  bool operator==(const HistogramKey& node) const {
-    return node.Pattern == Pattern && node.HitText == HitText && node.UserIndex == UserIndex;
-  }
-
-  friend std::ostream& operator<<(std::ostream& out, const HistogramKey& hKey);
-};
-
-std::ostream& operator<<(std::ostream& out, const HistogramKey& hKey);
-
-// custom hash function copied from https://stackoverflow.com/a/17017281
-template<>
-struct std::hash<HistogramKey>
-{
-    std::size_t operator()(const HistogramKey& node) const noexcept
-    {
-        const std::size_t h1 = std::hash<std::string>{}(node.Pattern);
-        const std::size_t h2 = std::hash<std::string>{}(node.HitText);
-        const std::size_t h3 = std::hash<uint64_t>{}(node.UserIndex);
-        return h1 ^ ((h2 << 1) >> 1) ^ (h3 << 1);
-    }
-};
-
-using LG_Histogram = std::unordered_map<HistogramKey, uint64_t>;
-
-std::ostream& operator<<(std::ostream& out, const LG_Histogram& histogram);
-
-bool histogramKeyComp(const LG_Histogram::value_type& a, const LG_Histogram::value_type& b);
-
 struct ContextBuffer {
   const char* Buf;
   size_t BufLen;
@@ -105,28 +71,62 @@ struct ContextBuffer {
   }
 };
 
+//
+// How hits are written:
+//
+//   TSV     one line per hit: [path] [line] start end index pattern
+//           encoding [context-offset context], with group separators
+//           between hits when printing context
+//
+//   NDJSON  one JSON object per hit, with the same fields
+//
+//   BINARY  a pattern table followed by a stream of records, in native
+//           byte order. The table is the magic "LGHT", a uint32 version
+//           and pattern count, then for each pattern its uint64 user
+//           index and its text and encoding chain, each as a uint32
+//           length and bytes. Each record is a tag byte and fields:
+//
+//             'P'  uint32 length, bytes     path of the hits that follow
+//             'L'  uint64 line              line of the hit that follows,
+//                                           with --line-number
+//             'H'  uint64 start, end,       hit, referring to the pattern
+//                  uint32 pattern index     table by position
+//             'C'  uint64 offset,           context of the preceding hit,
+//                  uint32 length, bytes     in UTF-8
+//
+enum class HitFormat { TSV, NDJSON, BINARY };
+
 struct OutputInfo {
-  std::ostream& Out;
+  OutputBuffer Out;
   std::string Path;
   int32_t BeforeContext;
   int32_t AfterContext;
   char Separator;
   std::string GroupSeparator;
+  HitFormat Format;
+  bool InRecord;     // NDJSON: whether the current object has been opened
+  bool PathWritten;  // BINARY: whether a record for Path has been written
+  bool LineNumbers = false;
+  uint64_t Line = 0;  // of the hit being written, counting from 1
 
-  void setPath(const std::string& path) { Path = path; }
+  OutputInfo(std::ostream& out, int32_t beforeContext, int32_t afterContext, char separator, const std::string& groupSep, HitFormat format, bool threaded);
+
+  void setPath(const std::string& path) { Path = path; PathWritten = false; }
+  void writePath();
   void writeHit(const LG_SearchHit& hit, const LG_PatternInfo* info);
   void writeContext(const HitBuffer&);
   void writeNewLine();
   void writeGroupSeparator();
+  void writePatternTable(ProgramHandle* prog);
 };
 
 struct HistogramInfo {
   bool HistogramEnabled;
   HitBuffer DecodedContext;
   SearchHit LastSearchHit;
-  LG_Histogram Histogram;
+  HitHistogram Histogram;
 
-  HistogramInfo(bool histEnabled): HistogramEnabled(histEnabled), Histogram({}) {}
+  HistogramInfo(bool histEnabled): HistogramEnabled(histEnabled), Histogram() {}
 
   void resetCache() { DecodedContext.clear(); LastSearchHit = SearchHit(); }
   void writeHistogram(std::ostream& histOut, char sep);
@@ -141,8 +141,9 @@ public:
   HistogramInfo HistInfo;
   std::unique_ptr<DecoderHandle, void(*)(DecoderHandle*)> Decoder;
   uint64_t NumHits = 0;
+  std::vector<LG_SearchHit>* Recorded = nullptr;  // if set, hits are also appended here
 
-  HitOutputData(std::ostream& out, ProgramHandle* prog, char separator, const std::string& groupSep, int32_t beforeContext, int32_t afterContext, bool histEnabled);
+  HitOutputData(std::ostream& out, ProgramHandle* prog, char separator, const std::string& groupSep, int32_t beforeContext, int32_t afterContext, bool histEnabled, HitFormat format = HitFormat::TSV, bool threaded = false);
 
   void setPath(const std::string& path) { OutInfo.setPath(path); }
   void setBuffer(const char* buf, size_t blen, uint64_t boff);
@@ -155,6 +156,7 @@ public:
   void writeHit(const LG_SearchHit& hit);
   void writeNewLine() { OutInfo.writeNewLine(); }
   void writeGroupSeparator() { OutInfo.writeGroupSeparator(); };
+  void flush() { OutInfo.Out.flush(); }
 };
 
 template<typename PathOutputFn, typename ContextFn, bool shouldOutput>
@@ -172,6 +174,9 @@ void callbackFn(void* userData, const LG_SearchHit* searchHit) {
   if (data->HistInfo.HistogramEnabled) {
     data->writeHitToHistogram(*searchHit);
   }
+  if (data->Recorded) {
+    data->Recorded->push_back(*searchHit);
+  }
   ++data->NumHits;
 }
 
@@ -43,3 +43,5 @@ LgAppCollection parsePatterns(const Options& opts);
 
 void writeProgram(const Options& opts, std::ostream& out);
 
+void writeAnalysis(const Options& opts, std::ostream& out);
+
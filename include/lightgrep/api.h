@@ -18,6 +18,8 @@
 #ifndef LIGHTGREP_C_API_H_
 #define LIGHTGREP_C_API_H_
 
+#include <stddef.h>  // for size_t
+
 #include "search_hit.h"
 
 #ifdef __cplusplus
@@ -94,15 +96,53 @@ extern "C" {
   //   of other considerations, as it limits the amount of memory used for the
   //   resulting NFA while retaining the benefits of determinization.
   //
+  // Partitions: the number of programs to split the patterns among;
+  //   0 or 1 -> compile all patterns into a single program;
+  //      > 1 -> split the patterns into up to that many programs, each of
+  //             which gets its own prefilter. A context for such a program
+  //             scans each buffer with every part concurrently and reports
+  //             the hits from all parts in order of (start, end, index).
+  //
+  //   Partitioning pays off for large pattern sets whose combined prefilter
+  //   admits too much of the input to be of use. Hits are buffered per call
+  //   to lg_search(), so callbacks see them only once all parts are done.
+  //
+  // Partitions was added after DeterminizeDepth, which changed the size of
+  // this struct; code compiled against the older header must be rebuilt,
+  // and aggregate initializers should now give both fields.
   //
   typedef struct {
     uint32_t DeterminizeDepth;
+    uint32_t Partitions;
   } LG_ProgramOptions;
 
+  // Options for search contexts
+  //
+  // DedupThreads: 0 => off, non-zero => on
+  //   When on, at most one thread per (program counter, label) survives
+  //   each frame wherever doing so cannot change which hits are reported.
+  //   This bounds the work per byte by the size of the program rather
+  //   than by the number of overlapping candidate matches, which helps on
+  //   inputs such as long runs of 'a' against patterns like 'a+b'.
+  //
+  // MaxThreads: 0 => unlimited, > 0 => thread budget
+  //   When more than MaxThreads threads are live after a byte, the
+  //   lowest-priority threads (those which started latest) are dropped,
+  //   except for threads holding matches not yet reported. This bounds the
+  //   time spent on pathological inputs, at the cost of possibly missing
+  //   hits which begin in the affected region, or of reporting a shorter
+  //   or later hit than a full search would. Searching returns to normal
+  //   as soon as the number of live threads falls within the budget. Use
+  //   lg_context_dropped_threads() to learn whether this has happened.
+  //   Anchored searches, lg_starts_with() and lg_starts_with_batch(), are
+  //   never shed, as every thread in them began at the same offset.
+  //
 // TODO: nix these, don't expose trace in the lib
   typedef struct {
     uint64_t TraceBegin,    // starting offset of trace output
              TraceEnd;      // ending offset of trace output
+    char DedupThreads;      // 0 => off, non-zero => on
+    uint32_t MaxThreads;    // 0 => unlimited
   } LG_ContextOptions;
 
   // Error handling
@@ -117,6 +157,32 @@ extern "C" {
 
   void lg_free_error(LG_Error* err);
 
+  // Memory allocation
+  //
+  // The library takes the memory for its handles, errors, hit arrays,
+  // programs, search state, and compiled automata through these hooks.
+  // Alloc returns size bytes, aligned for any type, or null on failure.
+  // Free releases a block returned by Alloc, and is given its size.
+  // UserData is passed to both. If either is null, malloc() and free()
+  // are used.
+  //
+  // Programs and search state of at least HugePageMin bytes are instead
+  // mapped from the system and marked to be backed by huge pages, where
+  // the system supports it (Linux, with transparent huge pages); 0
+  // disables this.
+  typedef struct {
+    void* (*Alloc)(void* userData, size_t size);
+    void (*Free)(void* userData, void* ptr, size_t size);
+    void* UserData;
+    size_t HugePageMin;
+  } LG_Allocator;
+
+  // Sets the allocator for the whole library. It must be called before any
+  // handle is created, or once all have been destroyed, and not while
+  // another thread is using the library. Passing null restores the
+  // default: malloc() and free(), with huge pages from 2MB.
+  void lg_set_allocator(const LG_Allocator* alloc);
+
   // Create and destory an LG_HPATTERN.
   // This can be reused when parsing pattern strings to avoid re-allocating memory.
   LG_HPATTERN lg_create_pattern();
@@ -188,6 +254,38 @@ extern "C" {
   LG_PatternInfo* lg_fsm_pattern_info(const LG_HFSM hFsm,
                                       unsigned int patternIndex);
 
+  // Static cost estimate for a single pattern-encoding pair
+  //
+  // MaxFanOut: the most threads into which one thread can fork on a
+  //   single byte.
+  // Loops: the number of loops in the pattern's automaton. Loops let
+  //   threads live for arbitrarily long.
+  // MinLength: the length in bytes of the shortest match.
+  // FilterPairs: how many of the 65536 byte pairs get through the
+  //   two-byte prefilter for this pattern. The prefilter is shared by all
+  //   patterns in a program, so one pattern which admits (nearly) every
+  //   pair makes it useless for all of them.
+  // DefeatsPrefilter: non-zero if the pattern admits every byte pair
+  // Cost: a relative cost estimate, for ranking patterns against one
+  //   another; higher is more expensive.
+  //
+  typedef struct {
+    uint32_t MaxFanOut;
+    uint32_t Loops;
+    uint32_t MinLength;
+    uint32_t FilterPairs;
+    char DefeatsPrefilter;
+    double Cost;
+  } LG_PatternStats;
+
+  // Fills in stats for the pattern at patternIndex in the FSM. This must
+  // be called before lg_create_program(), which rewrites the FSM.
+  // Returns zero on failure, positive otherwise.
+  int lg_analyze_pattern(LG_HFSM hFsm,
+                         unsigned int patternIndex,
+                         LG_PatternStats* stats,
+                         LG_Error** err);
+
   // The number of pattern-encoding pairs recognized by the Program. This
   // will be one greater than the maximum pattern index accepted by
   // lg_prog_pattern_info().
@@ -202,6 +300,28 @@ extern "C" {
   // and the FSM may be discarded.
   LG_HPROGRAM lg_create_program(LG_HFSM hFsm, const LG_ProgramOptions* options);
 
+  // Create a Program which searches for the patterns of hBase and those of
+  // hFsm, compiling only hFsm's. The patterns of hBase keep their indices,
+  // and those of hFsm are numbered after them. The bytecode of hBase is
+  // shared rather than copied, and searched alongside that of hFsm as the
+  // parts of a partitioned Program are, so each such Program adds a part;
+  // compile all the patterns afresh from time to time to merge them. It is
+  // an error if the Program would have more than 64 parts. hBase may be
+  // destroyed afterward. It may not be made by lg_create_xor_program().
+  LG_HPROGRAM lg_create_delta_program(LG_HPROGRAM hBase, LG_HFSM hFsm, const LG_ProgramOptions* options);
+
+  // Create a Program which finds the patterns under every single-byte XOR
+  // key at once, for use with lg_search_xor(). Rather than one copy of each
+  // pattern per key, it has one which matches the XOR of each pair of
+  // adjacent bytes, in which the key cancels out, and one as compiled by
+  // lg_create_program() with which its hits are checked and their keys
+  // found. Partitions is ignored. Matches of a single byte cannot be found
+  // this way, and it is an error if no pattern can match more than one.
+  // Each hit is checked as far as the longest match could run, so it is
+  // also an error if a pattern's matches are unbounded in length, as with
+  // + or *; bound the repetition instead, e.g., {1,64}.
+  LG_HPROGRAM lg_create_xor_program(LG_HFSM hFsm, const LG_ProgramOptions* options);
+
   // The size, in bytes, of the search program. Used for serialization.
   unsigned int lg_program_size(const LG_HPROGRAM hProg);
 
@@ -210,9 +330,9 @@ extern "C" {
   void lg_write_program(const LG_HPROGRAM hProg, void* buffer);
 
   // Convert a buffer containing a serialized program to a program, given the
-  // binary buffer and size. No versioning check is done so don't keep these
-  // around too long. The caller is responsible for freeing the buffer after
-  // calling lg_destroy_program on the handle.
+  // binary buffer and size. Returns null if the buffer is malformed or was
+  // written by another version. The caller is responsible for freeing the
+  // buffer after calling lg_destroy_program on the handle.
   LG_HPROGRAM lg_read_program(const void* buffer, int size);
 
   // A Program must live as long as any associated contexts,
@@ -242,10 +362,48 @@ extern "C" {
                       void* userData,
                       LG_HITCALLBACK_FN callbackFn);
 
+  // Finds matches beginning at each of num offsets into the buffer, as
+  // though lg_starts_with() had been called on each in turn, from
+  // bufStart + offsets[i] to bufEnd with a start offset of startOffset +
+  // offsets[i]. Matches at different offsets do not hide each other, even
+  // where they overlap. Offsets past the end of the buffer are skipped.
+  // The set-up is shared and each offset costs little more than the bytes
+  // it examines, so this is much cheaper than many separate calls when
+  // checking many candidates, e.g., every sector of an image. Hits are
+  // reported in order of their starts if the offsets are ascending.
+  void lg_starts_with_batch(LG_HCONTEXT hCtx,
+                            const char* bufStart,
+                            const char* bufEnd,
+                            uint64_t startOffset,
+                            const uint64_t* offsets,
+                            size_t num,
+                            void* userData,
+                            LG_HITCALLBACK_FN callbackFn);
+
   // Reset the context to its initial state.
   // Call this before searching a new file.
   void lg_reset_context(LG_HCONTEXT hCtx);
 
+  // Have the context search with hProg from the start of its next search
+  // call, such as the next block of a stream. Hits which begin before that
+  // block are still found by the old program, which searches on only until
+  // it has no matches in progress, and hits from there on by the new
+  // program; no input is searched twice. A hit of the new program which
+  // overlaps one of the old program's for the same pattern, as where the
+  // swap falls inside a match, is not reported, and the new program's hits
+  // are held back until the old one is done. hProg should keep the indices
+  // of the old program's patterns, as lg_create_delta_program() does. This
+  // may be called from another thread while the context is searching, but
+  // not while it is being destroyed. Neither program may be made by
+  // lg_create_xor_program(). Returns 1 on success, 0 on error.
+  int lg_swap_program(LG_HCONTEXT hCtx, LG_HPROGRAM hProg, LG_Error** err);
+
+  // The number of threads dropped since the context was last reset due to
+  // exceeding LG_ContextOptions::MaxThreads. Non-zero means that the search
+  // ran in degraded mode at some point and hits may have been missed.
+  // Returns zero for a null handle.
+  uint64_t lg_context_dropped_threads(const LG_HCONTEXT hCtx);
+
   // Search a buffer. It assumes it's picking up where it left off, so you can
   // call this in a loop. When a hit is identified, the callback function will
   // be called, on the same stackframe, giving you the starting byte offset of
@@ -266,6 +424,17 @@ extern "C" {
                          void* userData,       // pass in what you like, it will be passed through to the callback function
                          LG_HITCALLBACK_FN callbackFn);
 
+  // Search as though lg_search() had been given a buffer of count zero bytes
+  // beginning at startOffset, e.g., for a hole in a sparse file. Runs of
+  // zeros which cannot change the state of the search, as when no pattern
+  // can begin or continue with a zero byte, take constant time. Return
+  // value is as for lg_search().
+  uint64_t lg_search_zeros(LG_HCONTEXT hCtx,
+                           const uint64_t count,
+                           const uint64_t startOffset,
+                           void* userData,
+                           LG_HITCALLBACK_FN callbackFn);
+
   // ...which is why it's important you call lg_closeout_search() when finished
   // searching a byte stream. This will flush out any remaining search hits.
   void lg_closeout_search(LG_HCONTEXT hCtx,
@@ -281,6 +450,36 @@ extern "C" {
                          void* userData,
                          LG_HITCALLBACK_FN callbackFn);
 
+  // Searches a whole buffer, as lg_search(), lg_closeout_search(), and
+  // lg_reset_context() would, but collects the hits instead of calling back
+  // for each. This suits callers for which a callback is costly, such as
+  // bindings for other languages, which can then leave the search to run
+  // without holding any lock of their own. On success, *hits points to
+  // *numHits hits, in the order they were found, which must be freed with
+  // lg_free_hits(). Returns 1 on success, 0 on error.
+  int lg_search_hits(LG_HCONTEXT hCtx,
+                     const char* bufStart,
+                     const char* bufEnd,
+                     uint64_t startOffset,
+                     LG_SearchHit** hits,
+                     size_t* numHits,
+                     LG_Error** err);
+
+  void lg_free_hits(LG_SearchHit* hits);
+
+  // Searches a whole buffer for the patterns of a Program made by
+  // lg_create_xor_program(), under every single-byte XOR key, key 0 among
+  // them. Each hit is reported with its key; text which matches under
+  // several keys, as can happen with character classes, is reported once
+  // for each. Hits are reported in order of their starts. The context is
+  // left reset, so this cannot be interleaved with lg_search() on it.
+  void lg_search_xor(LG_HCONTEXT hCtx,
+                     const char* bufStart,
+                     const char* bufEnd,
+                     uint64_t startOffset,
+                     void* userData,
+                     LG_XOR_HITCALLBACK_FN callbackFn);
+
 #ifdef __cplusplus
 }
 #endif
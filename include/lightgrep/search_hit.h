@@ -39,6 +39,15 @@ extern "C" {
   // }
   typedef void (*LG_HITCALLBACK_FN)(void* userData, const LG_SearchHit* const hit);
 
+  // A hit from lg_search_xor(), with the key under which it matched, i.e.,
+  // the input from Hit.Start to Hit.End XORed with Key matches the keyword
+  typedef struct {
+    LG_SearchHit Hit;
+    uint8_t      Key;
+  } LG_XorSearchHit;
+
+  typedef void (*LG_XOR_HITCALLBACK_FN)(void* userData, const LG_XorSearchHit* const hit);
+
 
 #ifdef __cplusplus
 }
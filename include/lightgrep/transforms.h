@@ -37,12 +37,14 @@ static const int LG_CHAR_TRANSFORM_IDENTITY = 0;
 
 static const LG_TRANS LG_BYTE_TRANSFORMS[] = {
   { "identity", 0 },
-  { "OCE",      1 }
+  { "OCE",      1 },
+  { "Base64",   2 }
 };
 
 static const char* const LG_CANONICAL_BYTE_TRANSFORMS[] = {
   "identity", // 0
   "OCE",      // 1
+  "Base64",   // 2
 };
 
 // identity
@@ -51,6 +53,13 @@ static const int LG_BYTE_TRANSFORM_IDENTITY = 0;
 // Outlook Compressible Encryption
 static const int LG_BYTE_TRANSFORM_OUTLOOK = 1;
 
+// Base64, with the standard alphabet and no line breaks; must come last.
+// Hits begin at the start of the four-character group which holds the
+// first byte of the match, so that they decode from there, and end with
+// the character which holds its last bits. Hence matches of one pattern
+// which share a three-byte group overlap, and only the first is reported.
+static const int LG_BYTE_TRANSFORM_BASE64 = 2;
+
 #ifdef __cplusplus
 }
 #endif
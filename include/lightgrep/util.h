@@ -80,6 +80,28 @@ unsigned int lg_hit_context(LG_HDECODER hDec,
                             LG_Window* decodedHit,
                             LG_Error** err);
 
+// Decode the context of several hits in one buffer, as lg_hit_context()
+// does for each, with the i-th hit's results in utf8[i], outers[i],
+// decodedHits[i], and, if bad is not null, its count of bad values in
+// bad[i]. Each encoding gets one decoder per call, which is reused across
+// the hits along with the working space. Returns the number of hits
+// decoded, which is less than num only on an error, which is then reported
+// in err. Each utf8[i] must be freed with lg_free_hit_context_string().
+size_t lg_hit_contexts(LG_HDECODER hDec,
+                       const char* bufStart,
+                       const char* bufEnd,
+                       uint64_t dataOffset,
+                       const LG_Window* inners,
+                       const char* const* encodings,
+                       size_t num,
+                       size_t windowSize,
+                       uint32_t replacement,
+                       const char** utf8,
+                       LG_Window* outers,
+                       LG_Window* decodedHits,
+                       unsigned int* bad,
+                       LG_Error** err);
+
 void lg_free_window_characters(int32_t* characters);
 
 void lg_free_window_offsets(size_t* offsets);
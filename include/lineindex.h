@@ -0,0 +1,50 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Count the newlines from beg to end
+size_t countLines(const char* beg, const char* end);
+
+//
+// Finds how many newlines precede positions in a block. The positions of
+// the newlines are found only when first asked for, so that blocks
+// without hits are only counted; after that, each lookup is a binary
+// search.
+//
+class LineIndex {
+public:
+  LineIndex(): Buf(nullptr), Len(0), Built(false) {}
+
+  void reset(const char* buf, size_t len);
+
+  // The number of newlines before pos in the block
+  size_t before(size_t pos);
+
+  // The number of newlines in the block
+  size_t count() const;
+
+private:
+  const char* Buf;
+  size_t Len;
+  bool Built;
+  std::vector<uint32_t> Newlines;  // block sizes fit in 32 bits
+};
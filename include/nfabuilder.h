@@ -20,7 +20,10 @@
 #include "basic.h"
 #include "fwd_pointers.h"
 #include "fragment.h"
+#include "rangeset.h"
+#include "utf8automaton.h"
 
+#include <map>
 #include <stack>
 
 struct ParseNode;
@@ -76,6 +79,8 @@ private:
 
   void traverse(const ParseNode* root);
 
+  void utf8Class(const ParseNode& n, const UnicodeSet& uset);
+
   bool IsGood;
   uint32_t CurLabel;
   uint64_t ReserveSize;
@@ -87,6 +92,9 @@ private:
   std::unique_ptr<byte[]> TempBuf;
   Fragment TempFrag;
   std::vector<std::vector<ByteSet>> TempEncRanges;
+
+  // the UTF-8 automata of the classes seen so far, kept across patterns
+  std::map<UnicodeSet,UTF8Automaton> UTF8Classes;
   std::stack<Fragment> Stack;
   std::stack<const ParseNode*, std::vector<const ParseNode*>> ChildStack, ParentStack;
 };
@@ -42,6 +42,7 @@ public:
     PROGRAM,
     SAMPLES,
     VALIDATE,
+    ANALYZE,
     SHOW_VERSION,
     SHOW_HELP,
     LIST_ENCODINGS,
@@ -51,7 +52,9 @@ public:
   std::string Output,
               ProgramFile,
               GroupSeparator,
-              HistogramFile;
+              HistogramFile,
+              HitCacheFile,
+              Format;
 
   std::vector<std::string> Inputs,
                            InputLists,
@@ -60,7 +63,10 @@ public:
                            Encodings;
 
   uint32_t BlockSize,
-           DeterminizeDepth;
+           DeterminizeDepth,
+           Partitions,
+           MaxThreads,
+           HistogramTop;
 
   int32_t BeforeContext = -1,
           AfterContext = -1;
@@ -69,10 +75,14 @@ public:
        LiteralMode = false,
        UnicodeMode = false,
        NoOutput = false,
+       LineNumbers = false,
        PrintPath = false,
        Recursive = false,
        Binary = false,
        MemoryMapped = false,
+       Decompress = false,
+       Dedup = false,
+       DedupThreads = false,
        Verbose = false;
 
   mutable std::ofstream OutputFile;
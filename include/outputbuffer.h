@@ -0,0 +1,88 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+
+//
+// Collects output in a large buffer and writes it to a stream in big
+// pieces. If threaded, a full buffer is handed to a writer thread and
+// filling continues in a second buffer, so the caller waits on the
+// stream only when the writer falls a whole buffer behind.
+//
+class OutputBuffer {
+public:
+  OutputBuffer(std::ostream& out, bool threaded = false, size_t capacity = 1 << 20);
+
+  ~OutputBuffer();
+
+  OutputBuffer(const OutputBuffer&) = delete;
+  OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+  void append(const char* s, size_t len) {
+    if (Buf.size() + len > Capacity) {
+      spill();
+    }
+    Buf.append(s, len);
+  }
+
+  void append(const std::string& s) { append(s.data(), s.size()); }
+
+  void append(char c) {
+    if (Buf.size() == Capacity) {
+      spill();
+    }
+    Buf.push_back(c);
+  }
+
+  // Append the decimal digits of v
+  void appendNum(uint64_t v);
+
+  // Append the bytes of v as they are in memory
+  template <typename T>
+  void appendRaw(const T& v) {
+    char b[sizeof(T)];
+    std::memcpy(b, &v, sizeof(T));
+    append(b, sizeof(T));
+  }
+
+  // Write out everything appended so far and flush the stream
+  void flush();
+
+private:
+  void spill();
+  void writer();
+
+  std::ostream& Out;
+  const bool Threaded;
+  const size_t Capacity;
+  std::string Buf;
+
+  // the buffer being written by the writer thread
+  std::string InFlight;
+  bool Busy, Done;
+  std::mutex M;
+  std::condition_variable Cond;
+  std::thread Writer;
+};
@@ -47,3 +47,7 @@ private:
 };
 
 std::ostream& operator<<(std::ostream& out, const ParseTree& tree);
+
+// A string which two trees have in common only if they are equal, for
+// looking trees up by value
+std::string treeKey(const ParseTree& tree);
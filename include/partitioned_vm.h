@@ -0,0 +1,95 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "basic.h"
+#include "vm_interface.h"
+
+//
+// Runs several programs, each compiled from a subset of the patterns, over
+// the same input at once. Each part searches on its own thread; the hits
+// are mapped back to global pattern indices, sorted, and handed to the
+// caller's callback on the calling thread. The calling thread takes the
+// first part, and the worker threads for the rest live as long as the VM,
+// sleeping between calls.
+//
+class PartitionedVm: public VmInterface {
+public:
+  PartitionedVm(const std::vector<ProgramPtr>& progs, const std::vector<std::vector<uint32_t>>& labels);
+
+  virtual ~PartitionedVm();
+
+  PartitionedVm(const PartitionedVm&) = delete;
+  PartitionedVm& operator=(const PartitionedVm&) = delete;
+
+  virtual void startsWith(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData);
+  virtual void startsWithMany(const byte* const beg, const byte* const end, const uint64_t startOffset, const uint64_t* const offsets, const size_t num, HitCallback hitFn, void* userData);
+  virtual uint64_t search(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData);
+  virtual uint64_t searchResolve(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData);
+  virtual uint64_t searchZeros(const uint64_t count, const uint64_t startOffset, HitCallback hitFn, void* userData);
+  virtual void closeOut(HitCallback hitFn, void* userData);
+  virtual void reset();
+
+  virtual void setDedupThreads(bool dedup);
+
+  virtual void setMaxThreads(uint32_t maxThreads);
+
+  virtual uint64_t droppedThreads() const;
+
+  #ifdef LBT_TRACE_ENABLED
+  virtual void setDebugRange(uint64_t beg, uint64_t end);
+  #endif
+
+private:
+  struct Part {
+    std::shared_ptr<VmInterface> Vm;
+    std::vector<uint32_t> Labels;  // part label -> global pattern index
+    std::vector<SearchHit> Hits;
+  };
+
+  static void collectHit(void* userData, const LG_SearchHit* const hit);
+
+  // call fn(part, collector) for every part concurrently, then pass the
+  // hits they collected to hitFn in order
+  template <class F>
+  void run(F fn, HitCallback hitFn, void* userData);
+
+  // worker i runs Job on part i once per round
+  void worker(size_t i);
+
+  // wake the workers to quit, and join them
+  void stop();
+
+  std::vector<Part> Parts;
+
+  std::function<void(size_t)> Job;
+  uint64_t Round;
+  size_t Pending;
+  bool Quit;
+  std::mutex M;
+  std::condition_variable Wake, Finished;
+  std::vector<std::thread> Workers;
+};
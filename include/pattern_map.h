@@ -25,8 +25,11 @@
 
 class PatternMap {
 public:
-  PatternMap(unsigned int sizeHint): Patterns(), Shared(false) {
+  static constexpr uint32_t NONE = 0xFFFFFFFF;
+
+  PatternMap(unsigned int sizeHint): Patterns(), Originals(), Shared(false) {
     Patterns.reserve(sizeHint);
+    Originals.reserve(sizeHint);
   }
 
   ~PatternMap() {
@@ -37,7 +40,9 @@ public:
 
   PatternMap& operator=(const PatternMap& other);
 
-  void addPattern(const char* pattern, const char* chain, uint64_t index);
+  // Add a pattern. If it is the same as the pattern at index original,
+  // it has no automaton of its own, and is reported wherever that one is.
+  void addPattern(const char* pattern, const char* chain, uint64_t index, uint32_t original = NONE);
 
   LG_PatternInfo& operator[](size_t index);
 
@@ -45,9 +50,17 @@ public:
 
   size_t count() const;
 
+  // The index of the pattern whose matches are those of the pattern at
+  // index; its own, unless it was added as a duplicate
+  uint32_t original(size_t index) const;
+
+  bool hasDuplicates() const;
+
   size_t bufSize() const;
   std::vector<char> marshall() const;
 
+  // The map marshalled into buf, whose strings it points into; null if
+  // buf is malformed or was marshalled by another version
   static std::unique_ptr<PatternMap> unmarshall(const void* buf, size_t len);
 
   bool operator==(const PatternMap& rhs) const;
@@ -55,13 +68,14 @@ public:
   friend std::ostream& operator<<(std::ostream& out, const PatternMap& p);
 
 private:
-  void usePattern(const char* pattern, const char* chain, uint64_t index);
+  void usePattern(const char* pattern, const char* chain, uint64_t index, uint32_t original);
 
   void copyOther(const PatternMap& other);
 
   void clearPatterns();
 
   std::vector<LG_PatternInfo> Patterns;
+  std::vector<uint32_t> Originals;
   bool Shared;
 };
 
@@ -25,27 +25,88 @@
 #include <ostream>
 #include <vector>
 
+#include "allocator.h"
 #include "basic.h"
 #include "instructions.h"
 #include "fwd_pointers.h"
 
+// A secondary prefilter window, consulted only for offsets which pass
+// Program::Filter. The Width (2 or 4) bytes at Off are read little-endian
+// into a key, which is hashed by multiplication into a table of bits.
+// Two-byte windows use the key itself (Mult 1, Shift 0), so are exact;
+// four-byte windows are hashed, so admit some false positives.
+struct FilterWindow {
+  uint32_t Off, Width, Mult, Shift;
+  std::vector<uint64_t> Table;
+
+  static uint32_t key(const byte* const cur, uint32_t width) {
+    uint32_t k = cur[0] | (cur[1] << 8);
+    if (width == 4) {
+      k |= (cur[2] << 16) | (static_cast<uint32_t>(cur[3]) << 24);
+    }
+    return k;
+  }
+
+  uint32_t index(uint32_t k) const {
+    return (k * Mult) >> Shift;
+  }
+
+  void set(uint32_t k) {
+    const uint32_t i = index(k);
+    Table[i >> 6] |= uint64_t(1) << (i & 63);
+  }
+
+  bool admits(const byte* const cur) const {
+    const uint32_t i = index(key(cur + Off, Width));
+    return (Table[i >> 6] >> (i & 63)) & 1;
+  }
+
+  bool operator==(const FilterWindow& rhs) const {
+    return Off == rhs.Off && Width == rhs.Width &&
+           Mult == rhs.Mult && Shift == rhs.Shift &&
+           Table == rhs.Table;
+  }
+};
+
 class Program {
 public:
   Program(size_t icount): Program(icount, Instruction()) {}
 
   Program(size_t icount, const Instruction& val):
-    MaxLabel(0), MaxCheck(0), FilterOff(0), Filter(),
-    IBeg(new Instruction[icount], [](Instruction* i){ delete[] i; }),
+    MaxLabel(0), MaxCheck(0), FilterOff(0), FilterStride(1), Filter(),
+    IBeg(
+      static_cast<Instruction*>(lgAllocLarge(icount*sizeof(Instruction))),
+      Release{icount*sizeof(Instruction), true}
+    ),
     IEnd(IBeg.get() + icount)
   {
-    std::fill(IBeg.get(), IEnd, val);
+    std::uninitialized_fill(IBeg.get(), IEnd, val);
   }
 
   uint32_t MaxLabel, MaxCheck;
 
-  uint32_t FilterOff;
+  // Filter is keyed by the bytes at FilterOff and FilterOff + FilterStride;
+  // the stride is 2 for wide characters, to pass over their zero bytes
+  uint32_t FilterOff, FilterStride;
   std::bitset<256*256> Filter;
 
+  std::vector<FilterWindow> FilterWindows;
+
+  uint32_t filterKey(const byte* const cur) const {
+    return FilterStride == 1 ?
+      *reinterpret_cast<const uint16_t*>(cur + FilterOff) :
+      cur[FilterOff] | (cur[FilterOff + FilterStride] << 8);
+  }
+
+  // the number of bytes needed past an offset to evaluate every filter
+  uint32_t filterSpan() const {
+    uint32_t span = FilterOff + FilterStride + 1;
+    for (const FilterWindow& w : FilterWindows) {
+      span = std::max(span, w.Off + w.Width);
+    }
+    return span;
+  }
+
   // typedefs for container compatibility
   typedef Instruction value_type;
   typedef size_t size_type;
@@ -138,18 +199,42 @@ public:
   bool operator==(const Program& rhs) const;
 
   size_t bufSize() const {
-    return sizeof(MaxLabel) +
+    size_t wsize = sizeof(uint32_t);
+    for (const FilterWindow& w : FilterWindows) {
+      wsize += 5*sizeof(uint32_t) + w.Table.size()*sizeof(uint64_t);
+    }
+
+    return 2*sizeof(uint32_t) +  // magic and version
+           sizeof(MaxLabel) +
            sizeof(MaxCheck) +
            sizeof(FilterOff) +
+           sizeof(FilterStride) +
            Filter.size()/8 +
+           wsize +
            size()*sizeof(Instruction);
   }
 
   std::vector<char> marshall() const;
+
+  // The program marshalled into buf, whose instructions it points into;
+  // null if buf is malformed or was marshalled by another version
   static ProgramPtr unmarshall(const void* buf, size_t len);
 
 private:
-  std::unique_ptr<Instruction[], void(*)(Instruction*)> IBeg;
+  // frees the instructions, unless they are in a buffer the caller owns;
+  // big programs are on huge pages
+  struct Release {
+    size_t Bytes;
+    bool Owned;
+
+    void operator()(Instruction* i) const {
+      if (Owned) {
+        lgFreeLarge(i, Bytes);
+      }
+    }
+  };
+
+  std::unique_ptr<Instruction[], Release> IBeg;
   Instruction* IEnd;
 };
 
@@ -20,6 +20,7 @@
 #include <cstdio>
 #include <future>
 #include <memory>
+#include <string>
 #include <utility>
 
 #include <boost/interprocess/file_mapping.hpp>
@@ -30,6 +31,13 @@ public:
   virtual ~Reader() {}
 
   virtual std::future<std::pair<const char*, size_t>> read(size_t len) = 0;
+
+  // Whether a block returned by read() is a hole: zeros which were not
+  // read from the input, and which can be searched with lg_search_zeros()
+  virtual bool hole(const char*) const { return false; }
+
+  // Seconds spent off the search thread faulting in data ahead of use
+  virtual double faultTime() const { return 0.0; }
 };
 
 class FileReader: public Reader {
@@ -45,17 +53,88 @@ private:
   std::unique_ptr<char[]> Cur, Next;
 };
 
+// Whether the file has holes for SparseFileReader to skip
+bool isSparseFile(const std::string& path);
+
+//
+// Reads a sparse file, handing out its holes as blocks of zeros which
+// are never read from the file. Holes are found with SEEK_DATA and
+// SEEK_HOLE; small ones are read like data.
+//
+class SparseFileReader: public Reader {
+public:
+  SparseFileReader(const std::string& path, size_t blockSize);
+
+  virtual ~SparseFileReader();
+
+  virtual std::future<std::pair<const char*, size_t>> read(size_t len) override;
+
+  virtual bool hole(const char* buf) const override { return buf == Zeros.get(); }
+
+private:
+  static const uint64_t MIN_HOLE = 1 << 16;
+
+  std::pair<const char*, size_t> fill(char* buf, size_t len);
+  void findRegion();
+
+  FILE* File;
+  uint64_t Size, Pos, RegionEnd;
+  bool InHole, Seek;
+  std::unique_ptr<char[]> Cur, Next, Zeros;
+};
+
 namespace bip = boost::interprocess;
 
+//
+// Maps the file one window at a time, rather than all at once, so that
+// address space use is bounded no matter how large the file. Each window
+// is mapped and its pages faulted in by a helper thread while the previous
+// window is searched; a window is unmapped once the one after it has been
+// handed out and the one after that requested.
+//
 class MemoryMappedFileReader: public Reader {
 public:
   MemoryMappedFileReader(const std::string& path);
 
   virtual std::future<std::pair<const char*, size_t>> read(size_t len) override;
 
+  virtual double faultTime() const override { return FaultTime; }
+
 private:
   bip::file_mapping M;
-  bip::mapped_region R;
-  const char* Buf;
-  const char* const Bend;
+  const uint64_t Size;
+  uint64_t Pos;
+  std::unique_ptr<bip::mapped_region> Cur, Next;
+  double FaultTime;
+};
+
+enum class Compression { NONE, GZIP, XZ, ZSTD };
+
+// Identify the compression format of a file by its magic bytes
+Compression sniffCompression(const std::string& path);
+
+// Whether this build can decompress the given format
+bool canDecompress(Compression c);
+
+const char* compressionName(Compression c);
+
+class Decompressor;
+
+//
+// Reads a compressed file, decompressing each block on the read thread
+// while the previous block is searched. The blocks, and so the offsets
+// of hits, are in decompressed coordinates.
+//
+class DecompressingReader: public Reader {
+public:
+  DecompressingReader(const std::string& path, Compression c, size_t blockSize);
+
+  virtual ~DecompressingReader();
+
+  virtual std::future<std::pair<const char*, size_t>> read(size_t len) override;
+
+private:
+  FILE* File;
+  std::unique_ptr<Decompressor> Dec;
+  std::unique_ptr<char[]> Cur, Next;
 };
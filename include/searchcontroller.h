@@ -17,17 +17,32 @@
  
  #pragma once
 
+#include "contextring.h"
+#include "hitcache.h"
 #include "hitwriter.h"
 #include "reader.h"
 
 #include <lightgrep/api.h>
 
+#include <memory>
+#include <string>
+#include <vector>
+
 class SearchController {
 public:
-  SearchController(uint32_t blkSize):
+  // With a nonzero context reach, hits are held until the input around
+  // them has been read, for callbacks which read the hit or its context,
+  // and the line of each is found if counting lines
+  SearchController(uint32_t blkSize, size_t contextReach = 0, bool countLines = false):
     BlockSize(blkSize),
     BytesSearched(0),
-    TotalTime(0.0) {}
+    HoleBytes(0),
+    DedupBytes(0),
+    TotalTime(0.0),
+    FaultTime(0.0),
+    StallTime(0.0),
+    Cache(nullptr),
+    Ring(contextReach ? new ContextRing(contextReach, countLines) : nullptr) {}
 
   bool searchFile(
     ContextHandle* searcher,
@@ -36,7 +51,25 @@ public:
     LG_HITCALLBACK_FN callback
   );
 
+  // Deliver the cached hits for a file instead of searching it again
+  void replayFile(
+    const std::string& path,
+    uint64_t size,
+    const std::vector<LG_SearchHit>& hits,
+    HitOutputData* hinfo,
+    LG_HITCALLBACK_FN callback
+  );
+
   size_t BlockSize;
-  uint64_t BytesSearched;
-  double TotalTime;
+  uint64_t BytesSearched,
+           HoleBytes,   // of BytesSearched, in holes not read from disk
+           DedupBytes;  // in duplicate files, not searched at all
+  double TotalTime,
+         FaultTime,  // spent by readers faulting in data ahead of the search
+         StallTime;  // spent by the search waiting on the reader
+
+  HitCache* Cache;  // if set, hits of files already searched
+
+private:
+  std::unique_ptr<ContextRing> Ring;
 };
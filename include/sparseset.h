@@ -17,9 +17,11 @@
 
 #pragma once
 
+#include "allocator.h"
 #include "basic.h"
 
 #include <algorithm>
+#include <vector>
 
 // for the time-being, we're only going to support uint32_t, but could obviously template
 // also, this doesn't work so well (er, at all) with values > 2^31-1
@@ -48,16 +50,15 @@ public:
   }
 
   void resize(uint32_t maxSize) {
-    Data.reset(new uint32_t[2 * maxSize]);
+    // sized by the program, so may be large enough for huge pages
+    decltype(Data)(2 * maxSize, 0).swap(Data);
     End = Max = maxSize;
-    // we don't have to do this, but it'll make things like valgrind happy
-    std::fill(Data.get(), Data.get() + maxSize, 0);
   }
 
   size_t max_size() const { return std::numeric_limits<uint32_t>::max()/2+1; }
 
 private:
-  std::unique_ptr<uint32_t[]> Data;
+  std::vector<uint32_t, HookAllocator<uint32_t>> Data;
   uint32_t End,
            Max;
 };
@@ -21,6 +21,7 @@
 #include <memory>
 #include <set>
 
+#include "allocator.h"
 #include "byteset.h"
 #include "transition.h"
 #include "states.h"
@@ -31,8 +32,10 @@ public:
     Byte(0), Either(0, 0), Range(0, 0), BSet(ByteSet()) {}
 
   ~TransitionFactory() {
-    std::for_each(Exemplars.begin(), Exemplars.end(),
-                  std::default_delete<Transition>());
+    // the arena frees the exemplars' memory all at once
+    for (Transition* t: Exemplars) {
+      t->~Transition();
+    }
   }
 
   Transition* getByte(byte b) {
@@ -124,10 +127,12 @@ public:
 
   Transition* get(Transition* t) {
     auto i = Exemplars.find(t);
-    return i == Exemplars.end() ? *Exemplars.insert(t->clone()).first : *i;
+    return i == Exemplars.end() ?
+      *Exemplars.insert(t->clone(Pool.alloc(t->objSize()))).first : *i;
   }
 
 private:
+  Arena Pool;
   std::set<Transition*, TransitionComparator> Exemplars;
 
   // Local states so we don't have to create one on each lookup
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#pragma once
+
+#include "basic.h"
+#include "byteset.h"
+#include "rangeset.h"
+
+#include <vector>
+
+//
+// The minimal deterministic automaton for the UTF-8 encodings of a set
+// of code points, with transitions on vertices as in our NFAs. Encodings
+// which end alike share their vertices, and no two vertices reached from
+// the same one take the same byte, so at most one thread runs through the
+// automaton per character.
+//
+struct UTF8Automaton {
+  static constexpr uint32_t NONE = 0xFFFFFFFF;
+
+  struct Vertex {
+    ByteSet Bytes;
+    std::vector<uint32_t> Next;
+    bool Final;
+  };
+
+  // each vertex comes after all of its successors
+  std::vector<Vertex> Vertices;
+
+  // the first vertices, in order of their smallest byte
+  std::vector<uint32_t> Heads;
+
+  // the head taking one-byte encodings, if any
+  uint32_t Single;
+
+  UTF8Automaton(const UnicodeSet& uset);
+};
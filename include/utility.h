@@ -24,6 +24,7 @@
 
 #include "automata.h"
 #include "pattern.h"
+#include "program.h"
 
 struct SearchInfo {};
 
@@ -52,10 +53,68 @@ uint32_t estimateGraphSize(const std::vector<T>& keywords) {
   return ret;
 }
 
+// b[i] holds the byte pairs which can occur at offsets i and i + stride
+// of a match, for each offset short of the minimum match length
+std::vector<std::bitset<256*256>> pairWindows(const NFA& graph, uint32_t stride = 1);
+
+std::pair<uint32_t,std::bitset<256*256>> bestPair(const std::vector<std::bitset<256*256>>& pairs);
+
 std::pair<uint32_t,std::bitset<256*256>> bestPair(const NFA& graph);
 
+// Whether every pair has a zero first byte, or every pair a zero second
+// byte, as with wide characters
+bool zeroPadded(const std::bitset<256*256>& pairs);
+
+// The best window of those which are not zero padded, or an offset of
+// pairs.size() if there is none
+std::pair<uint32_t,std::bitset<256*256>> bestWidePair(const std::vector<std::bitset<256*256>>& pairs);
+
+// Secondary prefilter windows to AND with the primary window at
+// primaryOff, chosen by how few keys they admit
+std::vector<FilterWindow> filterWindows(const NFA& graph, const std::vector<std::bitset<256*256>>& pairs, uint32_t primaryOff);
+
+std::vector<FilterWindow> filterWindows(const NFA& graph, const std::vector<std::bitset<256*256>>& pairs, uint32_t primaryOff, uint32_t primaryStride, const std::bitset<256*256>& primary);
+
 std::vector<std::vector<NFA::VertexDescriptor>> pivotStates(NFA::VertexDescriptor source, const NFA& graph);
 
 uint32_t maxOutbound(const std::vector<std::vector<NFA::VertexDescriptor>>& tranTable);
 
+// Copy the part of the (unfinalized) graph which leads to matches for
+// the given labels; match states are relabeled by position in labels.
+NFA labelSubgraph(const NFA& graph, const std::vector<uint32_t>& labels);
+
+// Copy the (unfinalized) graph to one which matches the XOR of each pair
+// of adjacent bytes of the matches instead of the bytes themselves, so
+// that its matches do not depend on any single-byte XOR key applied to
+// the input. A match of the copy spans one byte fewer than the match it
+// stands for, so matches of only one byte have nothing to stand for them.
+NFA differenceGraph(const NFA& graph);
+
+// The length in bytes of the longest match of the graph, or the largest
+// uint32_t if a loop lets matches be arbitrarily long
+uint32_t maxMatchLength(const NFA& graph);
+
+// Copy a pattern's (unfinalized) graph to one which matches the Base64
+// encodings of its matches, with the match beginning at any byte of a
+// three-byte group. Matches of the copy begin at the start of the group
+// and end with the character holding the last bits of the match.
+NFA base64Graph(const NFA& graph);
+
+// Split the labels 0..numLabels-1 into at most parts groups of similar
+// estimated cost, keeping patterns with the same leading bytes together.
+// Labels with no matches in the graph are left out.
+std::vector<std::vector<uint32_t>> partitionLabels(const NFA& graph, uint32_t numLabels, uint32_t parts);
+
+struct PatternStats {
+  uint32_t MaxFanOut;   // most successors one state has on a single byte
+  uint32_t Loops;       // cycles (strongly connected components) in the graph
+  uint32_t MinLength;   // shortest match length, in bytes
+  uint32_t FilterPairs; // byte pairs admitted by the best two-byte window
+  double Cost;          // relative estimated cost, for ranking
+};
+
+// Estimate the search cost of the pattern with the given label, using
+// only the portion of the (unfinalized) graph which leads to its matches.
+PatternStats analyzePattern(const NFA& graph, uint32_t label);
+
 void writeGraphviz(std::ostream& out, const NFA& graph);
@@ -21,6 +21,7 @@
 #include <set>
 #include <vector>
 
+#include "allocator.h"
 #include "basic.h"
 #include "sparseset.h"
 #include "vm_interface.h"
@@ -29,16 +30,24 @@
 class Vm: public VmInterface {
 public:
 
-  typedef std::vector<Thread> ThreadList;
+  typedef std::vector<Thread, HookAllocator<Thread>> ThreadList;
 
   Vm(ProgramPtr prog);
 
   virtual void startsWith(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData);
+  virtual void startsWithMany(const byte* const beg, const byte* const end, const uint64_t startOffset, const uint64_t* const offsets, const size_t num, HitCallback hitFn, void* userData);
   virtual uint64_t search(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData);
   virtual uint64_t searchResolve(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData);
+  virtual uint64_t searchZeros(const uint64_t count, const uint64_t startOffset, HitCallback hitFn, void* userData);
   virtual void closeOut(HitCallback hitFn, void* userData);
   virtual void reset();
 
+  virtual void setDedupThreads(bool dedup);
+
+  virtual void setMaxThreads(uint32_t maxThreads) { MaxThreads = maxThreads; }
+
+  virtual uint64_t droppedThreads() const { return DroppedThreads; }
+
   #ifdef LBT_TRACE_ENABLED
   void setDebugRange(uint64_t beg, uint64_t end) {
     BeginDebug = beg;
@@ -71,6 +80,9 @@ private:
   void _markLive(const uint32_t label);
   bool _liveCheck(const uint64_t start, const uint32_t label) const;
 
+  bool _dedupCheck(const uint64_t start, const uint32_t label) const;
+  void _pushNext(const Instruction* const base, ThreadList::iterator t, const uint64_t offset);
+
   bool _execute(const Instruction* const base, ThreadList::iterator t, const byte* const cur) const;
 
   template <uint32_t X>
@@ -86,7 +98,16 @@ private:
   void _executeFrame(const std::bitset<256*256>& filter, ThreadList::iterator t, const Instruction* const base, const byte* const cur, const uint64_t offset);
   void _executeFrame(ThreadList::iterator t, const Instruction* const base, const byte* const cur, const uint64_t offset);
 
-  void _cleanup();
+  bool _passesFilterWindows(const byte* const cur) const;
+
+  // the first offset from cur admitted by the primary filter, or end
+  const byte* _nextCandidate(const std::bitset<256*256>& filter, const byte* cur, const byte* const end) const;
+
+  // anchored threads all began at one offset, so none is ever shed
+  void _cleanup(const bool anchored = false);
+  void _shedThreads();
+
+  bool _startsWith(const Instruction* const base, const byte* const beg, const byte* const end, uint64_t offset);
 
   uint64_t _startOfLeftmostLiveThread(const uint64_t offset) const;
 
@@ -120,6 +141,14 @@ private:
 
   SparseSet CheckLabels;
 
+  bool DedupThreads;
+  SparseSet PCLocks;
+  std::vector<std::vector<uint32_t>> PCLockLabels;  // labels locked per PC
+  SparseSet StaleFinish;
+
+  uint32_t MaxThreads;
+  uint64_t DroppedThreads;
+
   bool LiveNoLabel;
   SparseSet Live;
 
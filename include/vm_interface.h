@@ -26,11 +26,24 @@ public:
   virtual ~VmInterface() {}
 
   virtual void startsWith(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData) = 0;
+  // startsWith() at each of num offsets into the buffer, in turn
+  virtual void startsWithMany(const byte* const beg, const byte* const end, const uint64_t startOffset, const uint64_t* const offsets, const size_t num, HitCallback hitFn, void* userData) = 0;
   virtual uint64_t search(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData) = 0;
   virtual uint64_t searchResolve(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData) = 0;
+  // Search as though a buffer of count zero bytes had been passed
+  virtual uint64_t searchZeros(const uint64_t count, const uint64_t startOffset, HitCallback hitFn, void* userData) = 0;
   virtual void closeOut(HitCallback hitFn, void* userData) = 0;
   virtual void reset() = 0;
 
+  // Enable per-frame deduplication of threads by PC and label
+  virtual void setDedupThreads(bool dedup) = 0;
+
+  // Limit the number of live threads; 0 is unlimited
+  virtual void setMaxThreads(uint32_t maxThreads) = 0;
+
+  // Number of threads dropped due to the limit since the last reset
+  virtual uint64_t droppedThreads() const = 0;
+
   #ifdef LBT_TRACE_ENABLED
   virtual void setDebugRange(uint64_t beg, uint64_t end) = 0;
   #endif
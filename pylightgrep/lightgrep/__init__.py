@@ -20,10 +20,12 @@
 #
 
 import collections
+from concurrent.futures import ThreadPoolExecutor
 from ctypes import *
 import os
 from pathlib import Path
 import sys
+import threading
 
 #
 # Library initialization
@@ -117,6 +119,15 @@ def buf_end(buf, ptype):
     return buf_range(buf, ptype)[1]
 
 
+def byte_view(buf) -> memoryview:
+    # A flat view of the bytes of any object supporting the buffer protocol,
+    # e.g., a numpy array of any dtype or shape, without copying them
+    view = memoryview(buf)
+    if view.ndim == 1 and view.itemsize == 1:
+        return view
+    return view.cast('B')
+
+
 #
 # Structs
 #
@@ -208,24 +219,32 @@ class KeyOpts(Structure):
 
 
 class ProgOpts(Structure):
-    _fields_ = [("DeterminizeDepth", c_uint32)]
+    _fields_ = [
+        ("DeterminizeDepth", c_uint32),
+        ("Partitions", c_uint32)
+    ]
 
-    def __init__(self, determinizeDepth: int = 10):
+    def __init__(self, determinizeDepth: int = 10, partitions: int = 1):
         super().__init__()
         self.DeterminizeDepth = determinizeDepth
+        self.Partitions = partitions
 
 
 class CtxOpts(Structure):
     # argh, this crap shouldn't even be exposed
     _fields_ = [
         ("TraceBegin", c_uint64),
-        ("TraceEnd", c_uint64)
+        ("TraceEnd", c_uint64),
+        ("DedupThreads", c_char),
+        ("MaxThreads", c_uint32)
     ]
 
-    def __init__(self):
+    def __init__(self, dedupThreads: bool = False, maxThreads: int = 0):
         super().__init__()
         self.TraceBegin = 0xFFFFFFFFFFFFFFFF
         self.TraceEnd = 0
+        self.DedupThreads = char_cast_bool(dedupThreads)
+        self.MaxThreads = maxThreads
 
 
 class SearchHit(Structure):
@@ -394,6 +413,33 @@ class Program(Handle):
         _LG.lg_write_program(self.get(), c_buf)
         return buf
 
+    def patternInfo(self, idx: int):
+        return _LG.lg_prog_pattern_info(self.get(), idx).contents
+
+    def search_many(self, buffers, threads: int = 1, ctxOpts=None):
+        # Search each buffer whole, up to threads of them at once, each
+        # thread with its own context. Returns the hits of each buffer, as
+        # Context.searchHits() does, in the order of the buffers. The
+        # searches do not hold the GIL, so they run in parallel.
+        self.throw_if_closed()
+        opts = ctxOpts if ctxOpts is not None else CtxOpts()
+        local = threading.local()
+        contexts = []
+
+        def search(buf):
+            ctx = getattr(local, 'ctx', None)
+            if ctx is None:
+                ctx = local.ctx = Context(self, opts)
+                contexts.append(ctx)
+            return ctx.searchHits(buf)
+
+        try:
+            with ThreadPoolExecutor(max_workers=max(1, threads)) as pool:
+                return list(pool.map(search, buffers))
+        finally:
+            for ctx in contexts:
+                ctx.close()
+
 
 class Context(Handle):
     def __init__(self, prog, opts):
@@ -407,6 +453,9 @@ class Context(Handle):
     def reset(self) -> None:
         _LG.lg_reset_context(self.get())
 
+    def droppedThreads(self) -> int:
+        return _LG.lg_context_dropped_threads(self.get())
+
     def search(self, data, startOffset, accumulator):
         self.prog.throw_if_closed()
         beg, end = buf_range(data, c_char)
@@ -433,6 +482,31 @@ class Context(Handle):
         self.reset()
         return len(accumulator.Hits)
 
+    def searchHits(self, data, startOffset: int = 0):
+        # Search the whole of data, which may be any object supporting the
+        # buffer protocol. The library collects the hits, rather than calling
+        # back into Python for each, so the GIL is released for the whole
+        # search. Returns an array of SearchHit, whose KeywordIndex can be
+        # passed to Program.patternInfo(); the array supports the buffer
+        # protocol too, e.g., for numpy.frombuffer().
+        self.prog.throw_if_closed()
+        hits = POINTER(SearchHit)()
+        num = c_size_t()
+
+        with byte_view(data) as view:
+            beg, end = buf_range(view, c_char)
+            with Error() as err:
+                _LG.lg_search_hits(self.get(), beg, end, startOffset, byref(hits), byref(num), byref(err.get()))
+                if err:
+                    raise RuntimeError(f"Error searching: {err}")
+
+        try:
+            out = (SearchHit * num.value)()
+            memmove(out, hits, sizeof(out))
+        finally:
+            _LG.lg_free_hits(hits)
+        return out
+
 
 def _the_callback_impl(holder, hitPtr):
     idx = hitPtr.contents.KeywordIndex
@@ -583,6 +657,9 @@ _LG.lg_starts_with.restype = None
 _LG.lg_reset_context.argtypes = [c_void_p]
 _LG.lg_reset_context.restype = None
 
+_LG.lg_context_dropped_threads.argtypes = [c_void_p]
+_LG.lg_context_dropped_threads.restype = c_uint64
+
 _LG.lg_search.argtypes = [c_void_p, POINTER(c_char), POINTER(c_char), c_uint64, py_object, _CBType]
 _LG.lg_search.restype = c_void_p
 
@@ -592,6 +669,12 @@ _LG.lg_closeout_search.restype = None
 _LG.lg_search_resolve.argtypes = [c_void_p, POINTER(c_char), POINTER(c_char), c_uint64, py_object, _CBType]
 _LG.lg_search_resolve.restype = c_uint64
 
+_LG.lg_search_hits.argtypes = [c_void_p, POINTER(c_char), POINTER(c_char), c_uint64, POINTER(POINTER(SearchHit)), POINTER(c_size_t), POINTER(POINTER(Err))]
+_LG.lg_search_hits.restype = c_int
+
+_LG.lg_free_hits.argtypes = [POINTER(SearchHit)]
+_LG.lg_free_hits.restype = None
+
 #
 # util.h
 #
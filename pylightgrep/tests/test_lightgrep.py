@@ -494,6 +494,73 @@ class ContextTests(unittest.TestCase):
         self.ctx.searchBufferStartswith(buf, acc)
         self.assertEqual(acc.Hits, exp_hits)
 
+    def test_searchHits_ctx_closed(self):
+        self.ctx.close()
+        with self.assertRaises(RuntimeError):
+            self.ctx.searchHits(b'xxx')
+
+    def test_searchHits_prog_closed(self):
+        self.prog.close()
+        with self.assertRaises(RuntimeError):
+            self.ctx.searchHits(b'xxx')
+
+    def test_searchHits_bad_args(self):
+        arglist = [b'xxx']
+        subs = (None, 'bogus')
+        fuzz_it(self, self.ctx.searchHits, arglist, subs)
+
+    def test_searchHits(self):
+        buf = b'xxxyyyaaaabcdef ab'
+        hits = self.ctx.searchHits(buf, 100)
+        self.assertEqual(
+            [(h.Start, h.End, h.KeywordIndex) for h in hits],
+            [(106, 111, 0), (116, 118, 0)]
+        )
+
+        info = self.prog.patternInfo(hits[0].KeywordIndex)
+        self.assertEqual(info.pat(), 'a+b')
+        self.assertEqual(info.userIdx(), 42)
+
+        # the hits are packed, and can be viewed without copying
+        view = memoryview(hits)
+        self.assertEqual(view.nbytes, 2 * ctypes.sizeof(lightgrep.SearchHit))
+
+        # the context is left reset
+        self.assertEqual(len(self.ctx.searchHits(b'aab')), 1)
+
+    def test_searchHits_buffer_types(self):
+        buf = b'xxxyyyaaaabcdef\x00\x00abx'
+        exp = [(6, 11), (17, 19)]
+
+        for data in (
+            buf,
+            bytearray(buf),
+            memoryview(buf),
+            memoryview(buf)[:],
+            array.array('B', buf),
+            array.array('H', buf),
+            memoryview(bytearray(buf)).cast('B', (4, 5))
+        ):
+            with self.subTest(data=data):
+                hits = self.ctx.searchHits(data)
+                self.assertEqual([(h.Start, h.End) for h in hits], exp)
+
+        self.assertEqual(len(self.ctx.searchHits(b'')), 0)
+
+    def test_search_many_prog_closed(self):
+        self.prog.close()
+        with self.assertRaises(RuntimeError):
+            self.prog.search_many([b'xxx'])
+
+    def test_search_many(self):
+        bufs = [b'ab' * i + b'x' * (i % 7) + b'aaab' for i in range(50)]
+        exp = [[(h.Start, h.End) for h in self.ctx.searchHits(b)] for b in bufs]
+
+        for threads in (1, 4):
+            with self.subTest(threads=threads):
+                res = self.prog.search_many(bufs, threads=threads)
+                self.assertEqual([[(h.Start, h.End) for h in hits] for hits in res], exp)
+
 
 class HitDecoderSimpleTests(unittest.TestCase):
     def test_close_unused(self):
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "contenthash.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const uint64_t P1 = 0x9E3779B185EBCA87ull,
+               P2 = 0xC2B2AE3D27D4EB4Full,
+               P3 = 0x165667B19E3779F9ull,
+               P4 = 0x85EBCA77C2B2AE63ull;
+
+uint64_t rotl(uint64_t x, unsigned int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+uint64_t fmix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xFF51AFD7ED558CCDull;
+  x ^= x >> 33;
+  x *= 0xC4CEB9FE1A85EC53ull;
+  x ^= x >> 33;
+  return x;
+}
+
+void mixWord(uint64_t& a, uint64_t& b, uint64_t w) {
+  a = rotl(a + w * P2, 31) * P1;
+  b = rotl(b ^ (w * P4), 27) * P3 + P2;
+}
+
+}
+
+ContentHasher::ContentHasher():
+  A(P1 + P2), B(P3 ^ P4), Size(0), TailLen(0)
+{}
+
+void ContentHasher::update(const char* beg, const char* end) {
+  Size += end - beg;
+
+  // finish any word left over from the last update
+  if (TailLen) {
+    const size_t n = std::min(sizeof(Tail) - TailLen, static_cast<size_t>(end - beg));
+    std::memcpy(Tail + TailLen, beg, n);
+    TailLen += n;
+    beg += n;
+
+    if (TailLen < sizeof(Tail)) {
+      return;
+    }
+
+    uint64_t w;
+    std::memcpy(&w, Tail, sizeof(w));
+    mixWord(A, B, w);
+    TailLen = 0;
+  }
+
+  for ( ; end - beg >= 8; beg += 8) {
+    uint64_t w;
+    std::memcpy(&w, beg, sizeof(w));
+    mixWord(A, B, w);
+  }
+
+  std::memcpy(Tail, beg, end - beg);
+  TailLen = end - beg;
+}
+
+ContentKey ContentHasher::finish() const {
+  uint64_t a = A, b = B;
+  if (TailLen) {
+    // the size, mixed in below, tells zero padding from zero bytes
+    uint64_t w = 0;
+    std::memcpy(&w, Tail, TailLen);
+    mixWord(a, b, w);
+  }
+
+  a ^= Size;
+  b ^= Size * P1;
+  return ContentKey{Size, {fmix(a + b), fmix(b ^ rotl(a, 32))}};
+}
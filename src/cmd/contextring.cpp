@@ -0,0 +1,161 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "contextring.h"
+
+#include <algorithm>
+#include <cstring>
+
+ContextRing::ContextRing(size_t reach, bool countLines):
+  Reach(reach), CountLines(countLines)
+{
+  reset();
+}
+
+void ContextRing::reset() {
+  Kept.clear();
+  KeptOff = 0;
+  Cur = Next = nullptr;
+  CurLen = NextLen = 0;
+  CurOff = 0;
+  CurLines = 0;
+  CurIndex.reset(nullptr, 0);
+  KeptIndex.reset(nullptr, 0);
+  Scratch.clear();
+  ScratchOff = 0;
+  Held.clear();
+  First = 0;
+}
+
+void ContextRing::advance(const char* buf, size_t len, uint64_t off) {
+  // keep Reach bytes before the new block, and whatever the held hits
+  // still need, which may reach further back
+  uint64_t need = off - std::min(off, static_cast<uint64_t>(Reach));
+  for (size_t i = First; i < Held.size(); ++i) {
+    const uint64_t s = Held[i].Start;
+    need = std::min(need, s - std::min(s, static_cast<uint64_t>(Reach)));
+  }
+
+  if (need > KeptOff) {
+    const size_t drop = std::min(need - KeptOff, static_cast<uint64_t>(Kept.size()));
+    Kept.erase(0, drop);
+  }
+
+  const uint64_t from = std::max(need, CurOff);
+  if (from < CurOff + CurLen) {
+    Kept.append(Cur + (from - CurOff), CurOff + CurLen - from);
+  }
+  KeptOff = off - Kept.size();
+
+  if (CountLines) {
+    CurLines += CurIndex.count();
+    CurIndex.reset(buf, len);
+    KeptIndex.reset(Kept.data(), Kept.size());
+  }
+
+  Cur = buf;
+  CurLen = len;
+  CurOff = off;
+  Next = nullptr;
+  NextLen = 0;
+
+  Held.erase(Held.begin(), Held.begin() + First);
+  First = 0;
+}
+
+void ContextRing::hold(void* userData, const LG_SearchHit* const hit) {
+  static_cast<ContextRing*>(userData)->Held.push_back(*hit);
+}
+
+void ContextRing::release(const char* next, size_t nlen, bool eof, HitOutputData* hinfo, LG_HITCALLBACK_FN callback) {
+  Next = next;
+  NextLen = nlen;
+
+  const uint64_t end = CurOff + CurLen + NextLen;
+
+  // hits are written in the order found, so one still waiting for input
+  // holds back those after it
+  for ( ; First < Held.size(); ++First) {
+    const LG_SearchHit& hit = Held[First];
+    if (!eof && hit.End + Reach > end) {
+      break;
+    }
+
+    const uint64_t wbeg = std::max(hit.Start - std::min(hit.Start, static_cast<uint64_t>(Reach)), KeptOff);
+    const uint64_t wend = std::min(std::max(hit.End, wbeg) + Reach, end);
+    window(wbeg, wend, hinfo);
+    if (CountLines) {
+      hinfo->OutInfo.Line = linesBefore(hit.Start) + 1;
+    }
+    callback(hinfo, &hit);
+  }
+}
+
+uint64_t ContextRing::linesBefore(uint64_t off) {
+  if (off >= CurOff) {
+    return CurLines + CurIndex.before(off - CurOff);
+  }
+
+  // a hit which began before the current block, or was held past it; the
+  // kept input reaches back at least as far as the hit does, unless it
+  // is very long
+  off = std::max(off, KeptOff);
+  return CurLines - KeptIndex.count() + KeptIndex.before(off - KeptOff);
+}
+
+void ContextRing::window(uint64_t off, uint64_t end, HitOutputData* hinfo) {
+  const uint64_t curEnd = CurOff + CurLen;
+
+  if (off >= CurOff && end <= curEnd) {
+    hinfo->setBuffer(Cur + (off - CurOff), end - off, off);
+  }
+  else if (off >= curEnd) {
+    hinfo->setBuffer(Next + (off - curEnd), end - off, off);
+  }
+  else if (end <= CurOff) {
+    hinfo->setBuffer(Kept.data() + (off - KeptOff), end - off, off);
+  }
+  else {
+    if (off < ScratchOff || end > ScratchOff + Scratch.size()) {
+      // stitch a little past this hit's window, for the hits after it
+      const uint64_t send = std::min(end + Reach, curEnd + NextLen);
+      Scratch.resize(send - off);
+      copy(off, send, &Scratch[0]);
+      ScratchOff = off;
+    }
+    hinfo->setBuffer(Scratch.data() + (off - ScratchOff), end - off, off);
+  }
+}
+
+void ContextRing::copy(uint64_t off, uint64_t end, char* dst) const {
+  const uint64_t curEnd = CurOff + CurLen;
+  const struct {
+    const char* Buf;
+    uint64_t Beg, End;
+  } pieces[] = {
+    { Kept.data(), KeptOff, CurOff },
+    { Cur, CurOff, curEnd },
+    { Next, curEnd, curEnd + NextLen }
+  };
+
+  for (const auto& p: pieces) {
+    const uint64_t b = std::max(off, p.Beg), e = std::min(end, p.End);
+    if (b < e) {
+      std::memcpy(dst + (b - off), p.Buf + (b - p.Beg), e - b);
+    }
+  }
+}
@@ -0,0 +1,260 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "histogram.h"
+#include "contenthash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+bool histogramKeyComp(const LG_Histogram::value_type& a, const LG_Histogram::value_type& b) {
+  // order descending by count, then ascending by user index and hit text
+  return (a.second > b.second)
+      || (a.second == b.second && (a.first.UserIndex < b.first.UserIndex
+                                    || (a.first.UserIndex == b.first.UserIndex && a.first.HitText < b.first.HitText)));
+}
+
+std::ostream& operator<<(std::ostream& out, const HistogramKey& hKey) {
+  out << hKey.HitText << ", " << hKey.Pattern << ", " << hKey.UserIndex;
+  return out;
+}
+
+std::ostream& operator<<(std::ostream& out, const LG_Histogram& histogram) {
+  for (const auto& [hKey, count] : histogram) {
+    out << "[" << hKey << "]: " << count << std::endl;
+  }
+  return out;
+}
+
+std::string escapeControlChars(const std::string& str) {
+  std::string escaped;
+  escaped.reserve(str.size() + 4); // give some extra space for escaped characters
+  for (const char c : str) {
+    switch(c) {
+      case '\a':
+        escaped += "\\a";
+        continue;
+      case '\b':
+        escaped += "\\b";
+        continue;
+      case '\t':
+        escaped += "\\t";
+        continue;
+      case '\n':
+        escaped += "\\n";
+        continue;
+      case '\v':
+        escaped += "\\v";
+        continue;
+      case '\f':
+        escaped += "\\f";
+        continue;
+      case '\r':
+        escaped += "\\r";
+        continue;
+      default:
+        escaped += c;
+    }
+  }
+  return escaped;
+}
+
+HitHistogram::HitHistogram(uint32_t topK):
+  TopK(topK), Floor(0), Used(0), Slots(64)
+{}
+
+uint32_t HitHistogram::intern(const char* pattern, uint64_t userIndex) {
+  std::string key(pattern);
+  key.push_back('\0');
+  key.append(reinterpret_cast<const char*>(&userIndex), sizeof(userIndex));
+
+  const auto i = PatternIds.emplace(std::move(key), Patterns.size());
+  if (i.second) {
+    Patterns.emplace_back(pattern, userIndex);
+  }
+  return i.first->second;
+}
+
+HitHistogram::Entry& HitHistogram::slot(uint64_t hash, uint32_t pat, const char* text, size_t len) {
+  // linear probing; Slots.size() is a power of two
+  const size_t mask = Slots.size() - 1;
+  for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+    Entry& e = Slots[i];
+    if (!e.Count || (
+          e.Hash == hash && e.Pattern == pat && e.TextLen == len &&
+          !std::memcmp(Arena.data() + e.TextOff, text, len)
+        ))
+    {
+      return e;
+    }
+  }
+}
+
+void HitHistogram::add(uint32_t keywordIndex, const LG_PatternInfo* info, const char* text, size_t len) {
+  if (keywordIndex >= KeywordPatterns.size()) {
+    KeywordPatterns.resize(keywordIndex + 1, NONE);
+  }
+
+  uint32_t& pat = KeywordPatterns[keywordIndex];
+  if (pat == NONE) {
+    pat = intern(info->Pattern, info->UserIndex);
+  }
+
+
+  ContentHasher h;
+  h.update(reinterpret_cast<const char*>(&pat), reinterpret_cast<const char*>(&pat + 1));
+  h.update(text, text + len);
+  const uint64_t hash = h.finish().Hash[0];
+
+  Entry* e = &slot(hash, pat, text, len);
+  if (e->Count) {
+    ++e->Count;
+    return;
+  }
+
+  if (TopK && Used == 2 * size_t(TopK)) {
+    prune();
+    e = &slot(hash, pat, text, len);
+  }
+  else if (10 * (Used + 1) > 7 * Slots.size()) {
+    rehash(2 * Slots.size());
+    e = &slot(hash, pat, text, len);
+  }
+
+  *e = Entry{hash, Arena.size(), Floor + 1, Floor, static_cast<uint32_t>(len), pat};
+  Arena.append(text, len);
+  ++Used;
+}
+
+void HitHistogram::rehash(size_t capacity) {
+  std::vector<Entry> old(capacity);
+  old.swap(Slots);
+
+  const size_t mask = Slots.size() - 1;
+  for (const Entry& e: old) {
+    if (e.Count) {
+      size_t i = e.Hash & mask;
+      while (Slots[i].Count) {
+        i = (i + 1) & mask;
+      }
+      Slots[i] = e;
+    }
+  }
+}
+
+void HitHistogram::prune() {
+  std::vector<Entry> entries;
+  entries.reserve(Used);
+  for (const Entry& e: Slots) {
+    if (e.Count) {
+      entries.push_back(e);
+    }
+  }
+
+  const auto keep = entries.begin() + TopK;
+  std::nth_element(
+    entries.begin(), keep, entries.end(),
+    [](const Entry& a, const Entry& b) { return a.Count > b.Count; }
+  );
+
+  for (auto i = keep; i != entries.end(); ++i) {
+    Floor = std::max(Floor, i->Count);
+  }
+  entries.erase(keep, entries.end());
+
+  // copy out the text of the kept entries, dropping the rest
+  std::string arena;
+  for (Entry& e: entries) {
+    const uint64_t off = arena.size();
+    arena.append(Arena, e.TextOff, e.TextLen);
+    e.TextOff = off;
+  }
+  Arena.swap(arena);
+
+  std::fill(Slots.begin(), Slots.end(), Entry{0, 0, 0, 0, 0, 0});
+  const size_t mask = Slots.size() - 1;
+  for (const Entry& e: entries) {
+    size_t i = e.Hash & mask;
+    while (Slots[i].Count) {
+      i = (i + 1) & mask;
+    }
+    Slots[i] = e;
+  }
+  Used = entries.size();
+}
+
+std::vector<const HitHistogram::Entry*> HitHistogram::sorted() const {
+  std::vector<const Entry*> entries;
+  entries.reserve(Used);
+  for (const Entry& e: Slots) {
+    if (e.Count) {
+      entries.push_back(&e);
+    }
+  }
+
+  std::sort(entries.begin(), entries.end(),
+    [this](const Entry* a, const Entry* b) {
+      // order descending by count, then ascending by user index, hit
+      // text, and pattern
+      if (a->Count - a->Error != b->Count - b->Error) {
+        return a->Count - a->Error > b->Count - b->Error;
+      }
+
+      const auto& pa = Patterns[a->Pattern];
+      const auto& pb = Patterns[b->Pattern];
+      if (pa.second != pb.second) {
+        return pa.second < pb.second;
+      }
+
+      const std::string_view ta(Arena.data() + a->TextOff, a->TextLen),
+                             tb(Arena.data() + b->TextOff, b->TextLen);
+      if (ta != tb) {
+        return ta < tb;
+      }
+
+      return pa.first < pb.first;
+    }
+  );
+
+  if (TopK && entries.size() > TopK) {
+    entries.resize(TopK);
+  }
+  return entries;
+}
+
+LG_Histogram HitHistogram::toMap() const {
+  LG_Histogram hist;
+  for (const Entry& e: Slots) {
+    if (e.Count) {
+      const auto& p = Patterns[e.Pattern];
+      hist[HistogramKey{Arena.substr(e.TextOff, e.TextLen), p.first, p.second}] = e.Count - e.Error;
+    }
+  }
+  return hist;
+}
+
+void HitHistogram::write(std::ostream& out, char sep) const {
+  for (const Entry* e: sorted()) {
+    const auto& p = Patterns[e->Pattern];
+    out << e->Count - e->Error << sep
+        << escapeControlChars(Arena.substr(e->TextOff, e->TextLen)) << sep
+        << p.second << sep
+        << escapeControlChars(p.first) << '\n';
+  }
+}
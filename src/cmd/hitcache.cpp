@@ -0,0 +1,143 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "hitcache.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+
+namespace {
+
+const char MAGIC[4] = {'L', 'G', 'H', 'C'};
+const uint32_t VERSION = 1;
+
+template <typename T>
+void put(std::ostream& out, const T& v) {
+  out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+template <typename T>
+bool get(std::istream& in, T& v) {
+  return bool(in.read(reinterpret_cast<char*>(&v), sizeof(v)));
+}
+
+void putKey(std::ostream& out, const ContentKey& k) {
+  put(out, k.Size);
+  put(out, k.Hash[0]);
+  put(out, k.Hash[1]);
+}
+
+bool getKey(std::istream& in, ContentKey& k) {
+  return get(in, k.Size) && get(in, k.Hash[0]) && get(in, k.Hash[1]);
+}
+
+}
+
+ContentKey hashFile(const std::string& path) {
+  std::unique_ptr<FILE, int(*)(FILE*)> f(std::fopen(path.c_str(), "rb"), std::fclose);
+  if (!f) {
+    throw std::runtime_error(std::strerror(errno));
+  }
+
+  const size_t blockSize = 1 << 20;
+  std::unique_ptr<char[]> buf(new char[blockSize]);
+
+  ContentHasher h;
+  size_t len;
+  while ((len = std::fread(buf.get(), 1, blockSize, f.get()))) {
+    h.update(buf.get(), buf.get() + len);
+  }
+
+  if (std::ferror(f.get())) {
+    throw std::runtime_error(std::strerror(errno));
+  }
+  return h.finish();
+}
+
+const std::vector<LG_SearchHit>* HitCache::find(const ContentKey& key) const {
+  const auto i = Entries.find(key);
+  return i == Entries.end() ? nullptr : &i->second;
+}
+
+void HitCache::insert(const ContentKey& key, std::vector<LG_SearchHit> hits) {
+  Entries[key] = std::move(hits);
+}
+
+bool HitCache::load(std::istream& in) {
+  char magic[sizeof(MAGIC)];
+  uint32_t version;
+  ContentKey program;
+  uint64_t count;
+
+  if (!in.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, MAGIC, sizeof(MAGIC)) ||
+      !get(in, version) || version != VERSION ||
+      !getKey(in, program) || program != Program ||
+      !get(in, count))
+  {
+    return false;
+  }
+
+  // read everything before adding any of it, so a truncated file adds
+  // nothing
+  std::vector<std::pair<ContentKey, std::vector<LG_SearchHit>>> entries;
+  for (uint64_t i = 0; i < count; ++i) {
+    ContentKey key;
+    uint64_t numHits;
+    if (!getKey(in, key) || !get(in, numHits)) {
+      return false;
+    }
+
+    std::vector<LG_SearchHit> hits;
+    for (uint64_t j = 0; j < numHits; ++j) {
+      LG_SearchHit hit;
+      if (!get(in, hit.Start) || !get(in, hit.End) || !get(in, hit.KeywordIndex)) {
+        return false;
+      }
+      hits.push_back(hit);
+    }
+
+    entries.emplace_back(key, std::move(hits));
+  }
+
+  for (auto& e: entries) {
+    Entries[e.first] = std::move(e.second);
+  }
+  return true;
+}
+
+void HitCache::save(std::ostream& out) const {
+  out.write(MAGIC, sizeof(MAGIC));
+  put(out, VERSION);
+  putKey(out, Program);
+  put(out, static_cast<uint64_t>(Entries.size()));
+
+  for (const auto& e: Entries) {
+    putKey(out, e.first);
+    put(out, static_cast<uint64_t>(e.second.size()));
+    for (const LG_SearchHit& hit: e.second) {
+      put(out, hit.Start);
+      put(out, hit.End);
+      put(out, hit.KeywordIndex);
+    }
+  }
+}
@@ -52,139 +52,310 @@ const char* find_trailing_context(const char* const hend, const char* const bend
   return rnl;
 }
 
-bool histogramKeyComp(const LG_Histogram::value_type& a, const LG_Histogram::value_type& b) {
-  // order descending by count, then ascending by user index and hit text
-  return (a.second > b.second)
-      || (a.second == b.second && (a.first.UserIndex < b.first.UserIndex 
-                                    || (a.first.UserIndex == b.first.UserIndex && a.first.HitText < b.first.HitText)));
+void WritePath::write(HitOutputData& data) {
+  data.OutInfo.writePath();
 }
 
-std::ostream& operator<<(std::ostream& out, const HistogramKey& hKey) {
-  out << hKey.HitText << ", " << hKey.Pattern << ", " << hKey.UserIndex;
-  return out;
+void WriteContext::writeGroupSeparator(HitOutputData& data) {
+  data.writeGroupSeparator();
 }
 
-std::ostream& operator<<(std::ostream& out, const LG_Histogram& histogram) {
-  for (const auto& [hKey, count] : histogram) {
-    out << "[" << hKey << "]: " << count << std::endl;
+/********************************************* OutputInfo ****************************************/
+
+namespace {
+
+// The length of the well-formed UTF-8 sequence at s, or 0 if there is none
+size_t utf8SeqLen(const unsigned char* s, const unsigned char* end) {
+  size_t len;
+  unsigned char lo = 0x80, hi = 0xBF;  // bounds of the second byte
+
+  if (*s < 0x80) {
+    return 1;
+  }
+  else if (*s < 0xC2) {
+    return 0;
+  }
+  else if (*s < 0xE0) {
+    len = 2;
   }
-  return out;
+  else if (*s < 0xF0) {
+    len = 3;
+    if (*s == 0xE0) {
+      lo = 0xA0;  // overlong
+    }
+    else if (*s == 0xED) {
+      hi = 0x9F;  // surrogate
+    }
+  }
+  else if (*s < 0xF5) {
+    len = 4;
+    if (*s == 0xF0) {
+      lo = 0x90;  // overlong
+    }
+    else if (*s == 0xF4) {
+      hi = 0x8F;  // past U+10FFFF
+    }
+  }
+  else {
+    return 0;
+  }
+
+  if (static_cast<size_t>(end - s) < len || s[1] < lo || s[1] > hi) {
+    return 0;
+  }
+
+  for (size_t i = 2; i < len; ++i) {
+    if ((s[i] & 0xC0) != 0x80) {
+      return 0;
+    }
+  }
+  return len;
 }
 
-void WritePath::write(HitOutputData& data) {
-  data.OutInfo.Out << data.OutInfo.Path << data.OutInfo.Separator;
+//
+// JSON strings must be UTF-8, but paths and patterns need not be; a byte
+// which is not part of a well-formed sequence is written as the code
+// point of the same value, \u0080 to \u00ff.
+//
+void appendJsonString(OutputBuffer& out, const char* s, const char* end) {
+  static const char hex[] = "0123456789abcdef";
+
+  out.append('"');
+  for (const char* r; s != end; s = r + 1) {
+    r = std::find_if(s, end, [](unsigned char c){ return c < 0x20 || c == '"' || c == '\\' || c >= 0x80; });
+    out.append(s, r - s);
+    if (r == end) {
+      break;
+    }
+
+    const unsigned char c = *r;
+    if (c >= 0x80) {
+      const size_t n = utf8SeqLen(
+        reinterpret_cast<const unsigned char*>(r),
+        reinterpret_cast<const unsigned char*>(end)
+      );
+      if (n) {
+        out.append(r, n);
+        r += n - 1;
+        continue;
+      }
+    }
+
+    out.append('\\');
+    switch (c) {
+    case '"':  out.append('"');  break;
+    case '\\': out.append('\\'); break;
+    case '\t': out.append('t');  break;
+    case '\n': out.append('n');  break;
+    case '\r': out.append('r');  break;
+    default:
+      out.append("u00", 3);
+      out.append(hex[c >> 4]);
+      out.append(hex[c & 0xF]);
+    }
+  }
+  out.append('"');
 }
 
-void WriteContext::writeGroupSeparator(HitOutputData& data) {
-  data.writeGroupSeparator();
+void appendJsonString(OutputBuffer& out, const char* s) {
+  appendJsonString(out, s, s + std::strlen(s));
 }
 
-/********************************************* OutputInfo ****************************************/
+template <typename L>
+void appendBytes(OutputBuffer& out, const char* s, size_t len) {
+  out.appendRaw(static_cast<L>(len));
+  out.append(s, len);
+}
+
+}
+
+OutputInfo::OutputInfo(std::ostream& out, int32_t beforeContext, int32_t afterContext, char separator, const std::string& groupSep, HitFormat format, bool threaded):
+  Out(out, threaded), Path(), BeforeContext(beforeContext), AfterContext(afterContext),
+  Separator(separator), GroupSeparator(groupSep), Format(format),
+  InRecord(false), PathWritten(false)
+{}
+
+void OutputInfo::writePath() {
+  switch (Format) {
+  case HitFormat::TSV:
+    Out.append(Path);
+    Out.append(Separator);
+    break;
+  case HitFormat::NDJSON:
+    Out.append("{\"path\":", 8);
+    appendJsonString(Out, Path.data(), Path.data() + Path.size());
+    Out.append(',');
+    InRecord = true;
+    break;
+  case HitFormat::BINARY:
+    // the path is written once, ahead of all the hits in it
+    if (!PathWritten) {
+      Out.append('P');
+      appendBytes<uint32_t>(Out, Path.data(), Path.size());
+      PathWritten = true;
+    }
+    break;
+  }
+}
 
 void OutputInfo::writeHit(const LG_SearchHit& hit, const LG_PatternInfo* info) {
-  Out << hit.Start << '\t'
-      << hit.End << '\t'
-      << info->UserIndex << '\t'
-      << info->Pattern << '\t'
-      << info->EncodingChain;
+  switch (Format) {
+  case HitFormat::TSV:
+    if (LineNumbers) {
+      Out.appendNum(Line);
+      Out.append('\t');
+    }
+    Out.appendNum(hit.Start);
+    Out.append('\t');
+    Out.appendNum(hit.End);
+    Out.append('\t');
+    Out.appendNum(info->UserIndex);
+    Out.append('\t');
+    Out.append(info->Pattern, std::strlen(info->Pattern));
+    Out.append('\t');
+    Out.append(info->EncodingChain, std::strlen(info->EncodingChain));
+    break;
+  case HitFormat::NDJSON:
+    if (!InRecord) {
+      Out.append('{');
+    }
+    if (LineNumbers) {
+      Out.append("\"line\":", 7);
+      Out.appendNum(Line);
+      Out.append(',');
+    }
+    Out.append("\"start\":", 8);
+    Out.appendNum(hit.Start);
+    Out.append(",\"end\":", 7);
+    Out.appendNum(hit.End);
+    Out.append(",\"index\":", 9);
+    Out.appendNum(info->UserIndex);
+    Out.append(",\"pattern\":", 11);
+    appendJsonString(Out, info->Pattern);
+    Out.append(",\"encoding\":", 12);
+    appendJsonString(Out, info->EncodingChain);
+    InRecord = true;
+    break;
+  case HitFormat::BINARY:
+    if (LineNumbers) {
+      Out.append('L');
+      Out.appendRaw(Line);
+    }
+    Out.append('H');
+    Out.appendRaw(hit.Start);
+    Out.appendRaw(hit.End);
+    Out.appendRaw(hit.KeywordIndex);
+    break;
+  }
 }
 
 void OutputInfo::writeNewLine() {
-  Out << '\n';
+  switch (Format) {
+  case HitFormat::TSV:
+    Out.append('\n');
+    break;
+  case HitFormat::NDJSON:
+    Out.append("}\n", 2);
+    InRecord = false;
+    break;
+  case HitFormat::BINARY:
+    break;
+  }
 }
 
 void OutputInfo::writeContext(const HitBuffer& hitBuf) {
-  // print the hit, escaping \t, \n, \r
   const char* utf8 = hitBuf.Context.data();
   const char* utf8_end = utf8 + std::strlen(utf8);
-  const char esc[] = "\t\n\r";
-
-  // print offset of start of context
-  Out << Separator << hitBuf.DataOffset << Separator;
-
-  for (const char* l = utf8, *r; l != utf8_end; l = r) {
-    r = std::find_first_of(l, utf8_end, esc, esc + 3);
-    Out.write(l, r - l);
-    if (r != utf8_end) {
-      switch (*r) {
-      case '\t': Out << "\\t"; break;
-      case '\n': Out << "\\n"; break;
-      case '\r': Out << "\\r"; break;
+
+  switch (Format) {
+  case HitFormat::TSV:
+    {
+      // print offset of start of context
+      Out.append(Separator);
+      Out.appendNum(hitBuf.DataOffset);
+      Out.append(Separator);
+
+      // print the hit, escaping \t, \n, \r
+      const char esc[] = "\t\n\r";
+      for (const char* l = utf8, *r; l != utf8_end; l = r) {
+        r = std::find_first_of(l, utf8_end, esc, esc + 3);
+        Out.append(l, r - l);
+        if (r != utf8_end) {
+          switch (*r) {
+          case '\t': Out.append("\\t", 2); break;
+          case '\n': Out.append("\\n", 2); break;
+          case '\r': Out.append("\\r", 2); break;
+          }
+          ++r;
+        }
       }
-      ++r;
     }
+    break;
+  case HitFormat::NDJSON:
+    Out.append(",\"context_offset\":", 18);
+    Out.appendNum(hitBuf.DataOffset);
+    Out.append(",\"context\":", 11);
+    appendJsonString(Out, utf8, utf8_end);
+    break;
+  case HitFormat::BINARY:
+    Out.append('C');
+    Out.appendRaw(hitBuf.DataOffset);
+    appendBytes<uint32_t>(Out, utf8, utf8_end - utf8);
+    break;
   }
 }
 
 void OutputInfo::writeGroupSeparator() {
-  Out << GroupSeparator << '\n';
-}
-
-std::string escapeControlChars(const std::string& str) {
-  std::string escaped;
-  escaped.reserve(str.size() + 4); // give some extra space for escaped characters
-  for (const char c : str) {
-    switch(c) {
-      case '\a':
-        escaped += "\\a";
-        continue;
-      case '\b':
-        escaped += "\\b";
-        continue;
-      case '\t':
-        escaped += "\\t";
-        continue;
-      case '\n':
-        escaped += "\\n";
-        continue;
-      case '\v':
-        escaped += "\\v";
-        continue;
-      case '\f':
-        escaped += "\\f";
-        continue;
-      case '\r':
-        escaped += "\\r";
-        continue;
-      default:
-        escaped += c;
-    }
+  // only lines of text need separating
+  if (Format == HitFormat::TSV) {
+    Out.append(GroupSeparator);
+    Out.append('\n');
   }
-  return escaped;
 }
 
-/********************************************* HistogramInfo ****************************************/
+void OutputInfo::writePatternTable(ProgramHandle* prog) {
+  const uint32_t count = lg_prog_pattern_count(prog);
 
-void HistogramInfo::writeHistogram(std::ostream& histOut, char sep) {
-  std::vector<std::pair<HistogramKey, uint64_t>> sortedHistogram;
-  sortedHistogram.reserve(Histogram.size());
+  Out.append("LGHT", 4);
+  Out.appendRaw(static_cast<uint32_t>(1));
+  Out.appendRaw(count);
 
-  for (const auto& i : Histogram) {
-    sortedHistogram.push_back(i);
+  for (uint32_t i = 0; i < count; ++i) {
+    const LG_PatternInfo* info = lg_prog_pattern_info(prog, i);
+    Out.appendRaw(info->UserIndex);
+    appendBytes<uint32_t>(Out, info->Pattern, std::strlen(info->Pattern));
+    appendBytes<uint32_t>(Out, info->EncodingChain, std::strlen(info->EncodingChain));
   }
+}
 
-  std::sort(sortedHistogram.begin(),
-            sortedHistogram.end(),
-            [](const LG_Histogram::value_type& a, const LG_Histogram::value_type& b){return histogramKeyComp(a, b);});
+/********************************************* HistogramInfo ****************************************/
 
-  for (const auto& [hKey, count] : sortedHistogram) {
-    histOut << count << sep
-            << escapeControlChars(hKey.HitText) << sep
-            << hKey.UserIndex << sep
-            << escapeControlChars(hKey.Pattern) << '\n';
-  }
+void HistogramInfo::writeHistogram(std::ostream& histOut, char sep) {
+  Histogram.write(histOut, sep);
 }
 
 void HistogramInfo::writeHitToHistogram(const LG_SearchHit& hit, const LG_PatternInfo* info, std::function<HitBuffer(const LG_SearchHit&)> decodeFun) {
-  HitBuffer hitText = (SearchHit(hit) == LastSearchHit && !DecodedContext.empty()) ? DecodedContext : decodeFun(hit);
-  HistogramKey hitKey {hitText.hit(), info->Pattern, info->UserIndex};
-  ++Histogram[hitKey];
+  // reuse the context just decoded for output, if it was for this hit
+  const bool cached = SearchHit(hit) == LastSearchHit && !DecodedContext.empty();
+  const HitBuffer decoded = cached ? HitBuffer() : decodeFun(hit);
+  const HitBuffer& hitText = cached ? DecodedContext : decoded;
+
+  Histogram.add(
+    hit.KeywordIndex, info,
+    hitText.Context.data() + hitText.HitWindow.begin,
+    hitText.HitWindow.end - hitText.HitWindow.begin
+  );
 }
 
 /********************************************* HitOutputData ****************************************/
 
-HitOutputData::HitOutputData(std::ostream &out, ProgramHandle* prog, char separator, const std::string& groupSep, int32_t beforeContext, int32_t afterContext, bool histEnabled)
-              : OutInfo({out, "", beforeContext, afterContext, separator, groupSep}), Prog(prog), HistInfo(HistogramInfo(histEnabled)), Decoder(lg_create_decoder(), lg_destroy_decoder) {}
+HitOutputData::HitOutputData(std::ostream &out, ProgramHandle* prog, char separator, const std::string& groupSep, int32_t beforeContext, int32_t afterContext, bool histEnabled, HitFormat format, bool threaded)
+              : OutInfo(out, beforeContext, afterContext, separator, groupSep, format, threaded), Prog(prog), HistInfo(HistogramInfo(histEnabled)), Decoder(lg_create_decoder(), lg_destroy_decoder)
+{
+  if (format == HitFormat::BINARY) {
+    OutInfo.writePatternTable(prog);
+  }
+}
 
 void HitOutputData::setBuffer(const char* buf, size_t blen, uint64_t boff) {
   HistInfo.resetCache();
@@ -205,7 +376,9 @@ HitBuffer HitOutputData::decodeContext(const LG_SearchHit& searchHit) {
 
   // transcode the context to UTF-8
   LG_Error* err = nullptr;
-  LG_Window inner{searchHit.Start, searchHit.End},
+  // a hit which began before the buffer can only be read from its start
+  const uint64_t innerBeg = std::max(searchHit.Start, CtxBuf.BufOff);
+  LG_Window inner{innerBeg, std::max(searchHit.End, innerBeg)},
             outer,
             decodedHit;
   const char* utf8 = nullptr;
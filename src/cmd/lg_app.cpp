@@ -19,6 +19,8 @@
 
 #include "options.h"
 #include "program.h"
+
+#include <algorithm>
 #include <iostream>
 
 namespace {
@@ -38,48 +40,56 @@ namespace {
   }
 
   LG_ProgramOptions progOpts(const Options& opts) {
-    return { opts.DeterminizeDepth };
+    return { opts.DeterminizeDepth, opts.Partitions };
   }
 }
   
-LgAppCollection parsePatterns(const Options& opts)
-{
-  // read the patterns and parse them
+namespace {
+  std::unique_ptr<FSMHandle, void(*)(FSMHandle*)> buildFSM(const Options& opts, Errors& errors) {
+    // read the patterns and parse them
 
-  const std::vector<std::pair<std::string, std::string>>& patLines(opts.getPatternLines());
-  const std::vector<std::string>& defaultEncodings(opts.Encodings);
-  const LG_KeyOptions& defaultKOpts(patOpts(opts));
-  const LG_ProgramOptions& defaultProgOpts(progOpts(opts));
+    const std::vector<std::pair<std::string, std::string>>& patLines(opts.getPatternLines());
+    const std::vector<std::string>& defaultEncodings(opts.Encodings);
+    const LG_KeyOptions& defaultKOpts(patOpts(opts));
 
-  // FIXME: estimate NFA size here?
-  std::unique_ptr<FSMHandle, void(*)(FSMHandle*)> fsm(
-    lg_create_fsm(0, 0),
-    lg_destroy_fsm
-  );
-
-  if (!fsm) {
-    throw std::runtime_error("failed to create fsm");
-  }
+    // FIXME: estimate NFA size here?
+    std::unique_ptr<FSMHandle, void(*)(FSMHandle*)> fsm(
+      lg_create_fsm(0, 0),
+      lg_destroy_fsm
+    );
 
-  // set default encoding(s) of patterns which have none specified
-  const std::unique_ptr<const char*[]> defEncs(c_str_arr(defaultEncodings));
+    if (!fsm) {
+      throw std::runtime_error("failed to create fsm");
+    }
 
-  std::unique_ptr<Errors> errors(new Errors());
+    // set default encoding(s) of patterns which have none specified
+    const std::unique_ptr<const char*[]> defEncs(c_str_arr(defaultEncodings));
 
-  for (const std::pair<std::string, std::string>& pf : patLines) {
-    // parse a complete pattern file
-    LG_Error* local_err = nullptr;
+    for (const std::pair<std::string, std::string>& pf : patLines) {
+      // parse a complete pattern file
+      LG_Error* local_err = nullptr;
 
-    lg_add_pattern_list(
-      fsm.get(),
-      pf.second.c_str(), pf.first.c_str(),
-      defEncs.get(), defaultEncodings.size(), &defaultKOpts, &local_err
-    );
+      lg_add_pattern_list(
+        fsm.get(),
+        pf.second.c_str(), pf.first.c_str(),
+        defEncs.get(), defaultEncodings.size(), &defaultKOpts, &local_err
+      );
 
-    if (local_err) {
-      errors->extend(local_err);
+      if (local_err) {
+        errors.extend(local_err);
+      }
     }
+
+    return fsm;
   }
+}
+
+LgAppCollection parsePatterns(const Options& opts)
+{
+  const LG_ProgramOptions& defaultProgOpts(progOpts(opts));
+
+  std::unique_ptr<Errors> errors(new Errors());
+  std::unique_ptr<FSMHandle, void(*)(FSMHandle*)> fsm(buildFSM(opts, *errors));
 
   std::unique_ptr<ProgramHandle, void(*)(ProgramHandle*)> prog(
     lg_create_program(fsm.get(), &defaultProgOpts),
@@ -87,8 +97,16 @@ LgAppCollection parsePatterns(const Options& opts)
   );
 
   if (prog && opts.Verbose) {
-    std::cerr << fsm->Impl->Fsm->verticesSize() << " vertices\n"
-              << prog->Prog->size() << " instructions\n";
+    std::cerr << fsm->Impl->Fsm->verticesSize() << " vertices\n";
+    if (prog->Prog) {
+      std::cerr << prog->Prog->size() << " instructions\n";
+    }
+    else {
+      for (size_t i = 0; i < prog->Parts.size(); ++i) {
+        std::cerr << "part " << i << ": " << prog->PartLabels[i].size()
+                  << " patterns, " << prog->Parts[i]->size() << " instructions\n";
+      }
+    }
   }
 
   return LgAppCollection(std::move(fsm), std::move(prog), std::move(errors));
@@ -109,10 +127,8 @@ void writeProgram(const Options& opts, std::ostream& out) {
     throw std::runtime_error("failed to create program");
   }
 
-  // break on through the C API to print the program
-  ProgramPtr p(prog->Prog);
   if (opts.Verbose) {
-    std::cerr << p->size() << " program size in bytes" << std::endl;
+    std::cerr << lg_program_size(prog.get()) << " program size in bytes" << std::endl;
   }
 
   if (opts.Binary) {
@@ -120,7 +136,73 @@ void writeProgram(const Options& opts, std::ostream& out) {
     lg_write_program(prog.get(), buf.data());
     out.write(buf.data(), buf.size());
   }
+  else if (prog->Prog) {
+    // break on through the C API to print the program
+    out << *prog->Prog << std::endl;
+  }
   else {
-    out << *p << std::endl;
+    for (size_t i = 0; i < prog->Parts.size(); ++i) {
+      out << "part " << i << " patterns";
+      for (const uint32_t l : prog->PartLabels[i]) {
+        out << ' ' << l;
+      }
+      out << '\n' << *prog->Parts[i] << std::endl;
+    }
   }
-}
\ No newline at end of file
+}
+
+void writeAnalysis(const Options& opts, std::ostream& out) {
+  Errors errors;
+  std::unique_ptr<FSMHandle, void(*)(FSMHandle*)> fsm(buildFSM(opts, errors));
+
+  const bool printFilename = opts.CmdLinePatterns.empty()
+                          && opts.KeyFiles.size() > 1;
+
+  errors.outputErrors(std::cerr, printFilename);
+
+  // analyze each pattern-encoding pair
+  std::vector<std::pair<unsigned int, LG_PatternStats>> results;
+
+  const unsigned int pcount = lg_fsm_pattern_count(fsm.get());
+  for (unsigned int i = 0; i < pcount; ++i) {
+    LG_PatternStats stats;
+    LG_Error* err = nullptr;
+
+    if (lg_analyze_pattern(fsm.get(), i, &stats, &err)) {
+      results.emplace_back(i, stats);
+    }
+    else {
+      const LG_PatternInfo* pinfo = lg_fsm_pattern_info(fsm.get(), i);
+      std::cerr << "Error: " << err->Message << " on pattern "
+                << pinfo->UserIndex << ", '" << pinfo->Pattern << "'\n";
+      lg_free_error(err);
+    }
+  }
+
+  // most expensive first
+  std::stable_sort(results.begin(), results.end(),
+    [](const std::pair<unsigned int, LG_PatternStats>& l,
+       const std::pair<unsigned int, LG_PatternStats>& r) {
+      return l.second.Cost > r.second.Cost;
+    }
+  );
+
+  out << "cost\tfanout\tloops\tminlen\tpairs\tprefilter\tindex\tpattern\tencoding\n";
+
+  for (const std::pair<unsigned int, LG_PatternStats>& r : results) {
+    const LG_PatternInfo* pinfo = lg_fsm_pattern_info(fsm.get(), r.first);
+    const LG_PatternStats& s = r.second;
+
+    out << s.Cost << '\t'
+        << s.MaxFanOut << '\t'
+        << s.Loops << '\t'
+        << s.MinLength << '\t'
+        << s.FilterPairs << '\t'
+        << (s.DefeatsPrefilter ? "defeated" : "ok") << '\t'
+        << pinfo->UserIndex << '\t'
+        << pinfo->Pattern << '\t'
+        << pinfo->EncodingChain << '\n';
+  }
+
+  out.flush();
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "lineindex.h"
+
+#include <algorithm>
+#include <cstring>
+
+size_t countLines(const char* beg, const char* end) {
+  // a branch-free byte loop, which the compiler may auto-vectorize;
+  // memchr would stop at every newline
+  size_t n = 0;
+  for (const char* i = beg; i < end; ++i) {
+    n += *i == '\n';
+  }
+  return n;
+}
+
+void LineIndex::reset(const char* buf, size_t len) {
+  Buf = buf;
+  Len = len;
+  Built = false;
+  Newlines.clear();
+}
+
+size_t LineIndex::before(size_t pos) {
+  if (!Built) {
+    // newlines are sparse, so let memchr skip between them
+    const char* const end = Buf + Len;
+    for (const char* i = Buf; i < end && (i = static_cast<const char*>(std::memchr(i, '\n', end - i))); ++i) {
+      Newlines.push_back(i - Buf);
+    }
+    Built = true;
+  }
+
+  return std::lower_bound(Newlines.begin(), Newlines.end(), pos) - Newlines.begin();
+}
+
+size_t LineIndex::count() const {
+  return Built ? Newlines.size() : countLines(Buf, Buf + Len);
+}
@@ -42,6 +42,7 @@
 #include "utility.h"
 
 #include "factor_analysis.h"
+#include "hitcache.h"
 #include "hitwriter.h"
 #include "matchgen.h"
 #include "options.h"
@@ -115,6 +116,7 @@ size_t countErrors(const LG_Error* err) {
 void search(
   const std::string& input,
   bool mmapped,
+  bool decompress,
   SearchController& ctrl,
   ContextHandle* searcher,
   HitOutputData* hinfo,
@@ -122,26 +124,71 @@ void search(
 {
   std::unique_ptr<Reader> reader;
 
+  ContentKey key;
+  std::vector<LG_SearchHit> hits;
+  bool record = false;
+
   if (input == "-") {
     // stdin can't be mmap'd
     reader.reset(static_cast<Reader*>(new FileReader(input, ctrl.BlockSize)));
     hinfo->setPath("(standard input)");
   }
   else {
-    reader.reset(mmapped ?
-      static_cast<Reader*>(new MemoryMappedFileReader(input)) :
-      static_cast<Reader*>(new FileReader(input, ctrl.BlockSize))
-    );
+    const Compression comp = decompress ? sniffCompression(input) : Compression::NONE;
+
+    if (comp != Compression::NONE && canDecompress(comp)) {
+      reader.reset(static_cast<Reader*>(new DecompressingReader(input, comp, ctrl.BlockSize)));
+    }
+    else {
+      if (comp != Compression::NONE) {
+        std::cerr << "Warning: this build cannot decompress " << compressionName(comp)
+                  << ", searching " << input << " as is" << std::endl;
+      }
+
+      if (ctrl.Cache && fs::is_regular_file(input)) {
+        key = hashFile(input);
+        if (const std::vector<LG_SearchHit>* cached = ctrl.Cache->find(key)) {
+          hinfo->setPath(input);
+          ctrl.replayFile(input, key.Size, *cached, hinfo, callback);
+          return;
+        }
+        record = true;
+      }
+
+      if (mmapped) {
+        reader.reset(static_cast<Reader*>(new MemoryMappedFileReader(input)));
+      }
+      else if (isSparseFile(input)) {
+        reader.reset(static_cast<Reader*>(new SparseFileReader(input, ctrl.BlockSize)));
+      }
+      else {
+        reader.reset(static_cast<Reader*>(new FileReader(input, ctrl.BlockSize)));
+      }
+    }
     hinfo->setPath(input);
   }
 
   lg_reset_context(searcher);
+  hinfo->Recorded = record ? &hits : nullptr;
   ctrl.searchFile(searcher, hinfo, *reader, callback);
+  hinfo->Recorded = nullptr;
+
+  if (record) {
+    ctrl.Cache->insert(key, std::move(hits));
+  }
+
+  const uint64_t dropped = lg_context_dropped_threads(searcher);
+  if (dropped) {
+    std::cerr << "Warning: thread limit exceeded searching " << input
+              << ", dropped " << dropped << " threads; some hits may be missing"
+              << std::endl;
+  }
 }
 
 void searchRecursively(
   const fs::path& path,
   bool mmapped,
+  bool decompress,
   SearchController& ctrl,
   ContextHandle* searcher,
   HitOutputData* hinfo,
@@ -151,7 +198,7 @@ void searchRecursively(
   for (fs::recursive_directory_iterator d(path); d != end; ++d) {
     const fs::path p(d->path());
     if (!fs::is_directory(p)) {
-      search(p.string(), mmapped, ctrl, searcher, hinfo, callback);
+      search(p.string(), mmapped, decompress, ctrl, searcher, hinfo, callback);
     }
   }
 }
@@ -244,6 +291,7 @@ LG_HITCALLBACK_FN selectCallbackFn(const Options& opts) {
 void searchRec(
   const std::string& i,
   bool mmapped,
+  bool decompress,
   SearchController& ctrl,
   ContextHandle* searcher,
   HitOutputData* hinfo,
@@ -252,16 +300,17 @@ void searchRec(
   // search this path recursively
   const fs::path p(i);
   if (fs::is_directory(p)) {
-    searchRecursively(p, mmapped, ctrl, searcher, hinfo, callback);
+    searchRecursively(p, mmapped, decompress, ctrl, searcher, hinfo, callback);
   }
   else {
-    search(i, mmapped, ctrl, searcher, hinfo, callback);
+    search(i, mmapped, decompress, ctrl, searcher, hinfo, callback);
   }
 }
 
 void searchNonRec(
   const std::string& i,
   bool mmapped,
+  bool decompress,
   SearchController& ctrl,
   ContextHandle* searcher,
   HitOutputData* hinfo,
@@ -269,7 +318,7 @@ void searchNonRec(
 {
   // search this path non-recursively
   if (!fs::is_directory(fs::path(i))) {
-    search(i, mmapped, ctrl, searcher, hinfo, callback);
+    search(i, mmapped, decompress, ctrl, searcher, hinfo, callback);
   }
 }
 
@@ -286,11 +335,24 @@ void searchInputs(
   const auto searchFunc = opts.Recursive ? searchRec : searchNonRec;
   for (const std::string& i: inputs) {
     if (!skipStdin(i, stdinUsed)) {
-      searchFunc(i, opts.MemoryMapped, ctrl, searcher, hinfo, callback);
+      searchFunc(i, opts.MemoryMapped, opts.Decompress, ctrl, searcher, hinfo, callback);
     }
   }
 }
 
+// Identifies the hits a program finds, for keying a HitCache
+ContentKey programFingerprint(ProgramHandle* prog, const LG_ContextOptions& ctxOpts) {
+  std::vector<char> buf(lg_program_size(prog));
+  lg_write_program(prog, buf.data());
+
+  ContentHasher h;
+  h.update(buf.data(), buf.data() + buf.size());
+  // dropping threads can lose hits
+  const char* const maxThreads = reinterpret_cast<const char*>(&ctxOpts.MaxThreads);
+  h.update(maxThreads, maxThreads + sizeof(ctxOpts.MaxThreads));
+  return h.finish();
+}
+
 void search(const Options& opts) {
   std::unique_ptr<ProgramHandle, void(*)(ProgramHandle*)> prog(nullptr, nullptr);
 
@@ -322,12 +384,22 @@ void search(const Options& opts) {
     }
   }
 
+  const HitFormat format = opts.Format == "ndjson" ? HitFormat::NDJSON :
+                           opts.Format == "binary" ? HitFormat::BINARY :
+                                                     HitFormat::TSV;
+
+  // hits are written by a thread of their own, so that the search does
+  // not wait on the output
   std::unique_ptr<HitOutputData> hinfo(new HitOutputData(opts.openOutput(),
                                                           prog.get(),
                                                           '\t',
                                                           opts.GroupSeparator,
                                                           opts.BeforeContext,
-                                                          opts.AfterContext, histogramEnabled));
+                                                          opts.AfterContext, histogramEnabled,
+                                                          format, true));
+
+  hinfo->HistInfo.Histogram = HitHistogram(opts.HistogramTop);
+  hinfo->OutInfo.LineNumbers = opts.LineNumbers && !opts.NoOutput;
 
   LG_HITCALLBACK_FN callback = selectCallbackFn(opts);
 
@@ -335,13 +407,34 @@ void search(const Options& opts) {
   LG_ContextOptions ctxOpts;
   ctxOpts.TraceBegin = opts.DebugBegin;
   ctxOpts.TraceEnd = opts.DebugEnd;
+  ctxOpts.DedupThreads = opts.DedupThreads;
+  ctxOpts.MaxThreads = opts.MaxThreads;
 
   std::unique_ptr<ContextHandle, void(*)(ContextHandle*)> searcher(
     lg_create_context(prog.get(), &ctxOpts),
     lg_destroy_context
   );
 
-  SearchController ctrl(opts.BlockSize);
+  // hits whose text, context, or line is written are held until up to
+  // 1 MiB either side of them has been read
+  const bool readsInput = histogramEnabled ||
+    (!opts.NoOutput && (opts.LineNumbers || opts.BeforeContext > -1 || opts.AfterContext > -1));
+  SearchController ctrl(opts.BlockSize, readsInput ? 1 << 20 : 0, opts.LineNumbers);
+
+  std::unique_ptr<HitCache> cache;
+  if (opts.Dedup) {
+    cache.reset(new HitCache(programFingerprint(prog.get(), ctxOpts)));
+
+    if (!opts.HitCacheFile.empty()) {
+      std::ifstream cacheIn(opts.HitCacheFile, std::ios::in | std::ios::binary);
+      if (cacheIn && !cache->load(cacheIn)) {
+        std::cerr << "Warning: ignoring hit cache " << opts.HitCacheFile
+                  << ", which is unreadable or for different patterns" << std::endl;
+      }
+    }
+
+    ctrl.Cache = cache.get();
+  }
 
   bool stdinUsed = false;
 
@@ -381,13 +474,32 @@ void search(const Options& opts) {
     searchInputs(opts.Inputs, opts, stdinUsed, ctrl, searcher.get(), hinfo.get(), callback);
   }
 
+  hinfo->flush();
+
   if (histogramEnabled) {
     hinfo.get()->writeHistogram(histFile);
   }
 
+  if (!opts.HitCacheFile.empty()) {
+    // replace the cache file whole, so that an interrupted write cannot
+    // leave a truncated one behind
+    const std::string tmp = opts.HitCacheFile + ".tmp";
+    std::ofstream cacheOut(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+    cache->save(cacheOut);
+    cacheOut.close();
+    if (!cacheOut) {
+      THROW_RUNTIME_ERROR_WITH_CLEAN_OUTPUT("Could not write hit cache to " << tmp);
+    }
+    fs::rename(tmp, opts.HitCacheFile);
+  }
+
   if (opts.Verbose) {
     std::cerr << ctrl.BytesSearched << " bytes\n"
-              << ctrl.TotalTime << " searchTime\n";
+              << ctrl.HoleBytes << " bytes in holes\n"
+              << ctrl.DedupBytes << " bytes in duplicate files\n"
+              << ctrl.TotalTime << " searchTime\n"
+              << ctrl.FaultTime << " faultTime\n"
+              << ctrl.StallTime << " stallTime\n";
     if (ctrl.TotalTime > 0.0) {
       std::cerr << (ctrl.BytesSearched / ctrl.TotalTime / (1 << 20));
     }
@@ -500,6 +612,11 @@ void outputProgram(const Options& opts) {
   writeProgram(opts, out);
 }
 
+void outputAnalysis(const Options& opts) {
+  std::ostream& out(opts.openOutput());
+  writeAnalysis(opts, out);
+}
+
 int main(int argc, char** argv) {
   try {
     Options opts;
@@ -522,6 +639,9 @@ int main(int argc, char** argv) {
     case Options::VALIDATE:
       validate(opts);
       break;
+    case Options::ANALYZE:
+      outputAnalysis(opts);
+      break;
     case Options::SHOW_VERSION:
       printVersion(std::cout);
       break;
@@ -31,7 +31,7 @@ std::ostream& Options::openOutput() const {
   else {
     OutputFile.clear();
     std::ios_base::openmode mode = std::ios::out;
-    if (Binary) {
+    if (Binary || Format == "binary") {
       mode |= std::ios::binary;
     }
     OutputFile.open(Output.c_str(), mode);
@@ -100,8 +100,13 @@ void Options::validateAndPopulateOptions(const po::variables_map &optsMap, std::
   LiteralMode = optsMap.count("fixed-strings") > 0;
   Binary = optsMap.count("binary") > 0;
   NoOutput = optsMap.count("no-output") > 0;
+  LineNumbers = optsMap.count("line-number") > 0;
   Recursive = optsMap.count("recursive") > 0;
   MemoryMapped = optsMap.count("mmap") > 0;
+  Decompress = optsMap.count("decompress") > 0;
+  // --hit-cache implies --dedup
+  Dedup = optsMap.count("dedup") > 0 || optsMap.count("hit-cache") > 0;
+  DedupThreads = optsMap.count("dedup-threads") > 0;
   Verbose = optsMap.count("verbose") > 0;
 
   populateContextOptions(optsMap, pargs);
@@ -195,6 +200,10 @@ void Options::validateAndPopulateSearchOptions(const po::variables_map& optsMap,
   if (MemoryMapped && std::find(Inputs.begin(), Inputs.end(), "-") != Inputs.end()) {
     throw po::error("--mmap is incompatible with reading from stdin");
   }
+
+  if (Format != "tsv" && Format != "ndjson" && Format != "binary") {
+    throw po::error("--format must be one of tsv, ndjson, or binary");
+  }
 }
 
 void Options::populateSampleOptions(const po::variables_map& optsMap, std::vector<std::string>& pargs) {
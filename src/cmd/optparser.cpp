@@ -70,7 +70,7 @@ void parse_opts(int argc, const char* const * argv,
   // Command selection options
   po::options_description general("Command selection");
   general.add_options()
-    ("command,c", po::value<std::string>(&command)->value_name("CMD")->default_value("search"), "command to perform [search|graph|program|sample|validate]")
+    ("command,c", po::value<std::string>(&command)->value_name("CMD")->default_value("search"), "command to perform [search|graph|program|sample|validate|analyze]")
     ("help", "display this help message")
     ("list-encodings", "list known encodings")
     ("version,V", "print version information and exit")
@@ -92,9 +92,12 @@ void parse_opts(int argc, const char* const * argv,
     ("output,o", po::value<std::string>(&opts.Output)->value_name("FILE")->default_value("-"), "output file (stdout default)")
     ("arg-file,a", po::value<std::vector<std::string>>(&opts.InputLists)->composing()->value_name("FILE"), "read input paths from file")
     ("recursive,r", "traverse directories recursively")
+    ("format", po::value<std::string>(&opts.Format)->value_name("FMT")->default_value("tsv"), "write hits as tsv, ndjson, or binary")
     ("histogram-file", po::value<std::string>(&opts.HistogramFile)->value_name("FILE"), "output file for histogram")
+    ("histogram-top", po::value<uint32_t>(&opts.HistogramTop)->value_name("NUM")->default_value(0), "bound histogram memory, keeping only the NUM most frequent hits (0 for all)")
     ("with-filename,H", "print the filename for each match")
     ("no-filename,h", "suppress the filename for each match")
+    ("line-number,n", "print the line number of each match")
     ("after-context,A", po::value<int32_t>(&opts.AfterContext)->value_name("NUM"), "print NUM lines of trailing context")
     ("before-context,B", po::value<int32_t>(&opts.BeforeContext)->value_name("NUM"), "print NUM lines of leading context")
     ("context,C", po::value<int32_t>(&opts.BeforeContext)->value_name("NUM"), "print NUM lines of context")
@@ -102,14 +105,20 @@ void parse_opts(int argc, const char* const * argv,
     ("no-output", "do not output hits (good for profiling)")
     ("block-size", po::value<uint32_t>(&opts.BlockSize)->default_value(8 * 1024 * 1024)->value_name("BYTES"), "block size to use for buffering, in bytes")
     ("mmap", "memory-map input file(s)")
+    ("decompress,z", "search the decompressed contents of gzip, xz, and zstd files")
+    ("dedup", "search identical files once, repeating the hits for the rest")
+    ("hit-cache", po::value<std::string>(&opts.HitCacheFile)->value_name("FILE"), "keep --dedup hits in FILE across runs")
     ;
 
   // Other options
   po::options_description misc("Miscellaneous");
   misc.add_options()
     ("determinize-depth", po::value<uint32_t>(&opts.DeterminizeDepth)->value_name("NUM")->default_value(std::numeric_limits<uint32_t>::max()), "determinize NFA to NUM depth")
+    ("partitions", po::value<uint32_t>(&opts.Partitions)->value_name("NUM")->default_value(1), "split patterns into NUM programs searched in parallel")
     ("binary", "output program as binary")
     ("program-file", po::value<std::string>(&opts.ProgramFile)->value_name("FILE"), "read search program from file")
+    ("dedup-threads", "keep one thread per program location per byte where safe")
+    ("max-threads", po::value<uint32_t>(&opts.MaxThreads)->value_name("NUM")->default_value(0), "drop lowest-priority threads beyond NUM (0 for no limit)")
     ("verbose", "enable verbose output")
     #ifdef LBT_TRACE_ENABLED
     ("begin-debug", po::value<uint64_t>(&opts.DebugBegin)->default_value(std::numeric_limits<uint64_t>::max()), "offset for beginning of debug logging")
@@ -167,6 +176,7 @@ void parse_opts(int argc, const char* const * argv,
     cmds.insert(std::make_pair("program",     Options::PROGRAM));
     cmds.insert(std::make_pair("sample",     Options::SAMPLES));
     cmds.insert(std::make_pair("validate", Options::VALIDATE));
+    cmds.insert(std::make_pair("analyze",  Options::ANALYZE));
 
     auto i = cmds.find(command);
     if (i != cmds.end()) {
@@ -184,6 +194,7 @@ void parse_opts(int argc, const char* const * argv,
   case Options::PROGRAM:
   case Options::SAMPLES:
   case Options::VALIDATE:
+  case Options::ANALYZE:
     opts.validateAndPopulateOptions(optsMap, pargs);
     break;
 
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "outputbuffer.h"
+
+#include <ostream>
+
+namespace {
+
+const char DIGIT_PAIRS[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+}
+
+OutputBuffer::OutputBuffer(std::ostream& out, bool threaded, size_t capacity):
+  Out(out), Threaded(threaded), Capacity(capacity), Busy(false), Done(false)
+{
+  Buf.reserve(Capacity);
+  if (Threaded) {
+    InFlight.reserve(Capacity);
+    Writer = std::thread(&OutputBuffer::writer, this);
+  }
+}
+
+OutputBuffer::~OutputBuffer() {
+  flush();
+
+  if (Threaded) {
+    {
+      std::lock_guard<std::mutex> lock(M);
+      Done = true;
+    }
+    Cond.notify_all();
+    Writer.join();
+  }
+}
+
+void OutputBuffer::appendNum(uint64_t v) {
+  // fill from the right, two digits at a time
+  char b[20];
+  char* p = b + sizeof(b);
+
+  while (v >= 100) {
+    const char* d = DIGIT_PAIRS + 2 * (v % 100);
+    v /= 100;
+    *--p = d[1];
+    *--p = d[0];
+  }
+
+  if (v >= 10) {
+    const char* d = DIGIT_PAIRS + 2 * v;
+    *--p = d[1];
+    *--p = d[0];
+  }
+  else {
+    *--p = '0' + v;
+  }
+
+  append(p, b + sizeof(b) - p);
+}
+
+void OutputBuffer::spill() {
+  if (Buf.empty()) {
+    return;
+  }
+
+  if (!Threaded) {
+    Out.write(Buf.data(), Buf.size());
+    Buf.clear();
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(M);
+    Cond.wait(lock, [this]{ return !Busy; });
+    // InFlight was emptied by the writer; swapping keeps both allocations
+    Buf.swap(InFlight);
+    Busy = true;
+  }
+  Cond.notify_all();
+}
+
+void OutputBuffer::flush() {
+  spill();
+
+  if (Threaded) {
+    std::unique_lock<std::mutex> lock(M);
+    Cond.wait(lock, [this]{ return !Busy; });
+  }
+
+  Out.flush();
+}
+
+void OutputBuffer::writer() {
+  std::unique_lock<std::mutex> lock(M);
+  for (;;) {
+    Cond.wait(lock, [this]{ return Busy || Done; });
+    if (!Busy) {
+      return;
+    }
+
+    // InFlight is ours until Busy is cleared
+    lock.unlock();
+    Out.write(InFlight.data(), InFlight.size());
+    InFlight.clear();
+    lock.lock();
+
+    Busy = false;
+    Cond.notify_all();
+  }
+}
@@ -15,12 +15,34 @@
  *
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
 #include <algorithm>
 #include <cerrno>
 #include <cstring>
+#include <filesystem>
 #include <stdexcept>
 
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "reader.h"
+#include "timer.h"
 
 namespace {
 
@@ -66,17 +88,487 @@ std::future<std::pair<const char*, size_t>> FileReader::read(size_t len){
   );
 }
 
-MemoryMappedFileReader::MemoryMappedFileReader(const std::string& path):
-  M(path.c_str(), bip::read_only), R(M, bip::read_only),
-  Buf(static_cast<const char*>(R.get_address())), Bend(Buf + R.get_size())
+bool isSparseFile(const std::string& path) {
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+  struct stat st;
+  if (path == "-" || stat(path.c_str(), &st) || !S_ISREG(st.st_mode)) {
+    return false;
+  }
+  // fewer blocks allocated than needed to hold the file means holes
+  return static_cast<uint64_t>(st.st_blocks) * 512 < static_cast<uint64_t>(st.st_size);
+#else
+  (void) path;
+  return false;
+#endif
+}
+
+SparseFileReader::SparseFileReader(const std::string& path, size_t blockSize):
+  File(try_open(path)), Size(std::filesystem::file_size(path)), Pos(0),
+  RegionEnd(0), InHole(false), Seek(false),
+  Cur(new char[blockSize]), Next(new char[blockSize]), Zeros(new char[blockSize]())
 {
-  R.advise(bip::mapped_region::advice_sequential);
+  std::setbuf(File, 0);
+}
+
+SparseFileReader::~SparseFileReader() {
+  std::fclose(File);
+}
+
+void SparseFileReader::findRegion() {
+  // the queries move the file offset, so seek back before reading
+  Seek = true;
+  InHole = false;
+  RegionEnd = Size;
+
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+  const int fd = fileno(File);
+
+  off_t data = lseek(fd, Pos, SEEK_DATA);
+  if (data < 0) {
+    if (errno == ENXIO) {
+      // nothing but hole from here to the end
+      data = Size;
+    }
+    else {
+      // no hole support here; read it all
+      return;
+    }
+  }
+
+  if (static_cast<uint64_t>(data) - Pos >= MIN_HOLE) {
+    InHole = true;
+    RegionEnd = data;
+    return;
+  }
+
+  // read through any holes too small to be worth skipping
+  uint64_t end = std::max(static_cast<uint64_t>(data), Pos);
+  while (end < Size) {
+    const off_t h = lseek(fd, end, SEEK_HOLE);
+    if (h < 0) {
+      end = Size;
+      break;
+    }
+
+    end = h;
+    if (end >= Size) {
+      break;
+    }
+
+    const off_t d = lseek(fd, end, SEEK_DATA);
+    const uint64_t next = d < 0 ? Size : static_cast<uint64_t>(d);
+    if (next - end >= MIN_HOLE) {
+      break;
+    }
+    end = next;
+  }
+
+  RegionEnd = std::min(end, Size);
+#endif
 }
 
+std::pair<const char*, size_t> SparseFileReader::fill(char* buf, size_t len) {
+  if (Pos >= Size) {
+    return {buf, 0};
+  }
+
+  if (Pos == RegionEnd) {
+    findRegion();
+  }
+
+  len = std::min(static_cast<uint64_t>(len), RegionEnd - Pos);
+
+  if (InHole) {
+    Pos += len;
+    return {Zeros.get(), len};
+  }
+
+  if (Seek) {
+    if (fseeko(File, Pos, SEEK_SET)) {
+      throw std::runtime_error(std::strerror(errno));
+    }
+    Seek = false;
+  }
+
+  const size_t alen = std::fread(buf, 1, len, File);
+  if (std::ferror(File)) {
+    throw std::runtime_error(std::strerror(errno));
+  }
+
+  Pos += alen;
+  if (alen < len) {
+    // the file was truncated under us
+    Size = Pos;
+  }
+
+  return {buf, alen};
+}
+
+std::future<std::pair<const char*, size_t>> SparseFileReader::read(size_t len) {
+  std::swap(Cur, Next);
+  return std::async(
+    std::launch::async,
+    [this](char* buf, size_t len) {
+      return fill(buf, len);
+    },
+    Next.get(), len
+  );
+}
+
+MemoryMappedFileReader::MemoryMappedFileReader(const std::string& path):
+  M(path.c_str(), bip::read_only), Size(std::filesystem::file_size(path)),
+  Pos(0), FaultTime(0.0)
+{}
+
 std::future<std::pair<const char*, size_t>> MemoryMappedFileReader::read(size_t len) {
-  len = std::min(len, static_cast<size_t>(Bend - Buf));
-  std::promise<std::pair<const char*, size_t>> p;
-  p.set_value(std::make_pair(Buf, len));
-  Buf += len;
-  return p.get_future();
+  // the last window handed out may still be in use, the one before it
+  // is not
+  std::swap(Cur, Next);
+  Next.reset();
+
+  len = std::min(static_cast<uint64_t>(len), Size - Pos);
+  const uint64_t off = Pos;
+  Pos += len;
+
+  if (!len) {
+    // the empty final block sits at the end of the last window, so that
+    // hits closed out there can still be read back
+    static const char empty[1] = "";
+    const char* const bend = Cur ?
+      static_cast<const char*>(Cur->get_address()) + Cur->get_size() : empty;
+
+    std::promise<std::pair<const char*, size_t>> p;
+    p.set_value(std::pair<const char*, size_t>{bend, 0});
+    return p.get_future();
+  }
+
+  return std::async(
+    std::launch::async,
+    [this](uint64_t off, size_t len) {
+      Timer faultClock;
+
+      Next.reset(new bip::mapped_region(M, bip::read_only, off, len));
+      Next->advise(bip::mapped_region::advice_willneed);
+
+      // touch each page so the faults happen here, not in the search
+      const char* const beg = static_cast<const char*>(Next->get_address());
+      const size_t pageSize = bip::mapped_region::get_page_size();
+      volatile char sink = 0;
+      for (size_t i = 0; i < len; i += pageSize) {
+        sink = sink + beg[i];
+      }
+
+      FaultTime += faultClock.elapsed();
+      return std::pair<const char*, size_t>{beg, len};
+    },
+    off, len
+  );
+}
+
+Compression sniffCompression(const std::string& path) {
+  if (path == "-") {
+    // can't put back what we'd read
+    return Compression::NONE;
+  }
+
+  unsigned char magic[6] = {0};
+  FILE* f = std::fopen(path.c_str(), "rb");
+  if (!f) {
+    throw std::runtime_error(std::strerror(errno));
+  }
+  const size_t mlen = std::fread(magic, 1, sizeof(magic), f);
+  std::fclose(f);
+
+  static const unsigned char GZIP_MAGIC[] = { 0x1F, 0x8B };
+  static const unsigned char XZ_MAGIC[] = { 0xFD, '7', 'z', 'X', 'Z', 0x00 };
+  static const unsigned char ZSTD_MAGIC[] = { 0x28, 0xB5, 0x2F, 0xFD };
+
+  if (mlen >= sizeof(GZIP_MAGIC) && !std::memcmp(magic, GZIP_MAGIC, sizeof(GZIP_MAGIC))) {
+    return Compression::GZIP;
+  }
+  else if (mlen >= sizeof(XZ_MAGIC) && !std::memcmp(magic, XZ_MAGIC, sizeof(XZ_MAGIC))) {
+    return Compression::XZ;
+  }
+  else if (mlen >= sizeof(ZSTD_MAGIC) && !std::memcmp(magic, ZSTD_MAGIC, sizeof(ZSTD_MAGIC))) {
+    return Compression::ZSTD;
+  }
+  else {
+    return Compression::NONE;
+  }
+}
+
+bool canDecompress(Compression c) {
+  switch (c) {
+#ifdef HAVE_ZLIB
+  case Compression::GZIP:
+    return true;
+#endif
+#ifdef HAVE_LZMA
+  case Compression::XZ:
+    return true;
+#endif
+#ifdef HAVE_ZSTD
+  case Compression::ZSTD:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+const char* compressionName(Compression c) {
+  switch (c) {
+  case Compression::GZIP:
+    return "gzip";
+  case Compression::XZ:
+    return "xz";
+  case Compression::ZSTD:
+    return "zstd";
+  default:
+    return "uncompressed";
+  }
+}
+
+class Decompressor {
+public:
+  Decompressor(FILE* in): In(in), InBuf(new unsigned char[IN_SIZE]), Done(false) {}
+
+  virtual ~Decompressor() {}
+
+  // Fill buf with up to len decompressed bytes; fewer only at the end
+  size_t read(char* buf, size_t len) {
+    size_t total = 0;
+    while (total < len && !Done) {
+      total += decode(buf + total, len - total);
+    }
+    return total;
+  }
+
+protected:
+  static const size_t IN_SIZE = 1 << 20;
+
+  // Produce some output, setting Done at the end of the input
+  virtual size_t decode(char* buf, size_t len) = 0;
+
+  size_t refill() {
+    const size_t ilen = std::fread(InBuf.get(), 1, IN_SIZE, In);
+    if (std::ferror(In)) {
+      throw std::runtime_error(std::strerror(errno));
+    }
+    return ilen;
+  }
+
+  FILE* In;
+  std::unique_ptr<unsigned char[]> InBuf;
+  bool Done;
+};
+
+namespace {
+
+#ifdef HAVE_ZLIB
+class GzipDecompressor: public Decompressor {
+public:
+  GzipDecompressor(FILE* in): Decompressor(in), Strm(), MemberEnd(false) {
+    // 15 + 32 takes either a gzip or zlib header
+    if (inflateInit2(&Strm, 15 + 32) != Z_OK) {
+      throw std::runtime_error("could not initialize zlib");
+    }
+  }
+
+  virtual ~GzipDecompressor() {
+    inflateEnd(&Strm);
+  }
+
+protected:
+  virtual size_t decode(char* buf, size_t len) override {
+    if (!Strm.avail_in) {
+      Strm.next_in = InBuf.get();
+      Strm.avail_in = refill();
+      if (!Strm.avail_in) {
+        if (!MemberEnd) {
+          throw std::runtime_error("gzip: unexpected end of compressed data");
+        }
+        Done = true;
+        return 0;
+      }
+    }
+
+    Strm.next_out = reinterpret_cast<Bytef*>(buf);
+    Strm.avail_out = len;
+
+    switch (inflate(&Strm, Z_NO_FLUSH)) {
+    case Z_STREAM_END:
+      // gzip files may hold several members back to back
+      inflateReset(&Strm);
+      MemberEnd = true;
+      break;
+    case Z_OK:
+    case Z_BUF_ERROR:
+      MemberEnd = false;
+      break;
+    case Z_DATA_ERROR:
+      if (MemberEnd) {
+        // trailing garbage after a complete member, as gzip(1) ignores
+        Done = true;
+        break;
+      }
+      [[fallthrough]];
+    default:
+      throw std::runtime_error(
+        std::string("gzip: ") + (Strm.msg ? Strm.msg : "corrupt data")
+      );
+    }
+
+    return len - Strm.avail_out;
+  }
+
+private:
+  z_stream Strm;
+  bool MemberEnd;
+};
+#endif
+
+#ifdef HAVE_LZMA
+class XzDecompressor: public Decompressor {
+public:
+  XzDecompressor(FILE* in): Decompressor(in), Strm(LZMA_STREAM_INIT), Action(LZMA_RUN) {
+    if (lzma_stream_decoder(&Strm, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+      throw std::runtime_error("could not initialize liblzma");
+    }
+  }
+
+  virtual ~XzDecompressor() {
+    lzma_end(&Strm);
+  }
+
+protected:
+  virtual size_t decode(char* buf, size_t len) override {
+    if (!Strm.avail_in && Action == LZMA_RUN) {
+      Strm.next_in = InBuf.get();
+      Strm.avail_in = refill();
+      if (!Strm.avail_in) {
+        Action = LZMA_FINISH;
+      }
+    }
+
+    Strm.next_out = reinterpret_cast<uint8_t*>(buf);
+    Strm.avail_out = len;
+
+    switch (lzma_code(&Strm, Action)) {
+    case LZMA_STREAM_END:
+      Done = true;
+      break;
+    case LZMA_OK:
+      break;
+    case LZMA_BUF_ERROR:
+      throw std::runtime_error("xz: unexpected end of compressed data");
+    default:
+      throw std::runtime_error("xz: corrupt data");
+    }
+
+    return len - Strm.avail_out;
+  }
+
+private:
+  lzma_stream Strm;
+  lzma_action Action;
+};
+#endif
+
+#ifdef HAVE_ZSTD
+class ZstdDecompressor: public Decompressor {
+public:
+  ZstdDecompressor(FILE* in): Decompressor(in), Strm(ZSTD_createDStream()), InPos{InBuf.get(), 0, 0}, Pending(0) {
+    if (!Strm || ZSTD_isError(ZSTD_initDStream(Strm))) {
+      ZSTD_freeDStream(Strm);
+      throw std::runtime_error("could not initialize libzstd");
+    }
+  }
+
+  virtual ~ZstdDecompressor() {
+    ZSTD_freeDStream(Strm);
+  }
+
+protected:
+  virtual size_t decode(char* buf, size_t len) override {
+    if (InPos.pos == InPos.size) {
+      InPos.pos = 0;
+      InPos.size = refill();
+      if (!InPos.size) {
+        if (Pending) {
+          throw std::runtime_error("zstd: unexpected end of compressed data");
+        }
+        Done = true;
+        return 0;
+      }
+    }
+
+    ZSTD_outBuffer out{buf, len, 0};
+
+    // returns 0 at the end of each frame; frames may follow one another
+    Pending = ZSTD_decompressStream(Strm, &out, &InPos);
+    if (ZSTD_isError(Pending)) {
+      throw std::runtime_error(
+        std::string("zstd: ") + ZSTD_getErrorName(Pending)
+      );
+    }
+
+    return out.pos;
+  }
+
+private:
+  ZSTD_DStream* Strm;
+  ZSTD_inBuffer InPos;
+  size_t Pending;
+};
+#endif
+
+Decompressor* makeDecompressor(Compression c, FILE* in) {
+  switch (c) {
+#ifdef HAVE_ZLIB
+  case Compression::GZIP:
+    return new GzipDecompressor(in);
+#endif
+#ifdef HAVE_LZMA
+  case Compression::XZ:
+    return new XzDecompressor(in);
+#endif
+#ifdef HAVE_ZSTD
+  case Compression::ZSTD:
+    return new ZstdDecompressor(in);
+#endif
+  default:
+    throw std::runtime_error(
+      std::string("cannot decompress ") + compressionName(c) + " input"
+    );
+  }
+}
+
+}
+
+DecompressingReader::DecompressingReader(const std::string& path, Compression c, size_t blockSize):
+  File(try_open(path)), Cur(new char[blockSize]), Next(new char[blockSize])
+{
+  try {
+    Dec.reset(makeDecompressor(c, File));
+  }
+  catch (...) {
+    std::fclose(File);
+    throw;
+  }
+}
+
+DecompressingReader::~DecompressingReader() {
+  std::fclose(File);
+}
+
+std::future<std::pair<const char*, size_t>> DecompressingReader::read(size_t len) {
+  std::swap(Cur, Next);
+  return std::async(
+    std::launch::async,
+    [](char* buf, size_t len, Decompressor* dec) {
+      return std::pair<const char*, size_t>{buf, dec->read(buf, len)};
+    },
+    Next.get(), len, Dec.get()
+  );
 }
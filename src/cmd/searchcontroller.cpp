@@ -16,6 +16,7 @@
  */
 
 #include "searchcontroller.h"
+#include "lineindex.h"
 #include "timer.h"
 
 #include <algorithm>
@@ -47,15 +48,35 @@ bool SearchController::searchFile(
 
   const char* buf;
 
+  // hits go to the ring, if any, to be written once their context is in
+  if (Ring) {
+    Ring->reset();
+  }
+  void* const userData = Ring ? static_cast<void*>(Ring.get()) : hinfo;
+  const LG_HITCALLBACK_FN onHit = Ring ? &ContextRing::hold : callback;
+
   std::tie(buf, blkSize) = reader.read(BlockSize).get();
+  StallTime += searchClock.elapsed() - lastTime;
   while (blkSize) {
+    // the previous block must be kept before the next read may reuse it
+    if (Ring) {
+      Ring->advance(buf, blkSize, offset);
+    }
+    else {
+      hinfo->setBuffer(buf, blkSize, offset);
+    }
+
     // start getting next block
     std::future<std::pair<const char*, size_t>> fut = reader.read(BlockSize);
 
     // search cur block
-    hinfo->setBuffer(buf, blkSize, offset);
-
-    lg_search(searcher, buf, buf + blkSize, offset, hinfo, callback);
+    if (reader.hole(buf)) {
+      lg_search_zeros(searcher, blkSize, offset, userData, onHit);
+      HoleBytes += blkSize;
+    }
+    else {
+      lg_search(searcher, buf, buf + blkSize, offset, userData, onHit);
+    }
 
     offset += blkSize;
 
@@ -65,19 +86,68 @@ bool SearchController::searchFile(
       lastTime = thisTime;
     }
 
+    const double stallStart = searchClock.elapsed();
     std::tie(buf, blkSize) = fut.get(); // block on i/o thread completion
+    StallTime += searchClock.elapsed() - stallStart;
+
+    if (Ring) {
+      Ring->release(buf, blkSize, !blkSize, hinfo, callback);
+    }
   }
 
   // assert: all data has been read, offset + blkSize == file size,
   // cur is last block
-  hinfo->setBuffer(buf, blkSize, offset);
+  if (Ring) {
+    Ring->advance(buf, blkSize, offset);
+  }
+  else {
+    hinfo->setBuffer(buf, blkSize, offset);
+  }
 
-  lg_search(searcher, buf, buf + blkSize, offset, hinfo, callback);
+  lg_search(searcher, buf, buf + blkSize, offset, userData, onHit);
 
-  lg_closeout_search(searcher, hinfo, callback);
+  lg_closeout_search(searcher, userData, onHit);
   offset += blkSize;  // be sure to count the last block
 
+  if (Ring) {
+    Ring->release(nullptr, 0, true, hinfo, callback);
+  }
+
   TotalTime += searchClock.elapsed();
+  FaultTime += reader.faultTime();
   BytesSearched += offset;
   return true;
 }
+
+void SearchController::replayFile(
+  const std::string& path,
+  uint64_t size,
+  const std::vector<LG_SearchHit>& hits,
+  HitOutputData* hinfo,
+  LG_HITCALLBACK_FN callback)
+{
+  if (!hits.empty()) {
+    // context and histograms read the hits from the file; mapping it
+    // faults in only the pages they touch
+    const bip::file_mapping m(path.c_str(), bip::read_only);
+    const bip::mapped_region region(m, bip::read_only);
+    const char* const beg = static_cast<const char*>(region.get_address());
+    hinfo->setBuffer(beg, region.get_size(), 0);
+
+    uint64_t pos = 0, lines = 0;
+    for (const LG_SearchHit& hit: hits) {
+      if (hinfo->OutInfo.LineNumbers) {
+        // hits come mostly in order, so count on from the last one
+        if (hit.Start < pos) {
+          pos = lines = 0;
+        }
+        lines += countLines(beg + pos, beg + hit.Start);
+        pos = hit.Start;
+        hinfo->OutInfo.Line = lines + 1;
+      }
+      callback(hinfo, &hit);
+    }
+  }
+
+  DedupBytes += size;
+}
@@ -20,11 +20,13 @@
 
 #include "jlightgrep.h"
 
+#include <algorithm>
 #include <functional>
 #include <limits>
 #include <memory>
 #include <sstream>
 #include <tuple>
+#include <vector>
 
 static const char ALL_IS_LOST[] = "Fuck it, Dude. Let's go bowling.";
 
@@ -34,12 +36,14 @@ static const char contextHandleClassName[] = "com/lightboxtechnologies/lightgrep
 
 static const char hitCallbackClassName[] = "com/lightboxtechnologies/lightgrep/HitCallback";
 static const char searchHitClassName[] = "com/lightboxtechnologies/lightgrep/SearchHit";
+static const char hitBatchCallbackClassName[] = "com/lightboxtechnologies/lightgrep/HitBatchCallback";
 
 static const char hitContextClassName[] = "com/lightboxtechnologies/lightgrep/HitContext";
 
 static const char keywordExceptionClassName[] = "com/lightboxtechnologies/lightgrep/KeywordException";
 static const char programExceptionClassName[] = "com/lightboxtechnologies/lightgrep/ProgramException";
 static const char indexOutOfBoundsExceptionClassName[] = "java/lang/IndexOutOfBoundsException";
+static const char illegalArgumentExceptionClassName[] = "java/lang/IllegalArgumentException";
 static const char unsupportedEncodingExceptionClassName[] = "java/io/UnsupportedEncodingException";
 
 class PendingJavaException {};
@@ -155,9 +159,31 @@ JNIEXPORT void JNICALL Java_com_lightboxtechnologies_lightgrep_HitContext_init(J
   }
 }
 
+static jfieldID hitBatchStartsField;
+static jfieldID hitBatchEndsField;
+static jfieldID hitBatchKeywordIndicesField;
+
+JNIEXPORT void JNICALL Java_com_lightboxtechnologies_lightgrep_HitBatch_init(JNIEnv* env, jclass cl) {
+  try {
+    hitBatchStartsField = env->GetFieldID(cl, "Starts", "[J");
+    throwIfException(env);
+
+    hitBatchEndsField = env->GetFieldID(cl, "Ends", "[J");
+    throwIfException(env);
+
+    hitBatchKeywordIndicesField = env->GetFieldID(cl, "KeywordIndices", "[I");
+    throwIfException(env);
+  }
+  catch (const PendingJavaException&) {
+  }
+}
+
 static jclass hitCallbackClass;
 static jmethodID hitCallbackCallback;
 
+static jclass hitBatchCallbackClass;
+static jmethodID hitBatchCallbackCallback;
+
 static jclass searchHitClass;
 static jmethodID searchHitCtor;
 static jfieldID searchHitStartField;
@@ -185,6 +211,16 @@ JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* jvm, void*) {
     hitCallbackCallback = env->GetMethodID(hitCallbackClass, "callback", "(Lcom/lightboxtechnologies/lightgrep/SearchHit;)V");
     throwIfException(env);
 
+    // HitBatchCallback is an interface too, so likewise
+    cl = env->FindClass(hitBatchCallbackClassName);
+    throwIfException(env);
+
+    hitBatchCallbackClass = reinterpret_cast<jclass>(env->NewGlobalRef(cl));
+    if (!hitBatchCallbackClass) throw PendingJavaException();
+
+    hitBatchCallbackCallback = env->GetMethodID(hitBatchCallbackClass, "callback", "(Lcom/lightboxtechnologies/lightgrep/HitBatch;I)V");
+    throwIfException(env);
+
     // We make a global reference for SearchHit to avoid calling FindClass
     // for it on every hit in the callbackShim.
     cl = env->FindClass(searchHitClassName);
@@ -221,6 +257,7 @@ JNIEXPORT void JNI_OnUnload(JavaVM* jvm, void*) {
   }
 
   env->DeleteGlobalRef(hitCallbackClass);
+  env->DeleteGlobalRef(hitBatchCallbackClass);
   env->DeleteGlobalRef(searchHitClass);
 }
 
@@ -640,7 +677,9 @@ JNIEXPORT jobject JNICALL Java_com_lightboxtechnologies_lightgrep_ProgramHandle_
 
     LG_ContextOptions opts{
       std::numeric_limits<uint64_t>::max(),
-      std::numeric_limits<uint64_t>::max()
+      std::numeric_limits<uint64_t>::max(),
+      0,
+      0
     };
 
     LG_HCONTEXT hCtx = lg_create_context(ptr, &opts);
@@ -748,6 +787,146 @@ JNIEXPORT jint JNICALL Java_com_lightboxtechnologies_lightgrep_ContextHandle_sea
   }
 }
 
+//
+// Gathers hits natively and copies them into the arrays of a HitBatch
+// only when it is full, or when flushed at the end of a call, so that a
+// block with many hits costs a few calls into Java rather than a
+// SearchHit and a call for each.
+//
+class BatchShim {
+public:
+  BatchShim(JNIEnv* env, jobject batch, jobject callback):
+    Env(env), Batch(batch), Callback(callback),
+    Starts(static_cast<jlongArray>(env->GetObjectField(batch, hitBatchStartsField))),
+    Ends(static_cast<jlongArray>(env->GetObjectField(batch, hitBatchEndsField))),
+    KeywordIndices(static_cast<jintArray>(env->GetObjectField(batch, hitBatchKeywordIndicesField))),
+    Capacity(std::min({
+      env->GetArrayLength(Starts),
+      env->GetArrayLength(Ends),
+      env->GetArrayLength(KeywordIndices)
+    })),
+    Count(0),
+    S(Capacity), E(Capacity), K(Capacity)
+  {}
+
+  static void callback(void* userData, const LG_SearchHit* const hit) {
+    // NB: As in callbackShim, exceptions thrown here pass through the C API
+
+    BatchShim* shim = static_cast<BatchShim*>(userData);
+    shim->S[shim->Count] = hit->Start;
+    shim->E[shim->Count] = hit->End;
+    shim->K[shim->Count] = hit->KeywordIndex;
+
+    if (++shim->Count == shim->Capacity) {
+      shim->flush();
+    }
+  }
+
+  void flush() {
+    if (!Count) {
+      return;
+    }
+
+    Env->SetLongArrayRegion(Starts, 0, Count, S.data());
+    Env->SetLongArrayRegion(Ends, 0, Count, E.data());
+    Env->SetIntArrayRegion(KeywordIndices, 0, Count, K.data());
+
+    const jint n = Count;
+    Count = 0;
+
+    Env->CallVoidMethod(Callback, hitBatchCallbackCallback, Batch, n);
+    throwIfException(Env);
+  }
+
+private:
+  JNIEnv* Env;
+  jobject Batch;
+  jobject Callback;
+
+  jlongArray Starts;
+  jlongArray Ends;
+  jintArray KeywordIndices;
+
+  const jsize Capacity;
+  jsize Count;
+
+  std::vector<jlong> S, E;
+  std::vector<jint> K;
+};
+
+static int searchBatch(JNIEnv* env, jobject hCtx, const char* buf, jint offset, jint size, jlong startOffset, jobject batch, jobject callback) {
+  // convert all of the Java objects to C
+  LG_HCONTEXT ptr = reinterpret_cast<LG_HCONTEXT>(
+    env->GetLongField(hCtx, handlePointerField)
+  );
+
+  buf += offset;
+
+  BatchShim shim(env, batch, callback);
+
+  // finally actually do something
+  const int ret = lg_search(
+    ptr,
+    buf,
+    buf + size,
+    (uint64_t) startOffset,
+    &shim,
+    BatchShim::callback
+  );
+  throwIfException(env);
+
+  shim.flush();
+  return ret;
+}
+
+JNIEXPORT jint JNICALL Java_com_lightboxtechnologies_lightgrep_ContextHandle_searchBatchImpl___3BIIJLcom_lightboxtechnologies_lightgrep_HitBatch_2Lcom_lightboxtechnologies_lightgrep_HitBatchCallback_2(JNIEnv* env, jobject hCtx, jbyteArray buffer, jint offset, jint size, jlong startOffset, jobject batch, jobject callback) {
+  try {
+    std::unique_ptr<jbyte,std::function<void(jbyte*)>> data(unwrap(env, buffer));
+    const char* buf = reinterpret_cast<const char*>(data.get());
+    return searchBatch(env, hCtx, buf, offset, size, startOffset, batch, callback);
+  }
+  catch (const PendingJavaException&) {
+    return 0;
+  }
+}
+
+JNIEXPORT jint JNICALL Java_com_lightboxtechnologies_lightgrep_ContextHandle_searchBatchImpl__Ljava_nio_ByteBuffer_2IIJLcom_lightboxtechnologies_lightgrep_HitBatch_2Lcom_lightboxtechnologies_lightgrep_HitBatchCallback_2(JNIEnv* env, jobject hCtx, jobject buffer, jint offset, jint size, jlong startOffset, jobject batch, jobject callback) {
+  try {
+    const char* buf = static_cast<const char*>(
+      env->GetDirectBufferAddress(buffer)
+    );
+
+    if (!buf) {
+      // not a direct buffer, or the JVM doesn't support direct access
+      throwException(env, illegalArgumentExceptionClassName, "buffer has no direct address");
+    }
+
+    return searchBatch(env, hCtx, buf, offset, size, startOffset, batch, callback);
+  }
+  catch (const PendingJavaException&) {
+    return 0;
+  }
+}
+
+JNIEXPORT void JNICALL Java_com_lightboxtechnologies_lightgrep_ContextHandle_closeoutSearchBatchImpl(JNIEnv* env, jobject hCtx, jobject batch, jobject callback) {
+  try {
+    // convert all of the Java objects to C
+    LG_HCONTEXT ptr = reinterpret_cast<LG_HCONTEXT>(
+      env->GetLongField(hCtx, handlePointerField)
+    );
+
+    BatchShim shim(env, batch, callback);
+
+    // finally actually do something
+    lg_closeout_search(ptr, &shim, BatchShim::callback);
+    throwIfException(env);
+
+    shim.flush();
+  }
+  catch (const PendingJavaException&) {
+  }
+}
+
 JNIEXPORT void JNICALL Java_com_lightboxtechnologies_lightgrep_ContextHandle_closeoutSearchImpl(JNIEnv* env, jobject hCtx, jobject callback) {
   try {
     // convert all of the Java objects to C
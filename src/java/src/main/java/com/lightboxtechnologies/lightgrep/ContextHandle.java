@@ -122,6 +122,61 @@ public class ContextHandle extends Handle {
 
   private native int searchImpl(ByteBuffer buffer, int offset, int size, long startOffset, HitCallback callback);
 
+  /**
+   * Searches as search(byte[], int, int, long, HitCallback) does, but
+   * gathers the hits into the batch, calling back only when it is full
+   * and once more at the end with any left over.
+   *
+   * @throws IllegalStateException
+   * @throws IndexOutOfBoundsException
+   * @throws NullPointerException
+   */
+  public int search(byte[] buffer, int offset, int size, long startOffset, HitBatch batch, HitBatchCallback callback) {
+    throwIfNull("buffer", buffer);
+    throwIfNegative("offset", offset);
+    throwIfNegative("size", size);
+    throwIfByteArrayTooSmall("buffer", buffer, "offset", offset, "size", size);
+    throwIfNegative("startOffset", startOffset);
+    throwIfNull("batch", batch);
+    throwIfNull("callback", callback);
+    throwIfDestroyed(this);
+    return searchBatchImpl(buffer, offset, size, startOffset, batch, callback);
+  }
+
+  public int search(ByteBuffer buffer, int size, long startOffset, HitBatch batch, HitBatchCallback callback) {
+    throwIfNull("buffer", buffer);
+    throwIfNegative("size", size);
+    throwIfByteBufferTooSmall("buffer", buffer, "size", size);
+    throwIfNegative("startOffset", startOffset);
+    throwIfNull("batch", batch);
+    throwIfNull("callback", callback);
+    throwIfDestroyed(this);
+
+    if (buffer.isDirect()) {
+      return searchBatchImpl(buffer, buffer.position(), size, startOffset, batch, callback);
+    }
+    else {
+      byte[] array = null;
+      int position = 0;
+      if (buffer.hasArray()) {
+        // buffer wraps an array, use that
+        array = buffer.array();
+        position = buffer.arrayOffset() + buffer.position();
+      }
+      else {
+        // ugh, this buffer must be read-only
+        array = new byte[size];
+        buffer.get(array);
+      }
+
+      return searchBatchImpl(array, position, size, startOffset, batch, callback);
+    }
+  }
+
+  private native int searchBatchImpl(byte[] buffer, int offset, int size, long startOffset, HitBatch batch, HitBatchCallback callback);
+
+  private native int searchBatchImpl(ByteBuffer buffer, int offset, int size, long startOffset, HitBatch batch, HitBatchCallback callback);
+
   /**
    * @throws IllegalStateException
    * @throws IndexOutOfBoundsException
@@ -133,4 +188,17 @@ public class ContextHandle extends Handle {
   }
 
   private native void closeoutSearchImpl(HitCallback callback);
+
+  /**
+   * @throws IllegalStateException
+   * @throws NullPointerException
+   */
+  public void closeoutSearch(HitBatch batch, HitBatchCallback callback) {
+    throwIfNull("batch", batch);
+    throwIfNull("callback", callback);
+    throwIfDestroyed(this);
+    closeoutSearchBatchImpl(batch, callback);
+  }
+
+  private native void closeoutSearchBatchImpl(HitBatch batch, HitBatchCallback callback);
 }
@@ -0,0 +1,33 @@
+package com.lightboxtechnologies.lightgrep;
+
+import static com.lightboxtechnologies.lightgrep.Throws.*;
+
+/**
+ * Holds hits in parallel arrays, so that a search can hand them over many
+ * at a time rather than making a SearchHit and a call into Java for each.
+ */
+public class HitBatch {
+  static {
+    LibraryLoader.init();
+  }
+
+  static native void init();
+
+  public final long[] Starts;
+  public final long[] Ends;
+  public final int[] KeywordIndices;
+
+  /**
+   * @throws IndexOutOfBoundsException
+   */
+  public HitBatch(int capacity) {
+    throwIfLessThan("capacity", capacity, 1);
+    Starts = new long[capacity];
+    Ends = new long[capacity];
+    KeywordIndices = new int[capacity];
+  }
+
+  public int capacity() {
+    return Starts.length;
+  }
+}
@@ -0,0 +1,9 @@
+package com.lightboxtechnologies.lightgrep;
+
+public interface HitBatchCallback {
+  /**
+   * Receives the first count hits held in the batch. The batch is reused
+   * once this returns.
+   */
+  void callback(HitBatch batch, int count);
+}
@@ -14,5 +14,6 @@ class LibraryLoader {
     PatternInfo.init();
 
     HitContext.init();
+    HitBatch.init();
   }
 }
@@ -19,6 +19,22 @@ public abstract class AbstractSearchTest extends AbstractDataDrivenTest {
     private final List<SearchHit> hits;
   }
 
+  protected static class BatchCollector implements HitBatchCallback {
+    public BatchCollector(List<SearchHit> l) {
+      hits = l;
+    }
+
+    public void callback(HitBatch batch, int count) {
+      for (int i = 0; i < count; ++i) {
+        hits.add(new SearchHit(
+          batch.Starts[i], batch.Ends[i], batch.KeywordIndices[i]
+        ));
+      }
+    }
+
+    private final List<SearchHit> hits;
+  }
+
   protected static class Pat {
     public final String pattern;
     public final KeyOptions opts;
@@ -1273,6 +1273,45 @@ public class LightgrepTest {
     }
   }
 
+  private static class BatchCallbackExploder implements HitBatchCallback {
+    public void callback(HitBatch batch, int count) {
+      throw new RuntimeException("Out of cheese");
+    }
+  }
+
+  @Test(expected=RuntimeException.class)
+  public void searchArrayBadBatchCallbackTest() throws Exception {
+    try (final FSMHandle hFsm = new FSMHandle(0, 0)) {
+      try (final ProgramHandle hProg = new ProgramHandle(0)) {
+        try (final PatternHandle hPattern = new PatternHandle()) {
+          final KeyOptions kopts = new KeyOptions();
+          kopts.FixedString = false;
+          kopts.CaseInsensitive = false;
+          kopts.UnicodeMode = false;
+
+          hPattern.parsePattern("a+b", kopts);
+          hFsm.addPattern(hPattern, "ASCII", 0);
+
+          final ProgramOptions popts = new ProgramOptions();
+          popts.Determinize = true;
+
+          hProg.compile(hFsm, popts);
+
+          final byte[] buf = "aaabaacabbabcacbaccbbbcbccca".getBytes("ASCII");
+          final ContextOptions copts = new ContextOptions();
+          try (final ContextHandle hCtx = hProg.createContext(copts)) {
+            hCtx.search(buf, 0, buf.length, 0, new HitBatch(1), new BatchCallbackExploder());
+          }
+        }
+      }
+    }
+  }
+
+  @Test(expected=IndexOutOfBoundsException.class)
+  public void hitBatchZeroCapacityTest() throws Exception {
+    new HitBatch(0);
+  }
+
   @Test(expected=NullPointerException.class)
   public void searchDirectByteBufferNullCallbackTest() throws Exception {
     try (final FSMHandle hFsm = new FSMHandle(0, 0)) {
@@ -0,0 +1,40 @@
+package com.lightboxtechnologies.lightgrep;
+
+import org.junit.runner.RunWith;
+import org.junit.runners.Parameterized;
+import org.junit.runners.Parameterized.Parameters;
+
+import java.io.UnsupportedEncodingException;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.Collection;
+import java.util.List;
+
+import static org.junit.Assert.assertEquals;
+
+@RunWith(Parameterized.class)
+public class SearchBatchArrayTest extends BaseSearchTest {
+
+  @Parameters
+  public static Collection<Object[]> data() throws UnsupportedEncodingException {
+    return SearchArrayTest.data();
+  }
+
+  public SearchBatchArrayTest(int fsmSizeHint, int pmapSizeHint, Pat[] pats, ProgramOptions popts, ContextOptions copts, byte[] buf, int offset, int size, long startOffset, long endOffset, SearchHit[] ehits, Class<? extends Throwable> tclass) {
+    super(fsmSizeHint, pmapSizeHint, pats, popts, copts, buf, offset, size, startOffset, endOffset, ehits, tclass);
+  }
+
+  protected void runSearch(ContextHandle hCtx) throws Throwable {
+    final List<SearchHit> hits = new ArrayList<SearchHit>();
+    final HitBatchCallback cb = new BatchCollector(hits);
+
+    // small enough to fill mid-search
+    final HitBatch batch = new HitBatch(2);
+
+    final int ret = hCtx.search(buf, offset, size, startOffset, batch, cb);
+    assertEquals(endOffset, ret);
+
+    hCtx.closeoutSearch(batch, cb);
+    assertEquals(Arrays.asList(ehits), hits);
+  }
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "allocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace {
+  void* defaultAlloc(void*, size_t size) {
+    return std::malloc(size);
+  }
+
+  void defaultFree(void*, void* p, size_t) {
+    std::free(p);
+  }
+
+  const size_t HUGE_PAGE = 2 << 20;
+
+  const LG_Allocator DEFAULT = { defaultAlloc, defaultFree, nullptr, HUGE_PAGE };
+
+  LG_Allocator Hooks = DEFAULT;
+
+  // room for the size of a sized block, keeping what follows aligned
+  const size_t HEADER = alignof(std::max_align_t);
+
+  bool huge(size_t size) {
+#ifdef __linux__
+    return Hooks.HugePageMin && size >= Hooks.HugePageMin;
+#else
+    return false;
+#endif
+  }
+
+  size_t hugeLength(size_t size) {
+    return (size + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+  }
+
+  // The blocks lgAllocLarge() mapped, and their lengths. HugePageMin may
+  // have changed by the time a block is freed, so the size alone does not
+  // tell how it was allocated.
+  std::mutex MappedLock;
+  std::unordered_map<void*, size_t> Mapped;
+
+  // no block smaller than this was mapped, so smaller ones need no lookup
+  std::atomic<size_t> MinMapped(SIZE_MAX);
+}
+
+void lg_set_allocator(const LG_Allocator* alloc) {
+  Hooks = alloc ? *alloc : DEFAULT;
+  if (!Hooks.Alloc || !Hooks.Free) {
+    Hooks.Alloc = defaultAlloc;
+    Hooks.Free = defaultFree;
+  }
+}
+
+void* lgAlloc(size_t size) {
+  // never ask the hooks for nothing, so that null always means failure
+  void* p = Hooks.Alloc(Hooks.UserData, size ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void lgFree(void* p, size_t size) {
+  if (p) {
+    Hooks.Free(Hooks.UserData, p, size ? size : 1);
+  }
+}
+
+void* lgAllocLarge(size_t size) {
+#ifdef __linux__
+  if (huge(size)) {
+    // map a huge page more than needed, and trim it to begin on a huge
+    // page boundary, else the kernel cannot back it with huge pages
+    const size_t len = hugeLength(size);
+    void* m = mmap(nullptr, len + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+
+    char* const beg = static_cast<char*>(m);
+    char* const p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(beg) + HUGE_PAGE - 1) & ~uintptr_t(HUGE_PAGE - 1));
+    if (p > beg) {
+      munmap(beg, p - beg);
+    }
+    if (p + len < beg + len + HUGE_PAGE) {
+      munmap(p + len, (beg + len + HUGE_PAGE) - (p + len));
+    }
+
+#ifdef MADV_HUGEPAGE
+    // advice only; without transparent huge pages these are small pages
+    madvise(p, len, MADV_HUGEPAGE);
+#endif
+
+    try {
+      std::lock_guard<std::mutex> lock(MappedLock);
+      Mapped.emplace(p, len);
+      if (size < MinMapped.load(std::memory_order_relaxed)) {
+        MinMapped.store(size, std::memory_order_relaxed);
+      }
+    }
+    catch (const std::bad_alloc&) {
+      munmap(p, len);
+      throw;
+    }
+    return p;
+  }
+#endif
+  return lgAlloc(size);
+}
+
+void lgFreeLarge(void* p, size_t size) {
+#ifdef __linux__
+  if (p && size >= MinMapped.load(std::memory_order_relaxed)) {
+    size_t len = 0;
+    {
+      std::lock_guard<std::mutex> lock(MappedLock);
+      const auto i = Mapped.find(p);
+      if (i != Mapped.end()) {
+        len = i->second;
+        Mapped.erase(i);
+      }
+    }
+
+    if (len) {
+      munmap(p, len);
+      return;
+    }
+  }
+#endif
+  lgFree(p, size);
+}
+
+void* lgAllocSized(size_t size) {
+  char* p = static_cast<char*>(lgAlloc(HEADER + size));
+  std::memcpy(p, &size, sizeof(size));
+  return p + HEADER;
+}
+
+void lgFreeSized(void* p) {
+  if (p) {
+    char* const beg = static_cast<char*>(p) - HEADER;
+    size_t size;
+    std::memcpy(&size, beg, sizeof(size));
+    lgFree(beg, HEADER + size);
+  }
+}
+
+char* clone_c_str(const char* s) {
+  try {
+    const size_t len = std::strlen(s) + 1;
+    return static_cast<char*>(std::memcpy(lgAllocSized(len), s, len));
+  }
+  catch (const std::bad_alloc&) {
+    return nullptr;
+  }
+}
+
+Arena::~Arena() {
+  for (const auto& b: Blocks) {
+    lgFree(b.first, b.second);
+  }
+}
+
+void* Arena::alloc(size_t size, size_t align) {
+  char* p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(Cur) + align - 1) & ~uintptr_t(align - 1));
+  if (!Cur || p > End || size > size_t(End - p)) {
+    // blocks double in size up to BlockMax, so that small automata stay
+    // small; objects larger than that get a block of their own
+    const size_t len = std::max(Next, size);
+    p = Cur = static_cast<char*>(lgAlloc(len));
+    Blocks.emplace_back(p, len);
+    End = Cur + len;
+    Next = std::min(2 * Next, BlockMax);
+  }
+  Cur = p + size;
+  return p;
+}
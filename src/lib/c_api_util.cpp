@@ -18,6 +18,7 @@
 #include <cstring>
 #include <new>
 
+#include "allocator.h"
 #include "c_api_util.h"
 
 LG_Error* makeError(
@@ -28,7 +29,7 @@ LG_Error* makeError(
   int index
 ) {
   try {
-    return new LG_Error{
+    return new (lgAlloc(sizeof(LG_Error))) LG_Error{
       clone_c_str(msg), // don't make messageless errors
       pattern ? clone_c_str(pattern) : nullptr,
       encodingChain ? clone_c_str(encodingChain) : nullptr,
@@ -173,7 +173,27 @@ ProgramPtr Compiler::createProgram(const NFA& graph) {
   ProgramPtr ret(new Program(cg.Guard+2));
   ret->MaxLabel= cg.MaxLabel;
   ret->MaxCheck = cg.MaxCheck;
-  std::tie(ret->FilterOff, ret->Filter) = bestPair(graph);
+  const std::vector<std::bitset<256*256>> pairs(pairWindows(graph));
+  std::tie(ret->FilterOff, ret->Filter) = bestPair(pairs);
+
+  if (zeroPadded(ret->Filter)) {
+    // Wide characters: each pair is half zero byte, so the window admits
+    // nearly every character. Pair the bytes either side of the zero, if
+    // that admits no more pairs; a short pattern leaves the second byte
+    // free, which would admit far more.
+    const std::vector<std::bitset<256*256>> wide(pairWindows(graph, 2));
+    const std::pair<uint32_t,std::bitset<256*256>> best(bestWidePair(wide));
+    if (best.first < wide.size() &&
+        best.second.count() <= ret->Filter.count())
+    {
+      std::tie(ret->FilterOff, ret->Filter) = best;
+      ret->FilterStride = 2;
+    }
+  }
+
+  ret->FilterWindows = filterWindows(
+    graph, pairs, ret->FilterOff, ret->FilterStride, ret->Filter
+  );
 
   for (NFA::VertexDescriptor v = 0; v < numVs; ++v) {
     // if (++i % 10000 == 0) {
@@ -17,6 +17,7 @@
 
 #include "chain.h"
 #include "decoders/asciidecoder.h"
+#include "decoders/base64decoder.h"
 #include "decoders/bytesource.h"
 #include "decoders/icudecoder.h"
 #include "decoders/decoderfactory.h"
@@ -30,10 +31,11 @@
 #include "boost_lexical_cast.h"
 
 std::shared_ptr<Decoder> DecoderFactory::get(const std::string& chain) {
-  // return a cached encoder if we have one
+  // decoders hold their position, so callers each get their own copy of
+  // the cached chain rather than sharing it
   auto i = Cache.find(chain);
   if (i != Cache.end()) {
-    return i->second;
+    return std::shared_ptr<Decoder>(i->second->clone());
   }
 
   // parse the transformation chain
@@ -51,6 +53,9 @@ std::shared_ptr<Decoder> DecoderFactory::get(const std::string& chain) {
     else if (*bb == "OCE") {
       enc.reset(new OCEDecoder(std::move(enc)));
     }
+    else if (*bb == "Base64") {
+      enc.reset(new Base64Decoder(std::move(enc)));
+    }
     else if (bb->substr(0, 3) == "XOR") {
       enc.reset(new XORDecoder(
         boost::lexical_cast<byte>(bb->substr(3)), std::move(enc)
@@ -91,5 +96,6 @@ std::shared_ptr<Decoder> DecoderFactory::get(const std::string& chain) {
     }
   }
 
+  Cache[chain] = std::shared_ptr<Decoder>(enc->clone());
   return std::shared_ptr<Decoder>(std::move(enc));
 }
@@ -72,6 +72,10 @@ void EncoderBase::collectRanges(const UnicodeSet& uset, std::vector<std::vector<
     }
   }
 
+  sortRanges(va);
+}
+
+void EncoderBase::sortRanges(std::vector<std::vector<ByteSet>>& va) {
   // sort encoding ranges by size
   std::sort(va.begin(), va.end(),
     [](const std::vector<ByteSet>& a, const std::vector<ByteSet>& b) {
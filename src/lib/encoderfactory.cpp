@@ -15,6 +15,7 @@
  *
  */
 
+#include "basic.h"
 #include "chain.h"
 #include "encoders/ascii.h"
 #include "encoders/concrete_encoders.h"
@@ -84,6 +85,15 @@ std::shared_ptr<Encoder> EncoderFactory::get(const std::string& chain) {
     else if (bb == "OCE") {
       enc.reset(new OCEEncoder(std::move(enc)));
     }
+    else if (bb == "Base64") {
+      // Base64 does not encode characters one by one, so it is applied to
+      // the graph of each pattern instead; see FSMThingy::addPattern()
+      if (&bb != &bytebyte.back()) {
+        THROW_RUNTIME_ERROR_WITH_OUTPUT(
+          "Base64 must be the last byte->byte transformation"
+        );
+      }
+    }
   }
 
   for (auto cc = charchar.crbegin(); cc != charchar.crend(); ++cc) {
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "encoders/encodingtable.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+
+EncodingTable::EncodingTable(const ICUConverter& conv, const UnicodeSet& valid):
+  MaxLen(conv.maxByteLength())
+{
+  std::unique_ptr<byte[]> cur(new byte[MaxLen]);
+
+  for (const UnicodeSet::range r : valid) {
+    for (uint32_t cp = r.first; cp < r.second; ++cp) {
+      const uint32_t len = conv.cp_to_bytes(cp, cur.get());
+      if (len == 0) {
+        continue;
+      }
+
+      // extend the last run if cp follows it and its last byte counts up
+      if (!Runs.empty()) {
+        Run& run = Runs.back();
+        const byte* enc = bytes(Runs.size()-1);
+        if (run.Last == cp && run.Len == len &&
+            std::equal(cur.get(), cur.get()+len-1, enc) &&
+            enc[len-1] + (cp - run.First) == cur[len-1])
+        {
+          ++run.Last;
+          continue;
+        }
+      }
+
+      Runs.push_back(Run{cp, cp+1, len});
+      Bytes.insert(Bytes.end(), cur.get(), cur.get()+len);
+      Bytes.resize(Runs.size()*MaxLen);
+    }
+  }
+}
+
+std::shared_ptr<const EncodingTable> EncodingTable::get(const ICUConverter& conv, const UnicodeSet& valid) {
+  static std::mutex m;
+  static std::map<std::string,std::shared_ptr<const EncodingTable>> tables;
+
+  std::lock_guard<std::mutex> lock(m);
+  std::shared_ptr<const EncodingTable>& t = tables[conv.name()];
+  if (!t) {
+    t = std::make_shared<const EncodingTable>(conv, valid);
+  }
+  return t;
+}
+
+uint32_t EncodingTable::write(int32_t cp, byte buf[]) const {
+  const auto i = std::upper_bound(Runs.begin(), Runs.end(), static_cast<uint32_t>(cp),
+    [](uint32_t c, const Run& run) { return c < run.First; }
+  );
+
+  if (i == Runs.begin() || static_cast<uint32_t>(cp) >= (i-1)->Last) {
+    return 0;
+  }
+
+  const Run& run = *(i-1);
+  std::copy(bytes(i-1-Runs.begin()), bytes(i-1-Runs.begin()) + run.Len, buf);
+  buf[run.Len-1] += cp - run.First;
+  return run.Len;
+}
+
+void EncodingTable::collect(const UnicodeSet& uset, std::vector<std::vector<ByteSet>>& va) const {
+  const byte* prev = nullptr;
+  uint32_t plen = 0;
+
+  for (const UnicodeSet::range r : uset) {
+    auto i = std::upper_bound(Runs.begin(), Runs.end(), r.first,
+      [](uint32_t c, const Run& run) { return c < run.First; }
+    );
+    if (i != Runs.begin()) {
+      --i;
+    }
+
+    for ( ; i != Runs.end() && i->First < r.second; ++i) {
+      const uint32_t l = std::max(r.first, i->First),
+                     h = std::min(r.second, i->Last);
+      if (l >= h) {
+        continue;
+      }
+
+      const byte* enc = bytes(i-Runs.begin());
+      const uint32_t len = i->Len;
+
+      // start a new encoding unless this one matches the previous up to
+      // the last byte
+      if (len != plen || !std::equal(enc, enc+len-1, prev)) {
+        va.emplace_back(len);
+        for (uint32_t j = 0; j < len-1; ++j) {
+          va.back()[j].set(enc[j]);
+        }
+
+        prev = enc;
+        plen = len;
+      }
+
+      const uint32_t lb = enc[len-1] + (l - i->First);
+      va.back().back().set(lb, lb + (h - l), true);
+    }
+  }
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "fanout_vm.h"
+
+FanOutVm::FanOutVm(std::shared_ptr<VmInterface> vm, const PatternMap& pmap):
+  Vm(vm), Begin(pmap.count() + 1, 0), Duplicates()
+{
+  const size_t n = pmap.count();
+
+  // count the duplicates of each pattern, then place them in order
+  for (size_t i = 0; i < n; ++i) {
+    if (pmap.original(i) != i) {
+      ++Begin[pmap.original(i) + 1];
+    }
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    Begin[i + 1] += Begin[i];
+  }
+  Duplicates.resize(Begin[n]);
+
+  std::vector<uint32_t> next(Begin.begin(), Begin.end() - 1);
+  for (size_t i = 0; i < n; ++i) {
+    const uint32_t o = pmap.original(i);
+    if (o != i) {
+      Duplicates[next[o]++] = i;
+    }
+  }
+}
+
+void FanOutVm::fanOut(void* userData, const LG_SearchHit* const hit) {
+  const Fan* fan = static_cast<const Fan*>(userData);
+  const FanOutVm& self = *fan->Self;
+
+  // in the order the search would have found them had each duplicate its
+  // own automaton, the last added first
+  const uint32_t label = hit->KeywordIndex;
+  if (label + 1 < self.Begin.size()) {
+    LG_SearchHit dup(*hit);
+    for (uint32_t i = self.Begin[label + 1]; i > self.Begin[label]; --i) {
+      dup.KeywordIndex = self.Duplicates[i - 1];
+      (*fan->Fn)(fan->UserData, &dup);
+    }
+  }
+
+  (*fan->Fn)(fan->UserData, hit);
+}
+
+void FanOutVm::startsWith(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData) {
+  Fan fan{this, hitFn, userData};
+  Vm->startsWith(beg, end, startOffset, hitFn ? &FanOutVm::fanOut : nullptr, &fan);
+}
+
+void FanOutVm::startsWithMany(const byte* const beg, const byte* const end, const uint64_t startOffset, const uint64_t* const offsets, const size_t num, HitCallback hitFn, void* userData) {
+  Fan fan{this, hitFn, userData};
+  Vm->startsWithMany(beg, end, startOffset, offsets, num, hitFn ? &FanOutVm::fanOut : nullptr, &fan);
+}
+
+uint64_t FanOutVm::search(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData) {
+  Fan fan{this, hitFn, userData};
+  return Vm->search(beg, end, startOffset, hitFn ? &FanOutVm::fanOut : nullptr, &fan);
+}
+
+uint64_t FanOutVm::searchResolve(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData) {
+  Fan fan{this, hitFn, userData};
+  return Vm->searchResolve(beg, end, startOffset, hitFn ? &FanOutVm::fanOut : nullptr, &fan);
+}
+
+uint64_t FanOutVm::searchZeros(const uint64_t count, const uint64_t startOffset, HitCallback hitFn, void* userData) {
+  Fan fan{this, hitFn, userData};
+  return Vm->searchZeros(count, startOffset, hitFn ? &FanOutVm::fanOut : nullptr, &fan);
+}
+
+void FanOutVm::closeOut(HitCallback hitFn, void* userData) {
+  Fan fan{this, hitFn, userData};
+  Vm->closeOut(hitFn ? &FanOutVm::fanOut : nullptr, &fan);
+}
+
+void FanOutVm::reset() {
+  Vm->reset();
+}
+
+void FanOutVm::setDedupThreads(bool dedup) {
+  Vm->setDedupThreads(dedup);
+}
+
+void FanOutVm::setMaxThreads(uint32_t maxThreads) {
+  Vm->setMaxThreads(maxThreads);
+}
+
+uint64_t FanOutVm::droppedThreads() const {
+  return Vm->droppedThreads();
+}
+
+#ifdef LBT_TRACE_ENABLED
+void FanOutVm::setDebugRange(uint64_t beg, uint64_t end) {
+  Vm->setDebugRange(beg, end);
+}
+#endif
@@ -17,12 +17,20 @@
 
 #include "fsmthingy.h"
 #include "encoders/encoder.h"
+#include "utility.h"
 
+#include "lightgrep/transforms.h"
+#include "lightgrep/util.h"
+
+#include <cstring>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
-FSMThingy::FSMThingy(uint32_t sizeHint): Fsm(new NFA(1, sizeHint)) {
+FSMThingy::FSMThingy(uint32_t sizeHint):
+  Fsm(new NFA(1, sizeHint)), Finalized(false)
+{
   Fsm->TransFac = Nfab.getTransFac();
 }
 
@@ -36,6 +44,13 @@ void FSMThingy::addPattern(const ParseTree& tree, const char* chain, uint32_t la
 
   // build the NFA for this pattern
   if (Nfab.build(tree)) {
+    // Base64 can only be applied to the pattern as a whole, and must come
+    // last in the chain, which the encoder factory has checked
+    const char* last = std::strrchr(chain, '|');
+    if (last && lg_get_byte_transform_id(last + 1) == LG_BYTE_TRANSFORM_BASE64) {
+      *Nfab.getFsm() = base64Graph(*Nfab.getFsm());
+    }
+
     // and merge it into the greater NFA
     Comp.pruneBranches(*Nfab.getFsm());
     Comp.mergeIntoFSM(*Fsm, *Nfab.getFsm());
@@ -45,17 +60,47 @@ void FSMThingy::addPattern(const ParseTree& tree, const char* chain, uint32_t la
   }
 }
 
+NFAPtr FSMThingy::finalize(NFAPtr g, uint32_t determinizeDepth) {
+  if (determinizeDepth && !g->Deterministic) {
+    NFAPtr dfa(new NFA(1, 2 * g->verticesSize(), g->edgesSize()));
+    dfa->TransFac = g->TransFac;
+    Comp.subsetDFA(*dfa, *g, determinizeDepth);
+    g = dfa;
+  }
+
+  Comp.labelGuardStates(*g);
+  return g;
+}
+
 void FSMThingy::finalizeGraph(uint32_t determinizeDepth) {
   if (Fsm->verticesSize() < 2) {
     throw std::runtime_error("No valid patterns were parsed");
   }
 
-  if (determinizeDepth && !Fsm->Deterministic) {
-    NFAPtr dfa(new NFA(1, 2 * Fsm->verticesSize(), Fsm->edgesSize()));
-    dfa->TransFac = Fsm->TransFac;
-    Comp.subsetDFA(*dfa, *Fsm, determinizeDepth);
-    Fsm = dfa;
+  Fsm = finalize(Fsm, determinizeDepth);
+  Finalized = true;
+}
+
+NFAPtr FSMThingy::xorGraph(uint32_t determinizeDepth) {
+  if (Fsm->verticesSize() < 2) {
+    throw std::runtime_error("No valid patterns were parsed");
+  }
+
+  NFAPtr diff(new NFA(differenceGraph(*Fsm)));
+  return finalize(diff, determinizeDepth);
+}
+
+std::vector<std::pair<NFAPtr,std::vector<uint32_t>>> FSMThingy::partitionGraph(uint32_t numLabels, uint32_t parts, uint32_t determinizeDepth) {
+  if (Fsm->verticesSize() < 2) {
+    throw std::runtime_error("No valid patterns were parsed");
+  }
+
+  std::vector<std::pair<NFAPtr,std::vector<uint32_t>>> ret;
+  for (std::vector<uint32_t>& labels : partitionLabels(*Fsm, numLabels, parts)) {
+    NFAPtr sub(new NFA(labelSubgraph(*Fsm, labels)));
+    ret.emplace_back(finalize(sub, determinizeDepth), std::move(labels));
   }
 
-  Comp.labelGuardStates(*Fsm);
+  Finalized = true;
+  return ret;
 }
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "handoff_vm.h"
+
+#include <algorithm>
+#include <limits>
+
+HandoffVm::HandoffVm(std::shared_ptr<VmInterface> from, std::shared_ptr<VmInterface> to, uint64_t offset, uint64_t limit):
+  From(from), To(to), Offset(offset),
+  Until(limit > std::numeric_limits<uint64_t>::max() - offset ? std::numeric_limits<uint64_t>::max() : offset + limit),
+  EndsMax(0), FromDropped(0)
+{}
+
+void HandoffVm::before(void* userData, const LG_SearchHit* const hit) {
+  const Relay* r = static_cast<const Relay*>(userData);
+  HandoffVm& vm = *r->Vm;
+  if (hit->Start < vm.Offset) {
+    uint64_t& end = vm.Ends[hit->KeywordIndex];
+    end = std::max(end, hit->End);
+    vm.EndsMax = std::max(vm.EndsMax, hit->End);
+    (*r->Fn)(r->UserData, hit);
+  }
+}
+
+void HandoffVm::after(void* userData, const LG_SearchHit* const hit) {
+  const Relay* r = static_cast<const Relay*>(userData);
+  if (r->Vm->From) {
+    r->Vm->Held.push_back(*hit);
+  }
+  else {
+    r->Vm->pass(*hit, r->Fn, r->UserData);
+  }
+}
+
+void HandoffVm::pass(const LG_SearchHit& hit, HitCallback hitFn, void* userData) const {
+  const auto i = Ends.find(hit.KeywordIndex);
+  if (i == Ends.end() || hit.Start >= i->second) {
+    (*hitFn)(userData, &hit);
+  }
+}
+
+void HandoffVm::retire(HitCallback hitFn, void* userData) {
+  // no live thread began before the offset, but there may be matches
+  // waiting to be reported
+  Relay r{this, hitFn, userData};
+  From->closeOut(hitFn ? &HandoffVm::before : nullptr, &r);
+  FromDropped += From->droppedThreads();
+  From.reset();
+
+  if (hitFn) {
+    for (const LG_SearchHit& hit: Held) {
+      pass(hit, hitFn, userData);
+    }
+  }
+  Held.clear();
+}
+
+uint64_t HandoffVm::budget(uint64_t count, uint64_t startOffset) const {
+  return From && startOffset < Until ? std::min(count, Until - startOffset) : count;
+}
+
+template <class F>
+uint64_t HandoffVm::run(F fn, uint64_t through, HitCallback hitFn, void* userData) {
+  Relay r{this, hitFn, userData};
+
+  uint64_t left = std::numeric_limits<uint64_t>::max();
+  if (From) {
+    left = fn(*From, hitFn ? &HandoffVm::before : nullptr, &r);
+    if (left >= Offset || through >= Until) {
+      retire(hitFn, userData);
+      left = std::numeric_limits<uint64_t>::max();
+    }
+  }
+
+  if (!From && Ends.empty()) {
+    return std::min(left, fn(*To, hitFn, userData));
+  }
+
+  const uint64_t toLeft = fn(*To, hitFn ? &HandoffVm::after : nullptr, &r);
+  if (!From && toLeft >= EndsMax) {
+    // the new program can find nothing more to overlap the old one's hits
+    Ends.clear();
+  }
+  return std::min(left, toLeft);
+}
+
+void HandoffVm::startsWith(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData) {
+  To->startsWith(beg, end, startOffset, hitFn, userData);
+}
+
+void HandoffVm::startsWithMany(const byte* const beg, const byte* const end, const uint64_t startOffset, const uint64_t* const offsets, const size_t num, HitCallback hitFn, void* userData) {
+  To->startsWithMany(beg, end, startOffset, offsets, num, hitFn, userData);
+}
+
+uint64_t HandoffVm::search(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData) {
+  // the old program is retired where its limit falls, and the new one
+  // searches the rest alone
+  const uint64_t len = budget(end - beg, startOffset);
+  if (len < static_cast<uint64_t>(end - beg)) {
+    search(beg, beg + len, startOffset, hitFn, userData);
+    return search(beg + len, end, startOffset + len, hitFn, userData);
+  }
+
+  return run(
+    [=](VmInterface& vm, HitCallback fn, void* ud) {
+      return vm.search(beg, end, startOffset, fn, ud);
+    },
+    startOffset + (end - beg), hitFn, userData
+  );
+}
+
+uint64_t HandoffVm::searchResolve(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData) {
+  const uint64_t len = budget(end - beg, startOffset);
+  if (len < static_cast<uint64_t>(end - beg)) {
+    search(beg, beg + len, startOffset, hitFn, userData);
+    return searchResolve(beg + len, end, startOffset + len, hitFn, userData);
+  }
+
+  return run(
+    [=](VmInterface& vm, HitCallback fn, void* ud) {
+      return vm.searchResolve(beg, end, startOffset, fn, ud);
+    },
+    startOffset + (end - beg), hitFn, userData
+  );
+}
+
+uint64_t HandoffVm::searchZeros(const uint64_t count, const uint64_t startOffset, HitCallback hitFn, void* userData) {
+  const uint64_t len = budget(count, startOffset);
+  if (len < count) {
+    searchZeros(len, startOffset, hitFn, userData);
+    return searchZeros(count - len, startOffset + len, hitFn, userData);
+  }
+
+  return run(
+    [=](VmInterface& vm, HitCallback fn, void* ud) {
+      return vm.searchZeros(count, startOffset, fn, ud);
+    },
+    startOffset + count, hitFn, userData
+  );
+}
+
+void HandoffVm::closeOut(HitCallback hitFn, void* userData) {
+  if (From) {
+    retire(hitFn, userData);
+  }
+
+  Relay r{this, hitFn, userData};
+  To->closeOut(hitFn ? &HandoffVm::after : nullptr, &r);
+  Ends.clear();
+}
+
+void HandoffVm::reset() {
+  From.reset();
+  Ends.clear();
+  EndsMax = 0;
+  Held.clear();
+  FromDropped = 0;
+  To->reset();
+}
+
+void HandoffVm::setDedupThreads(bool dedup) {
+  if (From) {
+    From->setDedupThreads(dedup);
+  }
+  To->setDedupThreads(dedup);
+}
+
+void HandoffVm::setMaxThreads(uint32_t maxThreads) {
+  if (From) {
+    From->setMaxThreads(maxThreads);
+  }
+  To->setMaxThreads(maxThreads);
+}
+
+uint64_t HandoffVm::droppedThreads() const {
+  return FromDropped + (From ? From->droppedThreads() : 0) + To->droppedThreads();
+}
+
+#ifdef LBT_TRACE_ENABLED
+void HandoffVm::setDebugRange(uint64_t beg, uint64_t end) {
+  if (From) {
+    From->setDebugRange(beg, end);
+  }
+  To->setDebugRange(beg, end);
+}
+#endif
@@ -22,10 +22,18 @@ ICUEncoder::ICUEncoder(const std::string& name):
   Conv(name)
 {
   Valid = Conv.validCodePoints();
+  Table = EncodingTable::get(Conv, Valid);
 }
 
 uint32_t ICUEncoder::write(int32_t cp, byte buf[]) const {
-  return Conv.cp_to_bytes(cp, buf);
+  // code points outside the table are invalid, but let ICU have its say
+  const uint32_t len = Table->write(cp, buf);
+  return len ? len : Conv.cp_to_bytes(cp, buf);
+}
+
+void ICUEncoder::collectRanges(const UnicodeSet& uset, std::vector<std::vector<ByteSet>>& va) const {
+  Table->collect(uset, va);
+  sortRanges(va);
 }
 
 uint32_t ICUEncoder::write(const byte [], int32_t&) const {
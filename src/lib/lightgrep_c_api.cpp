@@ -19,20 +19,27 @@
 
 #include "lightgrep/api.h"
 
+#include "allocator.h"
 #include "automata.h"
 #include "c_api_util.h"
 #include "compiler.h"
+#include "fanout_vm.h"
 #include "handles.h"
 #include "nfabuilder.h"
 #include "nfaoptimizer.h"
 #include "parser.h"
 #include "parsetree.h"
+#include "partitioned_vm.h"
 #include "program.h"
 #include "utility.h"
 #include "vm_interface.h"
 
+#include <algorithm>
 #include <cstring>
 #include <functional>
+#include <limits>
+#include <map>
+#include <numeric>
 #include <string>
 #include <vector>
 
@@ -61,11 +68,11 @@ namespace {
 void lg_free_error(LG_Error* err) {
   while (err) {
     LG_Error* next = err->Next;
-    delete[] err->Pattern;
-    delete[] err->EncodingChain;
-    delete[] err->Message;
-    delete[] err->Source;
-    delete err;
+    lgFreeSized(err->Pattern);
+    lgFreeSized(err->EncodingChain);
+    lgFreeSized(err->Message);
+    lgFreeSized(err->Source);
+    lgFree(err, sizeof(LG_Error));
     err = next;
   }
 }
@@ -139,14 +146,30 @@ void lg_destroy_fsm(LG_HFSM hFsm) {
 namespace {
   int addPattern(LG_HFSM hFsm, LG_HPATTERN hPattern, const char* encoding, uint64_t userIndex) {
     const uint32_t label = hFsm->PMap->count();
-    hFsm->Impl->addPattern(hPattern->Tree, encoding, label);
+
+    // patterns which parse the same, whatever their options or how they
+    // were written, match the same; build only the first
+    std::string key(treeKey(hPattern->Tree));
+    key += '\0';
+    key += encoding;
+
+    const auto orig = hFsm->Originals.emplace(std::move(key), label);
+    if (orig.second) {
+      try {
+        hFsm->Impl->addPattern(hPattern->Tree, encoding, label);
+      }
+      catch (...) {
+        hFsm->Originals.erase(orig.first);
+        throw;
+      }
+    }
 
     // modify a copy if anything else depends on this pattern map
     if (hFsm->PMap.use_count() > 1) {
       hFsm->PMap.reset(new PatternMap(*hFsm->PMap));
     }
 
-    hFsm->PMap->addPattern(hPattern->Pat.Expression.c_str(), encoding, userIndex);
+    hFsm->PMap->addPattern(hPattern->Pat.Expression.c_str(), encoding, userIndex, orig.first->second);
     return (int) label;
   }
 }
@@ -339,6 +362,45 @@ LG_PatternInfo* lg_fsm_pattern_info(LG_HFSM hFsm,
   return &(*hFsm->PMap)[patternIndex];
 }
 
+int lg_analyze_pattern(LG_HFSM hFsm,
+                       unsigned int patternIndex,
+                       LG_PatternStats* stats,
+                       LG_Error** err)
+{
+  if (!hFsm) {
+    setError(err, "hFsm parameter was null. Use lg_create_fsm() to allocate.");
+    return 0;
+  }
+  if (!stats) {
+    setError(err, "LG_PatternStats parameter was null. Please pass a valid struct.");
+    return 0;
+  }
+  if (patternIndex >= hFsm->PMap->count()) {
+    setError(err, "patternIndex is out of range.");
+    return 0;
+  }
+  if (hFsm->Impl->Finalized) {
+    setError(err, "FSM has already been compiled. Analyze patterns before calling lg_create_program().");
+    return 0;
+  }
+
+  return trapWithVals(
+    [hFsm, patternIndex, stats]() {
+      // a duplicate pattern shares the match states of its original
+      const PatternStats ps = analyzePattern(
+        *hFsm->Impl->Fsm, hFsm->PMap->original(patternIndex)
+      );
+      stats->MaxFanOut = ps.MaxFanOut;
+      stats->Loops = ps.Loops;
+      stats->MinLength = ps.MinLength;
+      stats->FilterPairs = ps.FilterPairs;
+      stats->DefeatsPrefilter = ps.FilterPairs == 256*256;
+      stats->Cost = ps.Cost;
+    },
+    1, 0, err
+  );
+}
+
 unsigned int lg_prog_pattern_count(const LG_HPROGRAM hProg) {
   return hProg->PMap->count();
 }
@@ -356,10 +418,119 @@ namespace {
       lg_destroy_program
     );
 
-    hFsm->Impl->finalizeGraph(opts->DeterminizeDepth);
+    hProg->PMap = hFsm->PMap;
+
+    if (opts->Partitions > 1 && hFsm->PMap->count() > 1) {
+      for (auto& part : hFsm->Impl->partitionGraph(hFsm->PMap->count(), opts->Partitions, opts->DeterminizeDepth)) {
+        hProg->Parts.push_back(Compiler::createProgram(*part.first));
+        hProg->PartLabels.push_back(std::move(part.second));
+      }
+    }
+    else {
+      hFsm->Impl->finalizeGraph(opts->DeterminizeDepth);
+      hProg->Prog = Compiler::createProgram(*hFsm->Impl->Fsm);
+    }
+
+    return hProg.release();
+  }
+
+  LG_HPROGRAM create_xor_program(LG_HFSM hFsm, const LG_ProgramOptions* opts) {
+    std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> hProg(
+      new ProgramHandle,
+      lg_destroy_program
+    );
 
     hProg->PMap = hFsm->PMap;
-    hProg->Prog = Compiler::createProgram(*hFsm->Impl->Fsm);
+
+    FSMThingy& fsm = *hFsm->Impl;
+
+    // each hit of the differences is checked under its keys from its start
+    // to as far as a match could run, which must not be the whole input
+    hProg->XorMaxLen = maxMatchLength(*fsm.Fsm);
+    if (hProg->XorMaxLen == std::numeric_limits<uint32_t>::max()) {
+      throw std::runtime_error("lg_create_xor_program() needs patterns whose matches are bounded in length");
+    }
+
+    hProg->Diff = Compiler::createProgram(*fsm.xorGraph(opts->DeterminizeDepth));
+
+    for (const NFA::VertexDescriptor v : fsm.Fsm->outVertices(0)) {
+      (*fsm.Fsm)[v].Trans->orBytes(hProg->XorFirst);
+    }
+
+    fsm.finalizeGraph(opts->DeterminizeDepth);
+    hProg->Prog = Compiler::createProgram(*fsm.Fsm);
+
+    return hProg.release();
+  }
+}
+
+namespace {
+  // the most parts a delta program may have, as each is searched by its
+  // own thread
+  const size_t MAX_DELTA_PARTS = 64;
+
+  LG_HPROGRAM create_delta_program(LG_HPROGRAM hBase, LG_HFSM hFsm, const LG_ProgramOptions* opts) {
+    if (hBase->Diff) {
+      throw std::runtime_error("lg_create_delta_program() cannot extend a program made by lg_create_xor_program()");
+    }
+
+    std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> hProg(
+      new ProgramHandle,
+      lg_destroy_program
+    );
+
+    // the new patterns are numbered after the base program's
+    const PatternMap& base = *hBase->PMap;
+    const PatternMap& added = *hFsm->PMap;
+    const uint32_t n = base.count();
+
+    hProg->PMap.reset(new PatternMap(base));
+    for (uint32_t i = 0; i < added.count(); ++i) {
+      hProg->PMap->addPattern(
+        added[i].Pattern, added[i].EncodingChain, added[i].UserIndex,
+        n + added.original(i)
+      );
+    }
+
+    // the base program's parts are shared, not recompiled
+    if (hBase->Prog) {
+      hProg->Parts.push_back(hBase->Prog);
+      hProg->PartLabels.emplace_back(n);
+      std::iota(hProg->PartLabels[0].begin(), hProg->PartLabels[0].end(), 0);
+    }
+    else {
+      hProg->Parts = hBase->Parts;
+      hProg->PartLabels = hBase->PartLabels;
+    }
+
+    std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> delta(
+      create_program(hFsm, opts),
+      lg_destroy_program
+    );
+
+    if (delta->Prog) {
+      std::vector<uint32_t> labels(added.count());
+      std::iota(labels.begin(), labels.end(), n);
+      hProg->Parts.push_back(delta->Prog);
+      hProg->PartLabels.push_back(std::move(labels));
+    }
+    else {
+      for (size_t i = 0; i < delta->Parts.size(); ++i) {
+        std::vector<uint32_t> labels(delta->PartLabels[i]);
+        for (uint32_t& l : labels) {
+          l += n;
+        }
+        hProg->Parts.push_back(delta->Parts[i]);
+        hProg->PartLabels.push_back(std::move(labels));
+      }
+    }
+
+    if (hProg->Parts.size() > MAX_DELTA_PARTS) {
+      throw std::runtime_error(
+        "lg_create_delta_program() would make a program of more than " +
+        std::to_string(MAX_DELTA_PARTS) + " parts; compile all the patterns afresh instead"
+      );
+    }
 
     return hProg.release();
   }
@@ -372,12 +543,75 @@ LG_HPROGRAM lg_create_program(LG_HFSM hFsm, const LG_ProgramOptions* options) {
   );
 }
 
+LG_HPROGRAM lg_create_delta_program(LG_HPROGRAM hBase, LG_HFSM hFsm, const LG_ProgramOptions* options) {
+  return trapWithRetval(
+    [hBase, hFsm, options](){ return create_delta_program(hBase, hFsm, options); },
+    nullptr
+  );
+}
+
+LG_HPROGRAM lg_create_xor_program(LG_HFSM hFsm, const LG_ProgramOptions* options) {
+  return trapWithRetval(
+    [hFsm, options](){ return create_xor_program(hFsm, options); },
+    nullptr
+  );
+}
+
+namespace {
+  // the bytes of ProgramHandle::XorFirst, as serialized
+  const size_t XOR_FIRST_SIZE = 256 / 8;
+
+  // what follows the pattern map in a serialized program
+  const uint64_t PLAIN_IMAGE = 1,
+                 XOR_IMAGE = 2,
+                 PARTITIONED_IMAGE = 3;
+}
+
 unsigned int lg_program_size(const LG_HPROGRAM hProg) {
-  return sizeof(uint64_t) + hProg->PMap->bufSize() +
-         sizeof(uint64_t) + hProg->Prog->bufSize();
+  uint64_t size = sizeof(uint64_t) + hProg->PMap->bufSize() + sizeof(uint64_t) + sizeof(uint64_t);
+
+  if (hProg->Prog) {
+    size += hProg->Prog->bufSize();
+
+    if (hProg->Diff) {
+      size += sizeof(uint64_t) + hProg->Diff->bufSize() + XOR_FIRST_SIZE + sizeof(hProg->XorMaxLen);
+    }
+  }
+  else {
+    for (size_t i = 0; i < hProg->Parts.size(); ++i) {
+      size += sizeof(uint64_t) + hProg->PartLabels[i].size() * sizeof(uint32_t) +
+              sizeof(uint64_t) + hProg->Parts[i]->bufSize();
+    }
+  }
+
+  return size;
 }
 
 namespace {
+  void write_part(const Program& prog, char*& dst) {
+    const std::vector<char> prog_buf = prog.marshall();
+    const uint64_t prog_size = prog_buf.size();
+    *reinterpret_cast<uint64_t*>(dst) = prog_size;
+    dst += sizeof(prog_size);
+    std::memcpy(dst, prog_buf.data(), prog_size);
+    dst += prog_size;
+  }
+
+  ProgramPtr read_part(const char*& src, const char* const end) {
+    if (src + sizeof(uint64_t) > end) {
+      return ProgramPtr();
+    }
+    const uint64_t prog_size = *reinterpret_cast<const uint64_t*>(src);
+    src += sizeof(prog_size);
+
+    if (prog_size == 0 || src + prog_size > end) {
+      return ProgramPtr();
+    }
+    ProgramPtr prog = Program::unmarshall(src, prog_size);
+    src += prog_size;
+    return prog;
+  }
+
   void write_program(const LG_HPROGRAM hProg, void* buffer) {
     char* dst = reinterpret_cast<char*>(buffer);
 
@@ -388,12 +622,48 @@ namespace {
     std::memcpy(dst, pmap_buf.data(), pmap_size);
     dst += pmap_size;
 
-    const std::vector<char> prog_buf = hProg->Prog->marshall();
-    const uint64_t prog_size = prog_buf.size();
-    *reinterpret_cast<uint64_t*>(dst) = prog_size;
-    dst += sizeof(prog_size);
-    std::memcpy(dst, prog_buf.data(), prog_size);
-    dst += prog_size;
+    const uint64_t kind = hProg->Prog ?
+      (hProg->Diff ? XOR_IMAGE : PLAIN_IMAGE) : PARTITIONED_IMAGE;
+    *reinterpret_cast<uint64_t*>(dst) = kind;
+    dst += sizeof(kind);
+
+    if (hProg->Prog) {
+      write_part(*hProg->Prog, dst);
+
+      // an XOR program follows its plain one with its difference program,
+      // the bytes which can begin a match, and its longest match
+      if (hProg->Diff) {
+        write_part(*hProg->Diff, dst);
+        for (size_t i = 0; i < XOR_FIRST_SIZE; ++i) {
+          byte b = 0;
+          for (size_t j = 0; j < 8; ++j) {
+            b |= hProg->XorFirst[8*i + j] << j;
+          }
+          *dst++ = b;
+        }
+
+        std::memcpy(dst, &hProg->XorMaxLen, sizeof(hProg->XorMaxLen));
+        dst += sizeof(hProg->XorMaxLen);
+      }
+    }
+    else {
+      // a partitioned program has the count of parts, then each part's
+      // labels and program
+      const uint64_t nparts = hProg->Parts.size();
+      *reinterpret_cast<uint64_t*>(dst) = nparts;
+      dst += sizeof(nparts);
+
+      for (uint64_t i = 0; i < nparts; ++i) {
+        const std::vector<uint32_t>& labels = hProg->PartLabels[i];
+        const uint64_t nlabels = labels.size();
+        *reinterpret_cast<uint64_t*>(dst) = nlabels;
+        dst += sizeof(nlabels);
+        std::memcpy(dst, labels.data(), nlabels * sizeof(uint32_t));
+        dst += nlabels * sizeof(uint32_t);
+
+        write_part(*hProg->Parts[i], dst);
+      }
+    }
   }
 
   LG_HPROGRAM read_program(const void* buffer, size_t size) {
@@ -415,18 +685,82 @@ namespace {
       return nullptr;
     }
     hProg->PMap = PatternMap::unmarshall(src, pmap_size);
+    if (!hProg->PMap) {
+      return nullptr;
+    }
     src += pmap_size;
 
     if (src + sizeof(uint64_t) > end) {
       return nullptr;
     }
-    const uint64_t prog_size = *reinterpret_cast<const uint64_t*>(src);
-    src += sizeof(prog_size);
+    const uint64_t kind = *reinterpret_cast<const uint64_t*>(src);
+    src += sizeof(kind);
+
+    if (kind == PLAIN_IMAGE || kind == XOR_IMAGE) {
+      hProg->Prog = read_part(src, end);
+      if (!hProg->Prog) {
+        return nullptr;
+      }
+
+      if (kind == XOR_IMAGE) {
+        hProg->Diff = read_part(src, end);
+        if (!hProg->Diff || static_cast<size_t>(end - src) < XOR_FIRST_SIZE + sizeof(hProg->XorMaxLen)) {
+          return nullptr;
+        }
+
+        for (size_t i = 0; i < XOR_FIRST_SIZE; ++i) {
+          const byte b = *src++;
+          for (size_t j = 0; j < 8; ++j) {
+            hProg->XorFirst[8*i + j] = (b >> j) & 1;
+          }
+        }
+
+        std::memcpy(&hProg->XorMaxLen, src, sizeof(hProg->XorMaxLen));
+        src += sizeof(hProg->XorMaxLen);
+      }
+
+      return src == end ? hProg.release() : nullptr;
+    }
+    else if (kind != PARTITIONED_IMAGE) {
+      return nullptr;
+    }
+
+    // partitioned
+    if (src + sizeof(uint64_t) > end) {
+      return nullptr;
+    }
+    const uint64_t nparts = *reinterpret_cast<const uint64_t*>(src);
+    src += sizeof(nparts);
 
-    if (src + prog_size > end) {
+    if (nparts == 0) {
       return nullptr;
     }
-    hProg->Prog = Program::unmarshall(src, prog_size);
+
+    for (uint64_t i = 0; i < nparts; ++i) {
+      if (src + sizeof(uint64_t) > end) {
+        return nullptr;
+      }
+      const uint64_t nlabels = *reinterpret_cast<const uint64_t*>(src);
+      src += sizeof(nlabels);
+
+      if (nlabels > static_cast<uint64_t>(end - src) / sizeof(uint32_t)) {
+        return nullptr;
+      }
+      const uint32_t* labels = reinterpret_cast<const uint32_t*>(src);
+      for (uint64_t j = 0; j < nlabels; ++j) {
+        if (labels[j] >= hProg->PMap->count()) {
+          return nullptr;
+        }
+      }
+      hProg->PartLabels.emplace_back(labels, labels + nlabels);
+      src += nlabels * sizeof(uint32_t);
+
+      ProgramPtr part = read_part(src, end);
+      if (!part) {
+        return nullptr;
+      }
+      hProg->Parts.push_back(part);
+    }
 
     return hProg.release();
   }
@@ -448,12 +782,29 @@ void lg_destroy_program(LG_HPROGRAM hProg) {
 }
 
 namespace {
-  LG_HCONTEXT create_context(LG_HPROGRAM hProg,
+  std::shared_ptr<VmInterface> create_vm(const ProgramHandle& hProg, ProgramPtr prog, const ContextHandle& hCtx) {
+    std::shared_ptr<VmInterface> vm;
+    if (prog) {
+      vm = VmInterface::create(prog);
+    }
+    else {
+      vm.reset(new PartitionedVm(hProg.Parts, hProg.PartLabels));
+    }
+
+    if (hProg.PMap->hasDuplicates()) {
+      vm.reset(new FanOutVm(vm, *hProg.PMap));
+    }
 #ifdef LBT_TRACE_ENABLED
-                             uint64_t beginTrace, uint64_t endTrace
-#else
-                             uint64_t, uint64_t
+    vm->setDebugRange(hCtx.TraceBegin, hCtx.TraceEnd);
 #endif
+    vm->setDedupThreads(hCtx.DedupThreads);
+    vm->setMaxThreads(hCtx.MaxThreads);
+    return vm;
+  }
+
+  LG_HCONTEXT create_context(LG_HPROGRAM hProg,
+                             uint64_t beginTrace, uint64_t endTrace,
+                             bool dedupThreads, uint32_t maxThreads
     )
   {
     std::unique_ptr<ContextHandle,void(*)(ContextHandle*)> hCtx(
@@ -461,13 +812,63 @@ namespace {
       lg_destroy_context
     );
 
-    hCtx->Impl = VmInterface::create(hProg->Prog);
-#ifdef LBT_TRACE_ENABLED
-    hCtx->Impl->setDebugRange(beginTrace, endTrace);
-#endif
+    hCtx->TraceBegin = beginTrace;
+    hCtx->TraceEnd = endTrace;
+    hCtx->DedupThreads = dedupThreads;
+    hCtx->MaxThreads = maxThreads;
+
+    hCtx->Impl = create_vm(*hProg, hProg->Prog, *hCtx);
+
+    if (hProg->Diff) {
+      hCtx->Diff = create_vm(*hProg, hProg->Diff, *hCtx);
+      hCtx->XorFirst = hProg->XorFirst;
+      hCtx->XorMaxLen = hProg->XorMaxLen;
+    }
 
     return hCtx.release();
   }
+
+  // Put the program from lg_swap_program() to work, if there is one. The
+  // new program searches from offset, and the old one only finishes the
+  // matches it has begun, unless handoff is false.
+  void change_over(LG_HCONTEXT hCtx, uint64_t offset, bool handoff = true) {
+    if (hCtx->Handoff && hCtx->Handoff->done()) {
+      hCtx->Impl = hCtx->Handoff->to();
+      hCtx->Handoff.reset();
+    }
+
+    if (!hCtx->HasPending.load(std::memory_order_acquire)) {
+      return;
+    }
+
+    std::shared_ptr<VmInterface> next;
+    {
+      std::lock_guard<std::mutex> lock(hCtx->SwapLock);
+      next.swap(hCtx->Pending);
+      hCtx->HasPending.store(false, std::memory_order_relaxed);
+    }
+
+    if (handoff) {
+      hCtx->Handoff.reset(new HandoffVm(hCtx->Impl, next, offset));
+      hCtx->Impl = hCtx->Handoff;
+    }
+    else {
+      hCtx->Impl = next;
+      hCtx->Handoff.reset();
+    }
+  }
+
+  void swap_program(LG_HCONTEXT hCtx, LG_HPROGRAM hProg) {
+    if (hCtx->Diff || hProg->Diff) {
+      throw std::runtime_error("lg_swap_program() cannot swap programs made by lg_create_xor_program()");
+    }
+
+    std::shared_ptr<VmInterface> next = create_vm(*hProg, hProg->Prog, *hCtx);
+
+    std::lock_guard<std::mutex> lock(hCtx->SwapLock);
+    hCtx->Pending = next;
+    hCtx->HasPending.store(true, std::memory_order_release);
+  }
 }
 
 LG_HCONTEXT lg_create_context(LG_HPROGRAM hProg,
@@ -477,8 +878,13 @@ LG_HCONTEXT lg_create_context(LG_HPROGRAM hProg,
     begin = options ? options->TraceBegin : std::numeric_limits<uint64_t>::max(),
     end = options ? options->TraceEnd : std::numeric_limits<uint64_t>::max();
 
+  const bool dedup = options && options->DedupThreads;
+  const uint32_t maxThreads = options ? options->MaxThreads : 0;
+
   return trapWithRetval(
-    [hProg,begin,end](){ return create_context(hProg, begin, end); },
+    [hProg,begin,end,dedup,maxThreads](){
+      return create_context(hProg, begin, end, dedup, maxThreads);
+    },
     nullptr
   );
 }
@@ -488,7 +894,18 @@ void lg_destroy_context(LG_HCONTEXT hCtx) {
 }
 
 void lg_reset_context(LG_HCONTEXT hCtx) {
-  exceptionTrap(std::bind(&VmInterface::reset, hCtx->Impl));
+  exceptionTrap([hCtx]() {
+    change_over(hCtx, 0, false);
+    hCtx->Impl->reset();
+  });
+}
+
+int lg_swap_program(LG_HCONTEXT hCtx, LG_HPROGRAM hProg, LG_Error** err) {
+  return trapWithVals([hCtx, hProg]() { swap_program(hCtx, hProg); }, 1, 0, err);
+}
+
+uint64_t lg_context_dropped_threads(const LG_HCONTEXT hCtx) {
+  return hCtx ? hCtx->Impl->droppedThreads() : 0;
 }
 
 void lg_starts_with(LG_HCONTEXT hCtx,
@@ -498,7 +915,25 @@ void lg_starts_with(LG_HCONTEXT hCtx,
                    void* userData,
                    LG_HITCALLBACK_FN callbackFn)
 {
-  exceptionTrap(std::bind(&VmInterface::startsWith, hCtx->Impl, (const byte*) bufStart, (const byte*) bufEnd, startOffset, callbackFn, userData));
+  exceptionTrap([=]() {
+    change_over(hCtx, startOffset);
+    hCtx->Impl->startsWith((const byte*) bufStart, (const byte*) bufEnd, startOffset, callbackFn, userData);
+  });
+}
+
+void lg_starts_with_batch(LG_HCONTEXT hCtx,
+                          const char* bufStart,
+                          const char* bufEnd,
+                          uint64_t startOffset,
+                          const uint64_t* offsets,
+                          size_t num,
+                          void* userData,
+                          LG_HITCALLBACK_FN callbackFn)
+{
+  exceptionTrap([=]() {
+    change_over(hCtx, startOffset);
+    hCtx->Impl->startsWithMany((const byte*) bufStart, (const byte*) bufEnd, startOffset, offsets, num, callbackFn, userData);
+  });
 }
 
 uint64_t lg_search(LG_HCONTEXT hCtx,
@@ -508,7 +943,28 @@ uint64_t lg_search(LG_HCONTEXT hCtx,
                        void* userData,
                        LG_HITCALLBACK_FN callbackFn)
 {
-  return trapWithRetval(std::bind(&VmInterface::search, hCtx->Impl, (const byte*) bufStart, (const byte*) bufEnd, startOffset, callbackFn, userData), std::numeric_limits<uint64_t>::max());
+  return trapWithRetval(
+    [=]() {
+      change_over(hCtx, startOffset);
+      return hCtx->Impl->search((const byte*) bufStart, (const byte*) bufEnd, startOffset, callbackFn, userData);
+    },
+    std::numeric_limits<uint64_t>::max()
+  );
+}
+
+uint64_t lg_search_zeros(LG_HCONTEXT hCtx,
+                         const uint64_t count,
+                         const uint64_t startOffset,
+                         void* userData,
+                         LG_HITCALLBACK_FN callbackFn)
+{
+  return trapWithRetval(
+    [=]() {
+      change_over(hCtx, startOffset);
+      return hCtx->Impl->searchZeros(count, startOffset, callbackFn, userData);
+    },
+    std::numeric_limits<uint64_t>::max()
+  );
 }
 
 void lg_closeout_search(LG_HCONTEXT hCtx,
@@ -525,5 +981,188 @@ uint64_t lg_search_resolve(LG_HCONTEXT hCtx,
                        void* userData,
                        LG_HITCALLBACK_FN callbackFn)
 {
-  return trapWithRetval(std::bind(&VmInterface::searchResolve, hCtx->Impl, (const byte*) bufStart, (const byte*) bufEnd, startOffset, callbackFn, userData), std::numeric_limits<uint64_t>::max());
+  return trapWithRetval(
+    [=]() {
+      change_over(hCtx, startOffset);
+      return hCtx->Impl->searchResolve((const byte*) bufStart, (const byte*) bufEnd, startOffset, callbackFn, userData);
+    },
+    std::numeric_limits<uint64_t>::max()
+  );
+}
+
+int lg_search_hits(LG_HCONTEXT hCtx,
+                   const char* bufStart,
+                   const char* bufEnd,
+                   uint64_t startOffset,
+                   LG_SearchHit** hits,
+                   size_t* numHits,
+                   LG_Error** err)
+{
+  return trapWithVals(
+    [=]() {
+      std::vector<LG_SearchHit> found;
+      const auto collect = [](void* userData, const LG_SearchHit* const hit) {
+        static_cast<std::vector<LG_SearchHit>*>(userData)->push_back(*hit);
+      };
+
+      change_over(hCtx, startOffset);
+      hCtx->Impl->search((const byte*) bufStart, (const byte*) bufEnd, startOffset, collect, &found);
+      hCtx->Impl->closeOut(collect, &found);
+      hCtx->Impl->reset();
+
+      *hits = static_cast<LG_SearchHit*>(lgAllocSized(found.size() * sizeof(LG_SearchHit)));
+      std::copy(found.begin(), found.end(), *hits);
+      *numHits = found.size();
+    },
+    1, 0, err
+  );
+}
+
+void lg_free_hits(LG_SearchHit* hits) {
+  lgFreeSized(hits);
+}
+
+namespace {
+  struct XorVerify {
+    uint32_t Label;
+    byte Key;
+    // the end of the last hit for each pattern under this key
+    std::map<uint32_t,uint64_t>* Ends;
+    std::vector<LG_XorSearchHit>* Found;
+  };
+
+  void search_xor(LG_HCONTEXT hCtx, const byte* beg, const byte* end, uint64_t startOffset, void* userData, LG_XOR_HITCALLBACK_FN callbackFn) {
+    if (!hCtx->Diff) {
+      throw std::runtime_error("lg_search_xor() needs a program made by lg_create_xor_program()");
+    }
+
+    const size_t len = end - beg;
+    if (len < 2) {
+      return;
+    }
+
+    // the XOR of each byte with the next; the difference at offset i
+    // stands for the bytes at i and i + 1
+    std::vector<byte> diffs(len - 1);
+    for (size_t i = 0; i < diffs.size(); ++i) {
+      diffs[i] = beg[i] ^ beg[i + 1];
+    }
+
+    std::vector<LG_SearchHit> cands;
+    const auto collect = [](void* userData, const LG_SearchHit* const hit) {
+      static_cast<std::vector<LG_SearchHit>*>(userData)->push_back(*hit);
+    };
+
+    VmInterface& diff = *hCtx->Diff;
+    diff.search(diffs.data(), diffs.data() + diffs.size(), startOffset, collect, &cands);
+    diff.closeOut(collect, &cands);
+    diff.reset();
+
+    // The search reports no match overlapping an earlier one for the same
+    // pattern, but matches under different keys may overlap, as may ones
+    // which the differences admit but no key bears out. So look for more
+    // within each match found, until no more turn up. Each offset is looked
+    // at once, and its threads die within the longest match, so this is
+    // bounded by the input's length times that.
+    std::vector<bool> looked(diffs.size(), false);
+    std::vector<uint64_t> offsets;
+    for (size_t from = 0; from < cands.size(); ) {
+      offsets.clear();
+      for (size_t i = from; i < cands.size(); ++i) {
+        for (uint64_t o = cands[i].Start - startOffset + 1; o < cands[i].End - startOffset; ++o) {
+          if (!looked[o]) {
+            looked[o] = true;
+            offsets.push_back(o);
+          }
+        }
+      }
+      from = cands.size();
+
+      std::sort(offsets.begin(), offsets.end());
+      diff.startsWithMany(diffs.data(), diffs.data() + diffs.size(), startOffset, offsets.data(), offsets.size(), collect, &cands);
+    }
+
+    std::sort(cands.begin(), cands.end(),
+      [](const LG_SearchHit& a, const LG_SearchHit& b) {
+        return a.Start < b.Start ||
+          (a.Start == b.Start && (a.KeywordIndex < b.KeywordIndex ||
+            (a.KeywordIndex == b.KeywordIndex && a.End > b.End)));
+      }
+    );
+
+    // the differences leave only the key to find; each byte which can
+    // begin a match gives the key which would make it the first byte here
+    std::vector<std::vector<const LG_SearchHit*>> byKey(256);
+    for (auto c = cands.begin(); c != cands.end(); ++c) {
+      if (c != cands.begin() && c->Start == (c-1)->Start && c->KeywordIndex == (c-1)->KeywordIndex) {
+        continue;
+      }
+
+      const byte first = beg[c->Start - startOffset];
+      for (uint32_t p = 0; p < 256; ++p) {
+        if (hCtx->XorFirst[p]) {
+          byKey[first ^ p].push_back(&*c);
+        }
+      }
+    }
+
+    // as searching the input under each key would, report no hit which
+    // overlaps an earlier one for the same pattern and key; one-byte hits
+    // may turn up where longer ones were sought, but are not reported
+    const auto verified = [](void* userData, const LG_SearchHit* const hit) {
+      const XorVerify* v = static_cast<const XorVerify*>(userData);
+      if (hit->KeywordIndex == v->Label && hit->End - hit->Start > 1) {
+        uint64_t& last = (*v->Ends)[v->Label];
+        if (hit->Start >= last) {
+          last = hit->End;
+          v->Found->push_back(LG_XorSearchHit{*hit, v->Key});
+        }
+      }
+    };
+
+    // The plain program checks each candidate in the text decoded with its
+    // key. A match may run past the end of its candidate, which the
+    // differences can stand for with a shorter match, but not past the
+    // longest match from its start, so only that much is decoded.
+    std::vector<LG_XorSearchHit> found;
+    std::vector<byte> plain(std::min<size_t>(len, hCtx->XorMaxLen));
+    std::map<uint32_t,uint64_t> ends;
+    for (uint32_t key = 0; key < 256; ++key) {
+      if (byKey[key].empty()) {
+        continue;
+      }
+      ends.clear();
+
+      for (const LG_SearchHit* c: byKey[key]) {
+        const size_t off = c->Start - startOffset,
+                     wlen = std::min(len - off, plain.size());
+        for (size_t i = 0; i < wlen; ++i) {
+          plain[i] = beg[off + i] ^ key;
+        }
+
+        XorVerify v{c->KeywordIndex, static_cast<byte>(key), &ends, &found};
+        hCtx->Impl->startsWith(plain.data(), plain.data() + wlen, c->Start, verified, &v);
+      }
+    }
+
+    std::stable_sort(found.begin(), found.end(),
+      [](const LG_XorSearchHit& a, const LG_XorSearchHit& b) {
+        return a.Hit.Start < b.Hit.Start;
+      }
+    );
+
+    for (const LG_XorSearchHit& h: found) {
+      callbackFn(userData, &h);
+    }
+  }
+}
+
+void lg_search_xor(LG_HCONTEXT hCtx,
+                   const char* bufStart,
+                   const char* bufEnd,
+                   uint64_t startOffset,
+                   void* userData,
+                   LG_XOR_HITCALLBACK_FN callbackFn)
+{
+  exceptionTrap(std::bind(search_xor, hCtx, (const byte*) bufStart, (const byte*) bufEnd, startOffset, userData, callbackFn));
 }
@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <cctype>
 #include <limits>
+#include <map>
 #include <memory>
 #include <string>
 #include <tuple>
@@ -106,6 +107,122 @@ void lg_destroy_decoder(LG_HDECODER hDec) {
 }
 
 namespace {
+  typedef std::pair<int32_t,const byte*> Value;
+
+  // Working space for decoding, kept across hits
+  struct DecodeScratch {
+    // what decoding from a position up to the hit yields: the number of
+    // values, how many are bad, and how many good ones end it
+    struct Tail {
+      size_t N, Bad, AdjGood;
+    };
+
+    std::vector<Tail> Tails;
+    std::vector<bool> Known;
+    std::vector<Value> Vals, Lctx;
+
+    // one decoder per encoding, taken from the factory on first use
+    std::map<std::string,std::shared_ptr<Decoder>> Decoders;
+  };
+
+  // Pad lctx, decoded from l, on the left with undecoded "bad" bytes up to
+  // the leading length, all at once, as inserting them one by one at the
+  // front is quadratic; returns the number of bytes padded
+  size_t padLeading(std::vector<Value>& lctx, const byte* bbeg, const byte* l, size_t leading) {
+    const size_t pad = std::min(
+      leading - std::min(leading, lctx.size()), size_t(l - bbeg)
+    );
+    lctx.insert(lctx.begin(), pad, Value());
+    for (size_t i = 0; i < pad; ++i) {
+      const byte* b = l - pad + i;
+      lctx[i] = {-((int32_t) *b)-1, b};
+    }
+    return pad;
+  }
+
+  //
+  // Leading sequences are lexicographically ordered by the length of their
+  // hit-adjacent good sequence and their number of bad values; pick the
+  // best, preferring the longest of equals. Returns the start of the best,
+  // or null if there are no candidates.
+  //
+  // A stateless decoder decodes the same from a position however it got
+  // there, so the decodings from successive starts share everything after
+  // the first position they have in common. For self-synchronizing
+  // encodings, that comes within a character, so each start costs only
+  // the few values before it merges with a start already decoded, rather
+  // than decoding all the way to the hit again.
+  //
+  const byte* bestLeadingStatelessly(
+    const byte* bbeg,
+    const byte* hbeg,
+    const byte* lmin,
+    size_t leading,
+    Decoder& dec,
+    DecodeScratch& scratch,
+    unsigned int& max_inv_bad)
+  {
+    typedef DecodeScratch::Tail Tail;
+
+    const size_t span = hbeg - lmin;
+    scratch.Known.assign(span + 1, false);
+    scratch.Tails.resize(span + 1);
+    scratch.Known[span] = true;
+    scratch.Tails[span] = Tail{0, 0, 0};
+
+    const byte* best = nullptr;
+    size_t max_adj_good = 0;
+    max_inv_bad = 0;
+
+    for (size_t off = span; off-- > 0; ) {
+      const byte* const l = lmin + off;
+
+      // decode until reaching a position decoded from before
+      dec.reset(l, hbeg);
+      scratch.Vals.clear();
+
+      Tail t{0, 0, 0};
+      for (Value cp; (cp = dec.next()).first != LG_WINDOW_END; ) {
+        const size_t p = cp.second - lmin;
+        if (scratch.Known[p]) {
+          t = scratch.Tails[p];
+          break;
+        }
+        scratch.Vals.push_back(cp);
+      }
+
+      // note what decoding from each new position yields
+      for (auto i = scratch.Vals.crbegin(); i != scratch.Vals.crend(); ++i) {
+        const bool good = i->first >= 0;
+        t = Tail{
+          t.N + 1,
+          t.Bad + !good,
+          good && t.AdjGood == t.N ? t.N + 1 : t.AdjGood
+        };
+
+        const size_t p = i->second - lmin;
+        scratch.Known[p] = true;
+        scratch.Tails[p] = t;
+      }
+
+      // padding is all bad, so does not lengthen the good sequence
+      const size_t pad = std::min(
+        leading - std::min(leading, t.N), size_t(l - bbeg)
+      );
+
+      const size_t adj_good = t.AdjGood;
+      const unsigned int inv_bad = std::numeric_limits<unsigned int>::max() - (t.Bad + pad);
+
+      if (std::tie(adj_good, inv_bad) >= std::tie(max_adj_good, max_inv_bad)) {
+        max_adj_good = adj_good;
+        max_inv_bad = inv_bad;
+        best = l;
+      }
+    }
+
+    return best;
+  }
+
   unsigned int decode(
     const byte* bbeg,
     const byte* bend,
@@ -115,63 +232,85 @@ namespace {
     size_t trailing,
     Decoder& dec,
     LG_Window& dh,
-    std::vector<std::pair<int32_t,const byte*>>& cps)
+    std::vector<Value>& cps,
+    DecodeScratch& scratch)
   {
     // precondition:
     //    bbeg <= hbeg <= hend <= bend
 
     unsigned int bad = 0;
-    std::pair<int32_t,const byte*> cp;
+    Value cp;
 
     //
     // leading context
     //
     unsigned int max_adj_good = 0, max_inv_bad = 0;
-    std::vector<std::pair<int32_t,const byte*>> lctx;
-
-    // Decode leading sequences of increasing length until we hit the
-    // beginning of the buffer or decode more values than we need for
-    // leading context.
-    for (const byte* l = hbeg-1; l >= bbeg && hbeg - l <= ssize_t(leading * dec.maxByteLength()); --l) {
-      dec.reset(l, hbeg);
-      lctx.clear();
-      bad = 0;
-
-      // read the leading context
-      while ((cp = dec.next()).first != LG_WINDOW_END) {
-        lctx.push_back(cp);
-        if (cp.first < 0) {
-          ++bad;
-        }
-      }
+    std::vector<Value>& lctx = scratch.Lctx;
 
-      // pad left with undecoded "bad" bytes
-      for (const byte* b = l - 1; lctx.size() < leading && b >= bbeg; --b) {
-        lctx.emplace(lctx.begin(), -((int32_t) *b)-1, b);
-        ++bad;
-      }
+    // candidate starts run back from the hit as far as leading values
+    // could reach, but not past the buffer
+    const byte* const lmin = hbeg - std::min(
+      size_t(hbeg - bbeg), leading * dec.maxByteLength()
+    );
 
-      // find the start of the good sequence adjacent to the hit
-      auto i = std::find_if(
-        lctx.crbegin(), lctx.crend(),
-        [](const std::pair<int32_t,const byte*>& p) { return p.first < 0; }
+    if (dec.stateless()) {
+      const byte* const l = bestLeadingStatelessly(
+        bbeg, hbeg, lmin, leading, dec, scratch, max_inv_bad
       );
 
-      unsigned int adj_good = i - lctx.crbegin();
-      unsigned int inv_bad = std::numeric_limits<unsigned int>::max() - bad;
+      if (l) {
+        dec.reset(l, hbeg);
+        lctx.clear();
+        while ((cp = dec.next()).first != LG_WINDOW_END) {
+          lctx.push_back(cp);
+        }
+        padLeading(lctx, bbeg, l, leading);
 
-      // leading sequences are lexicographically ordered by the length of
-      // their hit-adjacent good sequence and their number of bad values
-      if (std::tie(adj_good, inv_bad) >= std::tie(max_adj_good, max_inv_bad)) {
-        // this leading context is not worse than the previous best, keep it
-        max_adj_good = adj_good;
-        max_inv_bad = inv_bad;
         cps.assign(
           lctx.size() > leading ? lctx.end() - leading : lctx.begin(),
           lctx.end()
         );
       }
     }
+    else {
+      // Decode leading sequences of increasing length until we hit the
+      // beginning of the buffer or decode more values than we need for
+      // leading context.
+      for (const byte* l = hbeg; l-- > lmin; ) {
+        dec.reset(l, hbeg);
+        lctx.clear();
+        bad = 0;
+
+        // read the leading context
+        while ((cp = dec.next()).first != LG_WINDOW_END) {
+          lctx.push_back(cp);
+          if (cp.first < 0) {
+            ++bad;
+          }
+        }
+
+        bad += padLeading(lctx, bbeg, l, leading);
+
+        // find the start of the good sequence adjacent to the hit
+        auto i = std::find_if(
+          lctx.crbegin(), lctx.crend(),
+          [](const Value& p) { return p.first < 0; }
+        );
+
+        unsigned int adj_good = i - lctx.crbegin();
+        unsigned int inv_bad = std::numeric_limits<unsigned int>::max() - bad;
+
+        if (std::tie(adj_good, inv_bad) >= std::tie(max_adj_good, max_inv_bad)) {
+          // this leading context is not worse than the previous best, keep it
+          max_adj_good = adj_good;
+          max_inv_bad = inv_bad;
+          cps.assign(
+            lctx.size() > leading ? lctx.end() - leading : lctx.begin(),
+            lctx.end()
+          );
+        }
+      }
+    }
 
     bad = std::numeric_limits<unsigned int>::max() - max_inv_bad;
 
@@ -229,9 +368,13 @@ namespace {
     int32_t** characters,
     size_t** offsets,
     size_t* clen,
-    LG_Window* decodedHit)
+    LG_Window* decodedHit,
+    DecodeScratch& scratch)
   {
-    std::shared_ptr<Decoder> dec(dfac.get(encoding));
+    std::shared_ptr<Decoder>& dec = scratch.Decoders[encoding];
+    if (!dec) {
+      dec = dfac.get(encoding);
+    }
 
     const byte* bbeg = reinterpret_cast<const byte*>(bufStart);
     const byte* bend = reinterpret_cast<const byte*>(bufEnd);
@@ -241,11 +384,11 @@ namespace {
     const byte* hend =
       reinterpret_cast<const byte*>(bufStart) + (inner->end - dataOffset);
 
-    std::vector<std::pair<int32_t,const byte*>> cps;
+    std::vector<Value> cps;
 
     unsigned int bad = decode(
       bbeg, bend, hbeg, hend, preContext, postContext,
-      *dec, *decodedHit, cps
+      *dec, *decodedHit, cps, scratch
     );
 
     *clen = cps.size();
@@ -254,7 +397,7 @@ namespace {
 
     // unzip the result
     size_t i = 0;
-    for (const std::pair<int32_t,const byte*>& p : cps) {
+    for (const Value& p : cps) {
       (*characters)[i] = p.first;
       (*offsets)[i] = p.second - bbeg;
       ++i;
@@ -282,7 +425,8 @@ namespace {
                           uint32_t repl,
                           const char** utf8,
                           LG_Window* outer,
-                          LG_Window* decodedHit)
+                          LG_Window* decodedHit,
+                          DecodeScratch& scratch)
   {
     // decode the hit and its context using the deluxe decoder
     int32_t* cps = nullptr;
@@ -294,7 +438,7 @@ namespace {
     const unsigned int bad = readWindow(
       dfac, bufStart, bufEnd, dataOffset, inner,
       encoding, windowSize, windowSize,
-      &cps, &offsets, &clen, &dhcprange
+      &cps, &offsets, &clen, &dhcprange, scratch
     );
 
     std::unique_ptr<int32_t[],void(*)(int32_t*)> pchars(
@@ -351,10 +495,12 @@ unsigned int lg_read_window(
 {
   return trapWithRetval(
     [=](){
+      DecodeScratch scratch;
       return readWindow(
         hDec->Factory,
         bufStart, bufEnd, dataOffset, inner, encoding,
-        preContext, postContext, characters, offsets, clen, decodedHit
+        preContext, postContext, characters, offsets, clen, decodedHit,
+        scratch
       );
     },
     0,
@@ -378,10 +524,11 @@ unsigned int lg_hit_context(
 {
   return trapWithRetval(
     [=]() {
+      DecodeScratch scratch;
       return hitContext(
         hDec->Factory,
         bufStart, bufEnd, dataOffset, inner, encoding,
-        windowSize, replacement, utf8, outer, decodedHit
+        windowSize, replacement, utf8, outer, decodedHit, scratch
       );
     },
     0,
@@ -389,6 +536,47 @@ unsigned int lg_hit_context(
   );
 }
 
+size_t lg_hit_contexts(
+  LG_HDECODER hDec,
+  const char* bufStart,
+  const char* bufEnd,
+  uint64_t dataOffset,
+  const LG_Window* inners,
+  const char* const* encodings,
+  size_t num,
+  size_t windowSize,
+  uint32_t replacement,
+  const char** utf8,
+  LG_Window* outers,
+  LG_Window* decodedHits,
+  unsigned int* bad,
+  LG_Error** err)
+{
+  size_t done = 0;
+  trapWithRetval(
+    [&]() {
+      // the decoders and the working space are shared by all the hits
+      DecodeScratch scratch;
+      for ( ; done < num; ++done) {
+        const unsigned int b = hitContext(
+          hDec->Factory,
+          bufStart, bufEnd, dataOffset, inners + done, encodings[done],
+          windowSize, replacement, utf8 + done, outers + done,
+          decodedHits + done, scratch
+        );
+
+        if (bad) {
+          bad[done] = b;
+        }
+      }
+      return done;
+    },
+    done,
+    err
+  );
+  return done;
+}
+
 void lg_free_window_characters(int32_t* characters) {
   delete[] characters;
 }
@@ -194,6 +194,9 @@ void NFABuilder::charClass(const ParseNode& n) {
     (*Fsm)[v].Trans = Fsm->TransFac->getSmallest(n.Set.Breakout.Bytes);
     TempFrag.initFull(v, n);
   }
+  else if (Enc->name() == "UTF-8") {
+    utf8Class(n, uset);
+  }
   else {
     // convert the code point set into collapsed encoding ranges
     TempEncRanges.clear();
@@ -299,6 +302,66 @@ void NFABuilder::charClass(const ParseNode& n) {
   Stack.push(TempFrag);
 }
 
+void NFABuilder::utf8Class(const ParseNode& n, const UnicodeSet& uset) {
+  auto i = UTF8Classes.find(uset);
+  if (i == UTF8Classes.end()) {
+    i = UTF8Classes.emplace(uset, UTF8Automaton(uset)).first;
+  }
+  const UTF8Automaton& a = i->second;
+
+  // breakout bytes change only the one-byte encodings
+  const ByteSet& breakout = n.Set.Breakout.Bytes;
+  const bool extra = breakout.any() && n.Set.Breakout.Additive &&
+                     a.Single == UTF8Automaton::NONE;
+
+  std::vector<NFA::VertexDescriptor> vs(a.Vertices.size(), 0);
+  TempFrag.reset(n);
+
+  for (uint32_t v = 0; v < a.Vertices.size(); ++v) {
+    ByteSet bs = a.Vertices[v].Bytes;
+    if (v == a.Single && breakout.any()) {
+      if (n.Set.Breakout.Additive) {
+        bs |= breakout;
+      }
+      else {
+        bs &= ~breakout;
+        if (bs.none()) {
+          continue;
+        }
+      }
+    }
+
+    vs[v] = Fsm->addVertex();
+    (*Fsm)[vs[v]].Trans = Fsm->TransFac->getSmallest(bs);
+    for (const uint32_t w : a.Vertices[v].Next) {
+      Fsm->addEdge(vs[v], vs[w]);
+    }
+
+    if (a.Vertices[v].Final) {
+      TempFrag.OutList.emplace_back(vs[v], 0);
+    }
+  }
+
+  for (const uint32_t h : a.Heads) {
+    if (vs[h]) {
+      TempFrag.InList.push_back(vs[h]);
+    }
+  }
+
+  if (extra) {
+    const NFA::VertexDescriptor v = Fsm->addVertex();
+    (*Fsm)[v].Trans = Fsm->TransFac->getSmallest(breakout);
+    TempFrag.InList.push_back(v);
+    TempFrag.OutList.emplace_back(v, 0);
+  }
+
+  if (TempFrag.InList.empty()) {
+    THROW_RUNTIME_ERROR_WITH_CLEAN_OUTPUT(
+      "intersection of character class with " << Enc->name() << " is empty"
+    );
+  }
+}
+
 void NFABuilder::question(const ParseNode&) {
   Fragment& optional = Stack.top();
   if (optional.Skippable > optional.InList.size()) {
@@ -103,3 +103,64 @@ std::ostream& operator<<(std::ostream& out, const ParseTree& tree) {
   }
   return out;
 }
+
+namespace {
+  void appendKey(std::string& key, uint32_t v) {
+    key.append(reinterpret_cast<const char*>(&v), sizeof(v));
+  }
+
+  void appendKey(std::string& key, const ParseNode* n) {
+    if (!n) {
+      appendKey(key, ParseNode::TEMPORARY + 1);
+      return;
+    }
+
+    appendKey(key, n->Type);
+
+    switch (n->Type) {
+    case ParseNode::REGEXP:
+    case ParseNode::LOOKBEHIND_POS:
+    case ParseNode::LOOKBEHIND_NEG:
+    case ParseNode::LOOKAHEAD_POS:
+    case ParseNode::LOOKAHEAD_NEG:
+      appendKey(key, n->Child.Left);
+      break;
+    case ParseNode::ALTERNATION:
+    case ParseNode::CONCATENATION:
+      appendKey(key, n->Child.Left);
+      appendKey(key, n->Child.Right);
+      break;
+    case ParseNode::REPETITION:
+    case ParseNode::REPETITION_NG:
+      appendKey(key, n->Child.Rep.Min);
+      appendKey(key, n->Child.Rep.Max);
+      appendKey(key, n->Child.Left);
+      break;
+    case ParseNode::CHAR_CLASS:
+      // no range ends past the last code point, so UNBOUNDED ends the list
+      for (const auto& r: n->Set.CodePoints) {
+        appendKey(key, r.first);
+        appendKey(key, r.second);
+      }
+      appendKey(key, UNBOUNDED);
+      for (uint32_t b = 0; b < 256; b += 32) {
+        uint32_t word = 0;
+        for (uint32_t i = 0; i < 32; ++i) {
+          word |= uint32_t(n->Set.Breakout.Bytes[b + i]) << i;
+        }
+        appendKey(key, word);
+      }
+      appendKey(key, n->Set.Breakout.Additive);
+      break;
+    default:
+      appendKey(key, n->Val);
+      break;
+    }
+  }
+}
+
+std::string treeKey(const ParseTree& tree) {
+  std::string key;
+  appendKey(key, tree.Root);
+  return key;
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "partitioned_vm.h"
+
+#include <algorithm>
+#include <exception>
+#include <limits>
+
+PartitionedVm::PartitionedVm(const std::vector<ProgramPtr>& progs, const std::vector<std::vector<uint32_t>>& labels):
+  Parts(progs.size()),
+  Round(0),
+  Pending(0),
+  Quit(false)
+{
+  for (size_t i = 0; i < progs.size(); ++i) {
+    Parts[i].Vm = VmInterface::create(progs[i]);
+    Parts[i].Labels = labels[i];
+  }
+
+  // the calling thread takes the first part
+  Workers.reserve(Parts.size() - 1);
+  try {
+    for (size_t i = 1; i < Parts.size(); ++i) {
+      Workers.emplace_back(&PartitionedVm::worker, this, i);
+    }
+  }
+  catch (...) {
+    // destroying a joinable thread terminates, so the workers which did
+    // start must be stopped before the exception leaves
+    stop();
+    throw;
+  }
+}
+
+PartitionedVm::~PartitionedVm() {
+  stop();
+}
+
+void PartitionedVm::stop() {
+  {
+    std::lock_guard<std::mutex> lock(M);
+    Quit = true;
+  }
+  Wake.notify_all();
+
+  for (std::thread& w : Workers) {
+    w.join();
+  }
+}
+
+void PartitionedVm::worker(size_t i) {
+  uint64_t seen = 0;
+  std::unique_lock<std::mutex> lock(M);
+  while (true) {
+    Wake.wait(lock, [this, seen]() { return Quit || Round != seen; });
+    if (Quit) {
+      return;
+    }
+    seen = Round;
+
+    lock.unlock();
+    Job(i);
+    lock.lock();
+
+    if (--Pending == 0) {
+      Finished.notify_one();
+    }
+  }
+}
+
+void PartitionedVm::collectHit(void* userData, const LG_SearchHit* const hit) {
+  Part* part = static_cast<Part*>(userData);
+  part->Hits.emplace_back(
+    hit->Start, hit->End, part->Labels[hit->KeywordIndex]
+  );
+}
+
+template <class F>
+void PartitionedVm::run(F fn, HitCallback hitFn, void* userData) {
+  // don't bother collecting hits which no one will see
+  const HitCallback collect = hitFn ? &PartitionedVm::collectHit : nullptr;
+
+  std::vector<std::exception_ptr> errors(Parts.size());
+
+  const auto runPart = [&](size_t i) {
+    try {
+      fn(Parts[i], collect);
+    }
+    catch (...) {
+      errors[i] = std::current_exception();
+    }
+  };
+
+  // wake the workers for the other parts, then take the first one here
+  Job = runPart;
+  {
+    std::lock_guard<std::mutex> lock(M);
+    Pending = Workers.size();
+    ++Round;
+  }
+  Wake.notify_all();
+
+  runPart(0);
+
+  {
+    std::unique_lock<std::mutex> lock(M);
+    Finished.wait(lock, [this]() { return Pending == 0; });
+  }
+  Job = nullptr;
+
+  std::vector<SearchHit> hits;
+  for (Part& p : Parts) {
+    hits.insert(hits.end(), p.Hits.begin(), p.Hits.end());
+    p.Hits.clear();
+  }
+
+  for (const std::exception_ptr& e : errors) {
+    if (e) {
+      std::rethrow_exception(e);
+    }
+  }
+
+  std::sort(hits.begin(), hits.end());
+  for (const SearchHit& h : hits) {
+    (*hitFn)(userData, &h);
+  }
+}
+
+void PartitionedVm::startsWith(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData) {
+  run(
+    [=](Part& p, HitCallback collect) {
+      p.Vm->startsWith(beg, end, startOffset, collect, &p);
+    },
+    hitFn, userData
+  );
+}
+
+void PartitionedVm::startsWithMany(const byte* const beg, const byte* const end, const uint64_t startOffset, const uint64_t* const offsets, const size_t num, HitCallback hitFn, void* userData) {
+  run(
+    [=](Part& p, HitCallback collect) {
+      p.Vm->startsWithMany(beg, end, startOffset, offsets, num, collect, &p);
+    },
+    hitFn, userData
+  );
+}
+
+uint64_t PartitionedVm::search(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData) {
+  // each part is responsible for its own leftmost live thread
+  std::vector<uint64_t> lefts(Parts.size());
+  run(
+    [&](Part& p, HitCallback collect) {
+      lefts[&p - Parts.data()] = p.Vm->search(beg, end, startOffset, collect, &p);
+    },
+    hitFn, userData
+  );
+  return *std::min_element(lefts.begin(), lefts.end());
+}
+
+uint64_t PartitionedVm::searchResolve(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData) {
+  std::vector<uint64_t> lefts(Parts.size());
+  run(
+    [&](Part& p, HitCallback collect) {
+      lefts[&p - Parts.data()] = p.Vm->searchResolve(beg, end, startOffset, collect, &p);
+    },
+    hitFn, userData
+  );
+  return *std::min_element(lefts.begin(), lefts.end());
+}
+
+uint64_t PartitionedVm::searchZeros(const uint64_t count, const uint64_t startOffset, HitCallback hitFn, void* userData) {
+  std::vector<uint64_t> lefts(Parts.size());
+  run(
+    [&](Part& p, HitCallback collect) {
+      lefts[&p - Parts.data()] = p.Vm->searchZeros(count, startOffset, collect, &p);
+    },
+    hitFn, userData
+  );
+  return *std::min_element(lefts.begin(), lefts.end());
+}
+
+void PartitionedVm::closeOut(HitCallback hitFn, void* userData) {
+  run(
+    [](Part& p, HitCallback collect) {
+      p.Vm->closeOut(collect, &p);
+    },
+    hitFn, userData
+  );
+}
+
+void PartitionedVm::reset() {
+  for (Part& p : Parts) {
+    p.Vm->reset();
+    p.Hits.clear();
+  }
+}
+
+void PartitionedVm::setDedupThreads(bool dedup) {
+  for (Part& p : Parts) {
+    p.Vm->setDedupThreads(dedup);
+  }
+}
+
+void PartitionedVm::setMaxThreads(uint32_t maxThreads) {
+  // the budget is per context, so split it among the parts
+  const uint32_t share = maxThreads ?
+    std::max<uint32_t>(1, maxThreads / Parts.size()) : 0;
+  for (Part& p : Parts) {
+    p.Vm->setMaxThreads(share);
+  }
+}
+
+uint64_t PartitionedVm::droppedThreads() const {
+  uint64_t dropped = 0;
+  for (const Part& p : Parts) {
+    dropped += p.Vm->droppedThreads();
+  }
+  return dropped;
+}
+
+#ifdef LBT_TRACE_ENABLED
+void PartitionedVm::setDebugRange(uint64_t beg, uint64_t end) {
+  for (Part& p : Parts) {
+    p.Vm->setDebugRange(beg, end);
+  }
+}
+#endif
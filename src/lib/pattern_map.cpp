@@ -23,6 +23,12 @@
 #include <memory>
 #include <numeric>
 
+namespace {
+  // leads a marshalled map, so that one from another version is refused
+  const char MAGIC[4] = {'L', 'G', 'P', 'M'};
+  const uint32_t VERSION = 1;
+}
+
 void PatternMap::clearPatterns() {
   if (!Shared) {
     for (LG_PatternInfo& pi: Patterns) {
@@ -31,17 +37,20 @@ void PatternMap::clearPatterns() {
     }
   }
   Patterns.clear();
+  Originals.clear();
   Shared = false;
 }
 
 void PatternMap::copyOther(const PatternMap& other) {
   Patterns.reserve(other.Patterns.size());
-  for (const LG_PatternInfo& pi: other.Patterns) {
-    addPattern(pi.Pattern, pi.EncodingChain, pi.UserIndex);
+  Originals.reserve(other.Originals.size());
+  for (size_t i = 0; i < other.Patterns.size(); ++i) {
+    const LG_PatternInfo& pi = other.Patterns[i];
+    addPattern(pi.Pattern, pi.EncodingChain, pi.UserIndex, other.Originals[i]);
   }
 }
 
-PatternMap::PatternMap(const PatternMap& other): Patterns(), Shared(false) {
+PatternMap::PatternMap(const PatternMap& other): Patterns(), Originals(), Shared(false) {
   copyOther(other);
 }
 
@@ -51,14 +60,14 @@ PatternMap& PatternMap::operator=(const PatternMap& other) {
   return *this;
 }
 
-void PatternMap::addPattern(const char* pattern, const char* chain, uint64_t idx) {
+void PatternMap::addPattern(const char* pattern, const char* chain, uint64_t idx, uint32_t original) {
   std::unique_ptr<char[]> patcopy(new char[std::strlen(pattern)+1]);
   std::strcpy(patcopy.get(), pattern);
 
   std::unique_ptr<char[]> chcopy(new char[std::strlen(chain)+1]);
   std::strcpy(chcopy.get(), chain);
 
-  usePattern(patcopy.get(), chcopy.get(), idx);
+  usePattern(patcopy.get(), chcopy.get(), idx, original);
   patcopy.release();
   chcopy.release();
 }
@@ -67,6 +76,19 @@ size_t PatternMap::count() const {
   return Patterns.size();
 }
 
+uint32_t PatternMap::original(size_t index) const {
+  return Originals[index];
+}
+
+bool PatternMap::hasDuplicates() const {
+  for (size_t i = 0; i < Originals.size(); ++i) {
+    if (Originals[i] != i) {
+      return true;
+    }
+  }
+  return false;
+}
+
 LG_PatternInfo& PatternMap::operator[](size_t index) {
   return Patterns[index];
 }
@@ -75,7 +97,8 @@ const LG_PatternInfo& PatternMap::operator[](size_t index) const {
   return Patterns[index];
 }
 
-void PatternMap::usePattern(const char* pattern, const char* chain, uint64_t idx) {
+void PatternMap::usePattern(const char* pattern, const char* chain, uint64_t idx, uint32_t original) {
+  Originals.push_back(original == NONE ? Patterns.size() : original);
   Patterns.push_back({pattern, chain, idx});
 }
 
@@ -84,7 +107,14 @@ std::vector<char> PatternMap::marshall() const {
   char* i = buf.data();
   size_t slen;
 
-  for (const LG_PatternInfo& pi: Patterns) {
+  std::memcpy(i, MAGIC, sizeof(MAGIC));
+  i += sizeof(MAGIC);
+  std::memcpy(i, &VERSION, sizeof(VERSION));
+  i += sizeof(VERSION);
+
+  for (size_t p = 0; p < Patterns.size(); ++p) {
+    const LG_PatternInfo& pi = Patterns[p];
+
     slen = std::strlen(pi.Pattern) + 1;
     std::memcpy(i, pi.Pattern, slen);
     i += slen;
@@ -95,6 +125,9 @@ std::vector<char> PatternMap::marshall() const {
 
     std::memcpy(i, &pi.UserIndex, sizeof(pi.UserIndex));
     i += sizeof(pi.UserIndex); 
+
+    std::memcpy(i, &Originals[p], sizeof(uint32_t));
+    i += sizeof(uint32_t);
   }
 
   return buf; 
@@ -104,41 +137,76 @@ size_t PatternMap::bufSize() const {
   return std::accumulate(
     Patterns.begin(),
     Patterns.end(),
-    0,
+    sizeof(MAGIC) + sizeof(VERSION),
     [](size_t s, const LG_PatternInfo& pi) {
       return s + std::strlen(pi.Pattern) + 1
                + std::strlen(pi.EncodingChain) + 1
-               + sizeof(pi.UserIndex); 
+               + sizeof(pi.UserIndex)
+               + sizeof(uint32_t);
     }
   );
 }
 
 std::unique_ptr<PatternMap> PatternMap::unmarshall(const void* buf, size_t len) {
+  const char* i = static_cast<const char*>(buf);
+  const char* const end = i + len;
+
+  uint32_t version;
+  if (len < sizeof(MAGIC) + sizeof(version) || std::memcmp(i, MAGIC, sizeof(MAGIC))) {
+    return nullptr;
+  }
+  i += sizeof(MAGIC);
+  std::memcpy(&version, i, sizeof(version));
+  if (version != VERSION) {
+    return nullptr;
+  }
+  i += sizeof(version);
+
   std::unique_ptr<PatternMap> p(new PatternMap(0));
   p->Shared = true;
 
-  const char* i = static_cast<const char*>(buf);
-  const char* pat;
-  const char* chain;
-  const char* idx;
-  
-  const char* const end = i + len;
-  
+  // the strings point into buf, so each must end before it does
+  const auto next = [end](const char* s) -> const char* {
+    const char* nul = static_cast<const char*>(std::memchr(s, '\0', end - s));
+    return nul ? nul + 1 : nullptr;
+  };
+
+  uint64_t idx;
+  uint32_t orig;
+
   while (i < end) {
-    pat = i;
-    chain = pat + std::strlen(pat) + 1;
-    idx = chain + std::strlen(chain) + 1;
+    const char* const pat = i;
+    const char* const chain = next(pat);
+    if (!chain || chain == end) {
+      return nullptr;
+    }
+
+    i = next(chain);
+    if (!i || static_cast<size_t>(end - i) < sizeof(idx) + sizeof(orig)) {
+      return nullptr;
+    }
 
-    p->usePattern(pat, chain, *reinterpret_cast<const uint64_t*>(idx));
+    std::memcpy(&idx, i, sizeof(idx));
+    i += sizeof(idx);
+    std::memcpy(&orig, i, sizeof(orig));
+    i += sizeof(orig);
 
-    i = idx + sizeof(LG_PatternInfo::UserIndex); 
+    p->usePattern(pat, chain, idx, orig);
+  }
+
+  for (const uint32_t o: p->Originals) {
+    if (o >= p->Originals.size()) {
+      return nullptr;
+    }
   }
 
   return p;
 }
 
 bool PatternMap::operator==(const PatternMap& rhs) const {
-  return std::equal(Patterns.begin(), Patterns.end(), rhs.Patterns.begin());
+  return Patterns.size() == rhs.Patterns.size() &&
+         std::equal(Patterns.begin(), Patterns.end(), rhs.Patterns.begin()) &&
+         Originals == rhs.Originals;
 }
 
 bool operator==(const LG_PatternInfo& lhs, const LG_PatternInfo& rhs) {
@@ -17,14 +17,26 @@
 
 #include "program.h"
 
+#include <algorithm>
 #include <cstring>
 #include <iomanip>
 
+namespace {
+  // leads a marshalled program, so that one from another version is refused
+  const char MAGIC[4] = {'L', 'G', 'P', 'R'};
+  const uint32_t VERSION = 1;
+
+  // the widest encoding's code units, which the filter stride spans
+  const uint32_t MAX_STRIDE = 4;
+}
+
 bool Program::operator==(const Program& rhs) const {
   return MaxLabel == rhs.MaxLabel &&
          MaxCheck == rhs.MaxCheck &&
          FilterOff == rhs.FilterOff &&
+         FilterStride == rhs.FilterStride &&
          Filter == rhs.Filter &&
+         FilterWindows == rhs.FilterWindows &&
          std::equal(begin(), end(), rhs.begin());
 }
 
@@ -33,6 +45,11 @@ std::vector<char> Program::marshall() const {
   std::vector<char> buf(plen);
   char* i = buf.data();
 
+  std::memcpy(i, MAGIC, sizeof(MAGIC));
+  i += sizeof(MAGIC);
+  std::memcpy(i, &VERSION, sizeof(VERSION));
+  i += sizeof(VERSION);
+
   // MaxLabel
   std::memcpy(i, &MaxLabel, sizeof(MaxLabel));
   i += sizeof(MaxLabel);
@@ -45,6 +62,10 @@ std::vector<char> Program::marshall() const {
   std::memcpy(i, &FilterOff, sizeof(FilterOff));
   i += sizeof(FilterOff);
 
+  // FilterStride
+  std::memcpy(i, &FilterStride, sizeof(FilterStride));
+  i += sizeof(FilterStride);
+
   // Filter
   for (size_t b = 0; b < Filter.size(); b += 8) {
     *i = Filter[b] |
@@ -58,6 +79,22 @@ std::vector<char> Program::marshall() const {
     ++i;
   }
 
+  // FilterWindows
+  const uint32_t wcount = FilterWindows.size();
+  std::memcpy(i, &wcount, sizeof(wcount));
+  i += sizeof(wcount);
+
+  for (const FilterWindow& w : FilterWindows) {
+    const uint32_t head[] = {
+      w.Off, w.Width, w.Mult, w.Shift, static_cast<uint32_t>(w.Table.size())
+    };
+    std::memcpy(i, head, sizeof(head));
+    i += sizeof(head);
+
+    std::memcpy(i, w.Table.data(), w.Table.size()*sizeof(uint64_t));
+    i += w.Table.size()*sizeof(uint64_t);
+  }
+
   // Instructions
   std::memcpy(i, IBeg.get(), size()*sizeof(Instruction));
 
@@ -68,19 +105,40 @@ std::vector<char> Program::marshall() const {
 
 ProgramPtr Program::unmarshall(const void* buf, size_t len) {
   const char* i = static_cast<const char*>(buf);
-  const size_t icount = (len - (sizeof(Program::MaxLabel) + sizeof(Program::MaxCheck) + sizeof(Program::FilterOff) + 256*256/8)) / sizeof(Instruction);
+  const char* const end = i + len;
 
   ProgramPtr p(new Program(0));
 
-  p->MaxLabel = *reinterpret_cast<const decltype(p->MaxLabel)*>(i);
+  uint32_t version;
+  if (static_cast<size_t>(end - i) < sizeof(MAGIC) + sizeof(version) + 4*sizeof(uint32_t) + p->Filter.size()/8 ||
+      std::memcmp(i, MAGIC, sizeof(MAGIC)))
+  {
+    return ProgramPtr();
+  }
+  i += sizeof(MAGIC);
+
+  std::memcpy(&version, i, sizeof(version));
+  if (version != VERSION) {
+    return ProgramPtr();
+  }
+  i += sizeof(version);
+
+  std::memcpy(&p->MaxLabel, i, sizeof(p->MaxLabel));
   i += sizeof(p->MaxLabel);
 
-  p->MaxCheck = *reinterpret_cast<const decltype(p->MaxCheck)*>(i);
+  std::memcpy(&p->MaxCheck, i, sizeof(p->MaxCheck));
   i += sizeof(p->MaxCheck);
 
-  p->FilterOff = *reinterpret_cast<const decltype(p->FilterOff)*>(i);
+  std::memcpy(&p->FilterOff, i, sizeof(p->FilterOff));
   i += sizeof(p->FilterOff);
 
+  std::memcpy(&p->FilterStride, i, sizeof(p->FilterStride));
+  i += sizeof(p->FilterStride);
+
+  if (p->FilterStride == 0 || p->FilterStride > MAX_STRIDE) {
+    return ProgramPtr();
+  }
+
   for (size_t b = 0; b < p->Filter.size() / 8; ++b, ++i) {
     p->Filter[8*b]   = *i & 0x01;
     p->Filter[8*b+1] = *i & 0x02;
@@ -92,10 +150,59 @@ ProgramPtr Program::unmarshall(const void* buf, size_t len) {
     p->Filter[8*b+7] = *i & 0x80;
   }
 
+  uint32_t wcount;
+  if (static_cast<size_t>(end - i) < sizeof(wcount)) {
+    return ProgramPtr();
+  }
+  std::memcpy(&wcount, i, sizeof(wcount));
+  i += sizeof(wcount);
+
+  uint32_t head[5];
+  if (wcount > static_cast<size_t>(end - i) / sizeof(head)) {
+    return ProgramPtr();
+  }
+
+  p->FilterWindows.resize(wcount);
+  for (FilterWindow& w : p->FilterWindows) {
+    if (static_cast<size_t>(end - i) < sizeof(head)) {
+      return ProgramPtr();
+    }
+    std::memcpy(head, i, sizeof(head));
+    i += sizeof(head);
+
+    w.Off = head[0];
+    w.Width = head[1];
+    w.Mult = head[2];
+    w.Shift = head[3];
+
+    if (head[4] > static_cast<size_t>(end - i) / sizeof(uint64_t)) {
+      return ProgramPtr();
+    }
+    w.Table.resize(head[4]);
+
+    std::memcpy(w.Table.data(), i, w.Table.size()*sizeof(uint64_t));
+    i += w.Table.size()*sizeof(uint64_t);
+
+    // the table must hold every index the key can hash to
+    if ((w.Width != 2 && w.Width != 4) || w.Shift > 31) {
+      return ProgramPtr();
+    }
+    const uint64_t maxKey = w.Width == 2 ? 0xFFFF : 0xFFFFFFFF;
+    const uint64_t maxIndex = std::min<uint64_t>(maxKey * w.Mult, 0xFFFFFFFF) >> w.Shift;
+    if (maxIndex >= w.Table.size() * 64) {
+      return ProgramPtr();
+    }
+  }
+
+  if ((end - i) % sizeof(Instruction)) {
+    return ProgramPtr();
+  }
+  const size_t icount = (end - i) / sizeof(Instruction);
+
   // The caller is responsible for freeing buf. We subvert std::unique_ptr
   // here by giving it an empty deleter.
-  p->IBeg = std::unique_ptr<Instruction[], void(*)(Instruction*)>(
-    reinterpret_cast<Instruction*>(const_cast<char*>(i)), [](Instruction*){}
+  p->IBeg = std::unique_ptr<Instruction[], Release>(
+    reinterpret_cast<Instruction*>(const_cast<char*>(i)), Release{0, false}
   );
 
   p->IEnd = p->IBeg.get() + icount;
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "utf8automaton.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+namespace {
+  class Builder {
+  public:
+    Builder(UTF8Automaton& a): A(a) {}
+
+    // The vertices taking the leading bytes of the code points in s, each
+    // followed by k continuation bytes, with prefix the lead byte marker
+    std::vector<uint32_t> transitions(const UnicodeSet& s, uint32_t k, byte prefix) {
+      const uint32_t unit = 1u << (6*k);
+
+      // split s by leading byte, keeping what remains to be encoded
+      std::vector<std::pair<uint32_t,UnicodeSet>> rest;
+      for (const UnicodeSet::range r : s) {
+        for (uint32_t v = r.first/unit; v*unit < r.second; ++v) {
+          if (rest.empty() || rest.back().first != v) {
+            rest.emplace_back(v, UnicodeSet());
+          }
+
+          rest.back().second.insert(
+            std::max(r.first, v*unit) - v*unit,
+            std::min(r.second, (v+1)*unit) - v*unit
+          );
+        }
+      }
+
+      // bytes leading to the same remainder share a vertex
+      std::vector<std::pair<const UnicodeSet*,ByteSet>> groups;
+      std::map<UnicodeSet,size_t> gi;
+      for (const auto& r : rest) {
+        const auto i = gi.emplace(r.second, groups.size());
+        if (i.second) {
+          groups.emplace_back(&r.second, ByteSet());
+        }
+        groups[i.first->second].second.set(prefix | r.first);
+      }
+
+      std::vector<uint32_t> out;
+      for (const auto& g : groups) {
+        out.push_back(vertex(g.second, state(k, *g.first), k == 0));
+      }
+      return out;
+    }
+
+  private:
+    // The state for the code points in s with k bytes left to encode,
+    // identified by the vertices leaving it
+    uint32_t state(uint32_t k, const UnicodeSet& s) {
+      const auto key = std::make_pair(k, s);
+      const auto i = States.find(key);
+      if (i != States.end()) {
+        return i->second;
+      }
+
+      std::vector<uint32_t> out;
+      if (k > 0) {
+        out = transitions(s, k-1, 0x80);
+      }
+
+      const uint32_t id = StateOut.size();
+      StateOut.push_back(std::move(out));
+      States.emplace(key, id);
+      return id;
+    }
+
+    uint32_t vertex(const ByteSet& bytes, uint32_t st, bool final) {
+      const auto key = std::make_pair(bytes, st);
+      const auto i = Vertices.find(key);
+      if (i != Vertices.end()) {
+        return i->second;
+      }
+
+      const uint32_t id = A.Vertices.size();
+      A.Vertices.push_back(UTF8Automaton::Vertex{bytes, StateOut[st], final});
+      Vertices.emplace(key, id);
+      return id;
+    }
+
+    UTF8Automaton& A;
+
+    std::map<std::pair<uint32_t,UnicodeSet>,uint32_t> States;
+    std::vector<std::vector<uint32_t>> StateOut;
+
+    std::map<std::pair<ByteSet,uint32_t>,uint32_t> Vertices;
+  };
+}
+
+UTF8Automaton::UTF8Automaton(const UnicodeSet& uset): Single(NONE) {
+  static const struct {
+    uint32_t Lo, Hi;
+    byte Prefix;
+  } lengths[] = {
+    { 0x00,    0x80,     0x00 },
+    { 0x80,    0x800,    0xC0 },
+    { 0x800,   0x10000,  0xE0 },
+    { 0x10000, 0x110000, 0xF0 }
+  };
+
+  Builder b(*this);
+  for (uint32_t k = 0; k < 4; ++k) {
+    const std::vector<uint32_t> heads = b.transitions(
+      uset & UnicodeSet(lengths[k].Lo, lengths[k].Hi), k, lengths[k].Prefix
+    );
+
+    if (k == 0 && !heads.empty()) {
+      Single = heads.front();
+    }
+    Heads.insert(Heads.end(), heads.begin(), heads.end());
+  }
+}
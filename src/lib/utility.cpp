@@ -18,9 +18,35 @@
 #include "utility.h"
 
 #include <algorithm>
+#include <limits>
+#include <map>
+#include <queue>
 #include <set>
+#include <stdexcept>
+#include <string>
+#include <tuple>
 
-std::pair<uint32_t,std::bitset<256*256>> bestPair(const NFA& graph) {
+namespace {
+  // OR into second the bytes which can come stride bytes after those
+  // taken by t0, or every byte if a match ends before then
+  void strideBytes(const NFA& graph, NFA::VertexDescriptor t0, uint32_t stride, ByteSet& second) {
+    if (graph[t0].IsMatch) {
+      second.set();
+      return;
+    }
+
+    for (const NFA::VertexDescriptor t1 : graph.outVertices(t0)) {
+      if (stride == 1) {
+        graph[t1].Trans->orBytes(second);
+      }
+      else {
+        strideBytes(graph, t1, stride - 1, second);
+      }
+    }
+  }
+}
+
+std::vector<std::bitset<256*256>> pairWindows(const NFA& graph, uint32_t stride) {
   // pairs are (depth, vertex); we're using next as a min heap
   std::set<std::pair<uint32_t,NFA::VertexDescriptor>> next;
   next.emplace(0, 0);
@@ -70,9 +96,13 @@ std::pair<uint32_t,std::bitset<256*256>> bestPair(const NFA& graph) {
       ByteSet first;
       graph[t0].Trans->orBytes(first);
 
-      if (graph[t0].IsMatch) {
-        // match; record each first byte followed by any byte
-        for (uint32_t s = 0; s < 256; ++s) {
+      // record each first byte followed by each second byte, which is any
+      // byte if a match ends in between
+      ByteSet second;
+      strideBytes(graph, t0, stride, second);
+
+      for (uint32_t s = 0; s < 256; ++s) {
+        if (second.test(s)) {
           // first is a std::bitset<256>, so is 256 bits = 32 bytes long,
           // and bb is a byte pointer into a std::bitset<256*256>, which
           // has the same layout as an array of 256 std::bitset<256>s.
@@ -82,19 +112,6 @@ std::pair<uint32_t,std::bitset<256*256>> bestPair(const NFA& graph) {
           *reinterpret_cast<std::bitset<256>*>(bb + (s << 5)) |= first;
         }
       }
-      else {
-        // no match; record each first byte followed by each second byte
-        for (const NFA::VertexDescriptor t1 : graph.outVertices(t0)) {
-          ByteSet second;
-          graph[t1].Trans->orBytes(second);
-
-          for (uint32_t s = 0; s < 256; ++s) {
-            if (second.test(s)) {
-              *reinterpret_cast<std::bitset<256>*>(bb + (s << 5)) |= first;
-            }
-          }
-        }
-      }
     }
   }
 
@@ -109,6 +126,10 @@ std::pair<uint32_t,std::bitset<256*256>> bestPair(const NFA& graph) {
     b.resize(lmin);
   }
 
+  return b;
+}
+
+std::pair<uint32_t,std::bitset<256*256>> bestPair(const std::vector<std::bitset<256*256>>& b) {
   // Return the offset and bitset for the best two-byte window
   const auto i = std::min_element(b.begin(), b.end(),
     [](const std::bitset<256*256>& l, const std::bitset<256*256>& r) {
@@ -119,6 +140,201 @@ std::pair<uint32_t,std::bitset<256*256>> bestPair(const NFA& graph) {
   return {i-b.begin(), *i};
 }
 
+std::pair<uint32_t,std::bitset<256*256>> bestPair(const NFA& graph) {
+  return bestPair(pairWindows(graph));
+}
+
+bool zeroPadded(const std::bitset<256*256>& pairs) {
+  // pairs are keyed first | second << 8
+  bool firstZero = true, secondZero = true;
+  for (uint32_t k = 0; k < 256*256 && (firstZero || secondZero); ++k) {
+    if (pairs.test(k)) {
+      firstZero &= (k & 0xFF) == 0;
+      secondZero &= (k >> 8) == 0;
+    }
+  }
+  return pairs.any() && (firstZero || secondZero);
+}
+
+std::pair<uint32_t,std::bitset<256*256>> bestWidePair(const std::vector<std::bitset<256*256>>& pairs) {
+  uint32_t best = pairs.size();
+  for (uint32_t off = 0; off < pairs.size(); ++off) {
+    if (!zeroPadded(pairs[off]) &&
+        (best == pairs.size() || pairs[off].count() < pairs[best].count()))
+    {
+      best = off;
+    }
+  }
+
+  return {best, best < pairs.size() ? pairs[best] : std::bitset<256*256>()};
+}
+
+namespace {
+  // Bail out of enumerating the 4-grams at an offset once this many have
+  // been found. Character classes make the count multiply at each byte,
+  // so hitting this means the window would be too dense to be useful.
+  const size_t GRAM_LIMIT = 1 << 20;
+
+  // Secondary windows are only worth their space when the primary
+  // window admits more than this many byte pairs...
+  const size_t PRIMARY_PAIRS_GOOD = 64;
+
+  // ...and they are kept only if they admit no more than this fraction
+  const double WINDOW_DENSITY_MAX = 0.5;
+
+  const uint32_t WINDOWS_MAX = 3;
+
+  bool collectGrams(const NFA& graph, NFA::VertexDescriptor h, uint32_t depth, uint32_t key, std::vector<uint32_t>& grams) {
+    if (depth == 4) {
+      grams.push_back(key);
+      return grams.size() < GRAM_LIMIT;
+    }
+
+    ByteSet bs;
+    for (const NFA::VertexDescriptor t : graph.outVertices(h)) {
+      graph[t].Trans->getBytes(bs);
+      for (uint32_t b = 0; b < 256; ++b) {
+        if (bs.test(b) &&
+            !collectGrams(graph, t, depth + 1, key | (b << (depth << 3)), grams))
+        {
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  FilterWindow pairWindow(uint32_t off, const std::bitset<256*256>& pairs) {
+    FilterWindow w{off, 2, 1, 0, std::vector<uint64_t>(256*256/64)};
+    for (uint32_t k = 0; k < 256*256; ++k) {
+      if (pairs.test(k)) {
+        w.set(k);
+      }
+    }
+    return w;
+  }
+
+  FilterWindow gramWindow(uint32_t off, const std::vector<uint32_t>& grams) {
+    // aim for no more than 1/16 of the bits set, within [2^16, 2^22] bits
+    uint32_t bits = 16;
+    while (bits < 22 && (size_t(1) << bits) < (grams.size() << 4)) {
+      ++bits;
+    }
+
+    // Fibonacci hashing, keeping the high bits of the product
+    FilterWindow w{off, 4, 0x9E3779B1, 32 - bits, std::vector<uint64_t>((size_t(1) << bits)/64)};
+    for (const uint32_t k : grams) {
+      w.set(k);
+    }
+    return w;
+  }
+
+  double density(const FilterWindow& w) {
+    size_t set = 0;
+    for (const uint64_t word : w.Table) {
+      set += std::bitset<64>(word).count();
+    }
+    return double(set) / (w.Table.size() * 64);
+  }
+}
+
+std::vector<FilterWindow> filterWindows(const NFA& graph, const std::vector<std::bitset<256*256>>& pairs, uint32_t primaryOff) {
+  return pairs.empty() ? std::vector<FilterWindow>() :
+    filterWindows(graph, pairs, primaryOff, 1, pairs[primaryOff]);
+}
+
+std::vector<FilterWindow> filterWindows(const NFA& graph, const std::vector<std::bitset<256*256>>& pairs, uint32_t primaryOff, uint32_t primaryStride, const std::bitset<256*256>& primary) {
+  std::vector<FilterWindow> windows;
+
+  if (pairs.empty() || primary.count() <= PRIMARY_PAIRS_GOOD) {
+    // the primary window rejects well enough by itself
+    return windows;
+  }
+
+  // Input which could match at all is drawn from the bytes the patterns
+  // use, not uniformly from all 256. Measure each window against that
+  // alphabet, or else e.g. the 676 pairs of lowercase letters look like
+  // 1% of pairs when they are in fact 100% of words in lowercase text.
+  ByteSet alphabet;
+  for (const std::bitset<256*256>& p : pairs) {
+    for (uint32_t k = 0; k < 256*256; ++k) {
+      if (p.test(k)) {
+        alphabet.set(k & 0xFF);
+      }
+    }
+  }
+
+  const double asize = alphabet.count();
+
+  // candidate pair windows at every other offset
+  std::vector<std::pair<double,FilterWindow>> cands;
+  for (uint32_t off = 0; off < pairs.size(); ++off) {
+    if (off != primaryOff || primaryStride != 1) {
+      const double d = std::min(1.0, pairs[off].count() / (asize*asize));
+      if (d <= WINDOW_DENSITY_MAX) {
+        cands.emplace_back(d, pairWindow(off, pairs[off]));
+      }
+    }
+  }
+
+  // candidate 4-gram windows at offsets where every match has four bytes;
+  // pairs.size() is the minimum match length, so that's [0, size - 4]
+  std::vector<bool> level(graph.verticesSize(), false), nextLevel(level);
+  level[0] = true;
+
+  std::vector<uint32_t> grams;
+  for (uint32_t off = 0; off + 4 <= pairs.size() && off < 8; ++off) {
+    grams.clear();
+
+    bool ok = true;
+    for (NFA::VertexDescriptor h = 0; ok && h < level.size(); ++h) {
+      if (level[h]) {
+        ok = collectGrams(graph, h, 0, 0, grams);
+      }
+    }
+
+    if (ok) {
+      std::sort(grams.begin(), grams.end());
+      grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+
+      // keys outside the set get through only on hash collisions
+      FilterWindow w(gramWindow(off, grams));
+      const double d = std::min(1.0,
+        grams.size() / (asize*asize*asize*asize) + density(w)
+      );
+      if (d <= WINDOW_DENSITY_MAX) {
+        cands.emplace_back(d, std::move(w));
+      }
+    }
+
+    // advance to the vertices at the next depth
+    std::fill(nextLevel.begin(), nextLevel.end(), false);
+    for (NFA::VertexDescriptor h = 0; h < level.size(); ++h) {
+      if (level[h]) {
+        for (const NFA::VertexDescriptor t : graph.outVertices(h)) {
+          nextLevel[t] = true;
+        }
+      }
+    }
+    level.swap(nextLevel);
+  }
+
+  // keep the most selective few
+  std::stable_sort(cands.begin(), cands.end(),
+    [](const std::pair<double,FilterWindow>& l,
+       const std::pair<double,FilterWindow>& r) {
+      return l.first < r.first;
+    }
+  );
+
+  for (uint32_t i = 0; i < cands.size() && i < WINDOWS_MAX; ++i) {
+    windows.push_back(std::move(cands[i].second));
+  }
+
+  return windows;
+}
+
 std::vector<std::vector<NFA::VertexDescriptor>> pivotStates(NFA::VertexDescriptor source, const NFA& graph) {
   std::vector<std::vector<NFA::VertexDescriptor>> ret(256);
   ByteSet permitted;
@@ -143,6 +359,666 @@ uint32_t maxOutbound(const std::vector<std::vector<NFA::VertexDescriptor>>& tran
   )->size();
 }
 
+NFA labelSubgraph(const NFA& graph, const std::vector<uint32_t>& labels) {
+  // map each wanted label to its position in labels
+  uint32_t lmax = 0;
+  for (const uint32_t l : labels) {
+    lmax = std::max(lmax, l);
+  }
+
+  std::vector<uint32_t> pos(lmax + 1, Glushkov::NOLABEL);
+  for (uint32_t i = 0; i < labels.size(); ++i) {
+    pos[labels[i]] = i;
+  }
+
+  const auto wanted = [&](const NFA::VertexDescriptor v) {
+    return graph[v].IsMatch && graph[v].Label <= lmax &&
+           pos[graph[v].Label] != Glushkov::NOLABEL;
+  };
+
+  // find the vertices from which a match for these labels is reachable
+  const uint32_t n = graph.verticesSize();
+  std::vector<bool> keep(n, false);
+  std::queue<NFA::VertexDescriptor> next;
+
+  for (const NFA::VertexDescriptor v : graph.vertices()) {
+    if (wanted(v)) {
+      keep[v] = true;
+      next.push(v);
+    }
+  }
+
+  if (next.empty()) {
+    throw std::runtime_error("pattern has no match states");
+  }
+
+  while (!next.empty()) {
+    const NFA::VertexDescriptor t = next.front();
+    next.pop();
+    for (const NFA::VertexDescriptor h : graph.inVertices(t)) {
+      if (!keep[h]) {
+        keep[h] = true;
+        next.push(h);
+      }
+    }
+  }
+
+  // copy those vertices, and the edges among them, into a new graph;
+  // the transitions belong to the shared factory, so copying is cheap
+  NFA sub(1);
+  sub.TransFac = graph.TransFac;
+  sub.Deterministic = graph.Deterministic;
+
+  std::vector<NFA::VertexDescriptor> idx(n, 0);
+  for (NFA::VertexDescriptor v = 1; v < n; ++v) {
+    if (keep[v]) {
+      idx[v] = sub.addVertex(graph[v]);
+
+      // matches for other labels are just pass-through states here
+      Glushkov& sv = sub[idx[v]];
+      if (wanted(v)) {
+        sv.Label = pos[sv.Label];
+      }
+      else {
+        sv.IsMatch = false;
+        sv.Label = Glushkov::NOLABEL;
+      }
+    }
+  }
+
+  for (NFA::VertexDescriptor h = 0; h < n; ++h) {
+    if (keep[h]) {
+      for (const NFA::VertexDescriptor t : graph.outVertices(h)) {
+        if (keep[t]) {
+          sub.addEdge(idx[h], idx[t]);
+        }
+      }
+    }
+  }
+
+  return sub;
+}
+
+NFA differenceGraph(const NFA& graph) {
+  const uint32_t n = graph.verticesSize();
+
+  std::vector<std::vector<byte>> bytes(n);
+  for (NFA::VertexDescriptor v = 1; v < n; ++v) {
+    ByteSet bs;
+    graph[v].Trans->getBytes(bs);
+    for (uint32_t b = 0; b < 256; ++b) {
+      if (bs[b]) {
+        bytes[v].push_back(b);
+      }
+    }
+  }
+
+  // a state is labeled with the XOR of each byte which may precede it
+  // with each of its own; this is exact for literals, and otherwise admits
+  // somewhat more than the differences of the matches do
+  std::vector<ByteSet> diffs(n);
+  for (NFA::VertexDescriptor h = 1; h < n; ++h) {
+    for (const NFA::VertexDescriptor t : graph.outVertices(h)) {
+      ByteSet& d = diffs[t];
+      for (auto a = bytes[h].begin(); a != bytes[h].end() && !d.all(); ++a) {
+        for (const byte b : bytes[t]) {
+          d.set(*a ^ b);
+        }
+      }
+    }
+  }
+
+  // a difference match begins where the second byte of a match does;
+  // the first states of the graph only lead on to the rest
+  std::vector<NFA::VertexDescriptor> starts;
+  std::vector<bool> keep(n, false);
+  std::queue<NFA::VertexDescriptor> next;
+
+  for (const NFA::VertexDescriptor h : graph.outVertices(0)) {
+    for (const NFA::VertexDescriptor t : graph.outVertices(h)) {
+      if (!keep[t]) {
+        keep[t] = true;
+        starts.push_back(t);
+        next.push(t);
+      }
+    }
+  }
+
+  if (next.empty()) {
+    throw std::runtime_error("no pattern matches more than one byte");
+  }
+
+  while (!next.empty()) {
+    const NFA::VertexDescriptor h = next.front();
+    next.pop();
+    for (const NFA::VertexDescriptor t : graph.outVertices(h)) {
+      if (!keep[t]) {
+        keep[t] = true;
+        next.push(t);
+      }
+    }
+  }
+
+  NFA diff(1);
+  diff.TransFac = graph.TransFac;
+  diff.Deterministic = false;
+
+  std::vector<NFA::VertexDescriptor> idx(n, 0);
+  for (NFA::VertexDescriptor v = 1; v < n; ++v) {
+    if (keep[v]) {
+      idx[v] = diff.addVertex(graph[v]);
+      diff[idx[v]].Trans = diff.TransFac->getByteSet(diffs[v]);
+    }
+  }
+
+  for (const NFA::VertexDescriptor t : starts) {
+    diff.addEdge(0, idx[t]);
+  }
+
+  for (NFA::VertexDescriptor h = 1; h < n; ++h) {
+    if (keep[h]) {
+      for (const NFA::VertexDescriptor t : graph.outVertices(h)) {
+        diff.addEdge(idx[h], idx[t]);
+      }
+    }
+  }
+
+  return diff;
+}
+
+uint32_t maxMatchLength(const NFA& graph) {
+  const uint32_t n = graph.verticesSize();
+  const uint32_t UNBOUNDED = std::numeric_limits<uint32_t>::max();
+
+  // the most bytes from each vertex to a match, or -1 if none is reached;
+  // a vertex is on the DFS stack while its length is being found
+  std::vector<int64_t> rest(n, -1);
+  std::vector<bool> seen(n, false), onStack(n, false);
+  std::vector<std::pair<NFA::VertexDescriptor,uint32_t>> stack;
+
+  seen[0] = onStack[0] = true;
+  stack.emplace_back(0, 0);
+
+  while (!stack.empty()) {
+    const NFA::VertexDescriptor h = stack.back().first;
+    const uint32_t i = stack.back().second;
+
+    if (i < graph.outDegree(h)) {
+      ++stack.back().second;
+      const NFA::VertexDescriptor t = graph.outVertex(h, i);
+      if (onStack[t]) {
+        return UNBOUNDED;
+      }
+      else if (!seen[t]) {
+        seen[t] = onStack[t] = true;
+        stack.emplace_back(t, 0);
+      }
+    }
+    else {
+      int64_t r = graph[h].IsMatch ? 0 : -1;
+      for (const NFA::VertexDescriptor t : graph.outVertices(h)) {
+        if (rest[t] >= 0) {
+          r = std::max(r, rest[t] + 1);
+        }
+      }
+      rest[h] = r;
+      onStack[h] = false;
+      stack.pop_back();
+    }
+  }
+
+  return rest[0] < 0 || rest[0] >= UNBOUNDED ? UNBOUNDED : rest[0];
+}
+
+namespace {
+  const char BASE64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  //
+  // Builds the Base64 graph for base64Graph(). Each byte of a match is
+  // written as one or two characters, depending on where it falls in its
+  // three-byte group, and the bits it leaves over carry into the next
+  // character. A state of the new graph stands for a state of the old,
+  // the bits left over, and, where the character it matches depends on
+  // them, the bits which came before.
+  //
+  class Base64Builder {
+  public:
+    // stands for the leftover bits of a match's first byte not yet known
+    static const uint32_t ANY = 0xFF;
+
+    Base64Builder(const NFA& src):
+      Src(src), Bytes(src.verticesSize()), Dst(1)
+    {
+      Dst.TransFac = src.TransFac;
+      Dst.Deterministic = false;
+
+      for (NFA::VertexDescriptor v = 1; v < src.verticesSize(); ++v) {
+        ByteSet bs;
+        src[v].Trans->getBytes(bs);
+        for (uint32_t b = 0; b < 256; ++b) {
+          if (bs[b]) {
+            Bytes[v].push_back(b);
+          }
+        }
+      }
+    }
+
+    NFA build() {
+      // a match may begin at any of the three bytes of a group; a match
+      // begins with the group, so that it decodes from its start, with
+      // any of the group before the match unknown
+      const NFA::VertexDescriptor any1 = vertex(std::make_tuple('W', 0, 0, 0), allChars());
+      const NFA::VertexDescriptor any2 = vertex(std::make_tuple('W', 1, 0, 0), allChars());
+      Dst.addEdge(0, any1);
+      Dst.addEdge(any1, any2);
+
+      for (const NFA::VertexDescriptor w : Src.outVertices(0)) {
+        for (const NFA::VertexDescriptor t : first(w)) {
+          Dst.addEdge(0, t);
+        }
+        for (const NFA::VertexDescriptor t : second(w, ANY)) {
+          Dst.addEdge(any1, t);
+        }
+        for (const NFA::VertexDescriptor t : third(w, ANY)) {
+          Dst.addEdge(any2, t);
+        }
+      }
+
+      // follow each edge from each of the states standing for its head
+      for (std::size_t i = 0; i < Pending.size(); ++i) {
+        const Entry e = Pending[i];
+        for (const NFA::VertexDescriptor w : Src.outVertices(e.V)) {
+          std::vector<NFA::VertexDescriptor> next;
+          switch (e.Pos) {
+          case 0:
+            next = first(w);
+            break;
+          case 1:
+            next = second(w, e.Left);
+            break;
+          case 2:
+            next = third(w, e.Left);
+            break;
+          }
+
+          for (const NFA::VertexDescriptor t : next) {
+            Dst.addEdge(e.Out, t);
+          }
+        }
+      }
+
+      return std::move(Dst);
+    }
+
+  private:
+    typedef std::tuple<char,uint32_t,uint32_t,uint32_t> Key;
+
+    // a state from which the bytes of Src after V follow, the next of
+    // them at position Pos of its group, with bits Left left over
+    struct Entry {
+      NFA::VertexDescriptor Out, V;
+      uint32_t Pos, Left;
+    };
+
+    static ByteSet allChars() {
+      ByteSet bs;
+      for (const char c : std::string(BASE64)) {
+        bs.set(static_cast<byte>(c));
+      }
+      return bs;
+    }
+
+    NFA::VertexDescriptor vertex(const Key& k, const ByteSet& chars) {
+      const auto i = Vertices.find(k);
+      if (i != Vertices.end()) {
+        return i->second;
+      }
+
+      const NFA::VertexDescriptor v = Dst.addVertex();
+      Dst[v].Trans = Dst.TransFac->getByteSet(chars);
+      Vertices.emplace(k, v);
+      return v;
+    }
+
+    // the state after writing the character(s) for w, whence the bytes
+    // after w follow at pos with left bits over; also, if w ends a match,
+    // the final character, with the bits after the match unknown
+    NFA::VertexDescriptor after(const Key& k, const ByteSet& chars, NFA::VertexDescriptor w, uint32_t pos, uint32_t left, uint32_t bits) {
+      const bool known = Vertices.count(k);
+      const NFA::VertexDescriptor v = vertex(k, chars);
+      if (known) {
+        return v;
+      }
+
+      Pending.push_back(Entry{v, w, pos, left});
+
+      if (Src[w].IsMatch) {
+        if (pos == 0) {
+          Dst[v].IsMatch = true;
+          Dst[v].Label = Src[w].Label;
+        }
+        else {
+          ByteSet last;
+          for (uint32_t x = 0; x < (1u << (6 - bits)); ++x) {
+            last.set(static_cast<byte>(BASE64[(left << (6 - bits)) | x]));
+          }
+          const NFA::VertexDescriptor m = vertex(std::make_tuple('M', pos, left, Src[w].Label), last);
+          Dst[m].IsMatch = true;
+          Dst[m].Label = Src[w].Label;
+          Dst.addEdge(v, m);
+        }
+      }
+
+      return v;
+    }
+
+    // w as the first byte of a group: its top six bits, two left over
+    std::vector<NFA::VertexDescriptor> first(NFA::VertexDescriptor w) {
+      std::vector<NFA::VertexDescriptor> ret;
+      for (uint32_t r = 0; r < 4; ++r) {
+        ByteSet chars;
+        for (const byte b : Bytes[w]) {
+          if ((b & 3) == r) {
+            chars.set(static_cast<byte>(BASE64[b >> 2]));
+          }
+        }
+        if (chars.any()) {
+          ret.push_back(after(std::make_tuple('A', w, r, 0), chars, w, 1, r, 2));
+        }
+      }
+      return ret;
+    }
+
+    // w as the second: two bits before it, its top four, four left over
+    std::vector<NFA::VertexDescriptor> second(NFA::VertexDescriptor w, uint32_t prev) {
+      std::vector<NFA::VertexDescriptor> ret;
+      for (uint32_t r = 0; r < 16; ++r) {
+        ByteSet chars;
+        for (const byte b : Bytes[w]) {
+          if ((b & 15) == r) {
+            for (uint32_t p = 0; p < 4; ++p) {
+              if (prev == ANY || prev == p) {
+                chars.set(static_cast<byte>(BASE64[(p << 4) | (b >> 4)]));
+              }
+            }
+          }
+        }
+        if (chars.any()) {
+          ret.push_back(after(std::make_tuple('B', w, prev, r), chars, w, 2, r, 4));
+        }
+      }
+      return ret;
+    }
+
+    // w as the third: four bits before it and its top two, then its
+    // bottom six, with none left over
+    std::vector<NFA::VertexDescriptor> third(NFA::VertexDescriptor w, uint32_t prev) {
+      std::vector<NFA::VertexDescriptor> ret;
+      for (uint32_t h = 0; h < 4; ++h) {
+        ByteSet lows;
+        for (const byte b : Bytes[w]) {
+          if ((b >> 6) == h) {
+            lows.set(static_cast<byte>(BASE64[b & 63]));
+          }
+        }
+        if (lows.none()) {
+          continue;
+        }
+
+        ByteSet highs;
+        for (uint32_t p = 0; p < 16; ++p) {
+          if (prev == ANY || prev == p) {
+            highs.set(static_cast<byte>(BASE64[(p << 2) | h]));
+          }
+        }
+
+        const Key hk = std::make_tuple('C', w, prev, h);
+        const bool known = Vertices.count(hk);
+        const NFA::VertexDescriptor hv = vertex(hk, highs);
+        if (!known) {
+          Dst.addEdge(hv, after(std::make_tuple('D', w, h, 0), lows, w, 0, 0, 0));
+        }
+        ret.push_back(hv);
+      }
+      return ret;
+    }
+
+    const NFA& Src;
+    std::vector<std::vector<byte>> Bytes;
+
+    NFA Dst;
+    std::map<Key,NFA::VertexDescriptor> Vertices;
+    std::vector<Entry> Pending;
+  };
+}
+
+NFA base64Graph(const NFA& graph) {
+  return Base64Builder(graph).build();
+}
+
+std::vector<std::vector<uint32_t>> partitionLabels(const NFA& graph, uint32_t numLabels, uint32_t parts) {
+  std::vector<std::vector<NFA::VertexDescriptor>> matches(numLabels);
+  for (const NFA::VertexDescriptor v : graph.vertices()) {
+    if (graph[v].IsMatch && graph[v].Label < numLabels) {
+      matches[graph[v].Label].push_back(v);
+    }
+  }
+
+  // for each label, the least byte which can begin a match and the number
+  // of states leading to its matches, which stands in for its search cost
+  std::vector<std::pair<uint32_t,uint32_t>> firstAndWeight(numLabels);
+
+  const uint32_t n = graph.verticesSize();
+  std::vector<uint32_t> seen(n, Glushkov::NOLABEL);
+  std::queue<NFA::VertexDescriptor> next;
+
+  for (uint32_t l = 0; l < numLabels; ++l) {
+    uint32_t first = 256, weight = 0;
+
+    for (const NFA::VertexDescriptor m : matches[l]) {
+      seen[m] = l;
+      next.push(m);
+    }
+
+    while (!next.empty()) {
+      const NFA::VertexDescriptor t = next.front();
+      next.pop();
+      ++weight;
+
+      for (const NFA::VertexDescriptor h : graph.inVertices(t)) {
+        if (h == 0) {
+          ByteSet bs;
+          graph[t].Trans->getBytes(bs);
+          for (uint32_t b = 0; b < first; ++b) {
+            if (bs[b]) {
+              first = b;
+              break;
+            }
+          }
+        }
+        else if (seen[h] != l) {
+          seen[h] = l;
+          next.push(h);
+        }
+      }
+    }
+
+    firstAndWeight[l] = {first, weight};
+  }
+
+  // group labels by leading byte, so each part gets a narrower prefilter,
+  // then cut the sequence into runs of roughly equal weight; labels with
+  // no matches in the graph, such as duplicate patterns, are left out
+  std::vector<uint32_t> order;
+  for (uint32_t l = 0; l < numLabels; ++l) {
+    if (!matches[l].empty()) {
+      order.push_back(l);
+    }
+  }
+  parts = std::max(1u, std::min(parts, static_cast<uint32_t>(order.size())));
+
+  std::stable_sort(order.begin(), order.end(),
+    [&](uint32_t a, uint32_t b) {
+      return firstAndWeight[a].first < firstAndWeight[b].first;
+    }
+  );
+
+  uint64_t total = 0;
+  for (const std::pair<uint32_t,uint32_t>& fw : firstAndWeight) {
+    total += fw.second;
+  }
+
+  std::vector<std::vector<uint32_t>> ret(parts);
+  uint64_t acc = 0;
+  uint32_t p = 0;
+  for (uint32_t i = 0; i < order.size(); ++i) {
+    const uint32_t l = order[i];
+
+    // move on once this part has its share, leaving a label for each
+    // part still to come
+    if (p + 1 < parts && !ret[p].empty() &&
+        (acc * parts >= total * (p + 1) || order.size() - i == parts - p - 1))
+    {
+      ++p;
+    }
+
+    ret[p].push_back(l);
+    acc += firstAndWeight[l].second;
+  }
+
+  return ret;
+}
+
+namespace {
+  uint32_t minMatchLength(const NFA& graph) {
+    std::vector<uint32_t> depth(
+      graph.verticesSize(), std::numeric_limits<uint32_t>::max()
+    );
+    std::queue<NFA::VertexDescriptor> next;
+
+    depth[0] = 0;
+    next.push(0);
+
+    while (!next.empty()) {
+      const NFA::VertexDescriptor h = next.front();
+      next.pop();
+
+      if (graph[h].IsMatch) {
+        return depth[h];
+      }
+
+      for (const NFA::VertexDescriptor t : graph.outVertices(h)) {
+        if (depth[t] == std::numeric_limits<uint32_t>::max()) {
+          depth[t] = depth[h] + 1;
+          next.push(t);
+        }
+      }
+    }
+
+    return std::numeric_limits<uint32_t>::max();
+  }
+
+  uint32_t countLoops(const NFA& graph) {
+    // Kosaraju's algorithm, iteratively, so that long patterns can't
+    // exhaust the stack
+    const uint32_t n = graph.verticesSize();
+
+    // first pass: order vertices by their DFS finishing times
+    std::vector<NFA::VertexDescriptor> order;
+    order.reserve(n);
+
+    std::vector<bool> seen(n, false);
+    std::vector<std::pair<NFA::VertexDescriptor,uint32_t>> stack;
+
+    for (NFA::VertexDescriptor s = 0; s < n; ++s) {
+      if (seen[s]) {
+        continue;
+      }
+
+      seen[s] = true;
+      stack.emplace_back(s, 0);
+
+      while (!stack.empty()) {
+        const NFA::VertexDescriptor h = stack.back().first;
+        const uint32_t i = stack.back().second;
+
+        if (i < graph.outDegree(h)) {
+          ++stack.back().second;
+          const NFA::VertexDescriptor t = graph.outVertex(h, i);
+          if (!seen[t]) {
+            seen[t] = true;
+            stack.emplace_back(t, 0);
+          }
+        }
+        else {
+          order.push_back(h);
+          stack.pop_back();
+        }
+      }
+    }
+
+    // second pass: collect components on the transpose graph, counting
+    // those which contain a cycle
+    std::vector<bool> assigned(n, false);
+    std::vector<NFA::VertexDescriptor> comp;
+    uint32_t loops = 0;
+
+    for (auto r = order.rbegin(); r != order.rend(); ++r) {
+      if (assigned[*r]) {
+        continue;
+      }
+
+      comp.assign(1, *r);
+      assigned[*r] = true;
+
+      for (uint32_t i = 0; i < comp.size(); ++i) {
+        for (const NFA::VertexDescriptor h : graph.inVertices(comp[i])) {
+          if (!assigned[h]) {
+            assigned[h] = true;
+            comp.push_back(h);
+          }
+        }
+      }
+
+      if (comp.size() > 1) {
+        ++loops;
+      }
+      else {
+        const auto ov = graph.outVertices(comp[0]);
+        if (std::find(ov.begin(), ov.end(), comp[0]) != ov.end()) {
+          ++loops;
+        }
+      }
+    }
+
+    return loops;
+  }
+}
+
+PatternStats analyzePattern(const NFA& graph, uint32_t label) {
+  const NFA sub(labelSubgraph(graph, {label}));
+
+  PatternStats stats;
+
+  stats.MaxFanOut = 0;
+  for (const NFA::VertexDescriptor v : sub.vertices()) {
+    stats.MaxFanOut = std::max(stats.MaxFanOut, maxOutbound(pivotStates(v, sub)));
+  }
+
+  stats.Loops = countLoops(sub);
+  stats.MinLength = minMatchLength(sub);
+  stats.FilterPairs = bestPair(sub).second.count();
+
+  // The fraction of offsets which get past the prefilter, times the number
+  // of threads a thread can become on one byte, times a penalty for each
+  // loop, since loops let threads (and their forks) live indefinitely.
+  // This is only meaningful for comparing patterns to one another.
+  stats.Cost = (stats.FilterPairs / 65536.0) * stats.MaxFanOut * (1 + stats.Loops);
+
+  return stats;
+}
+
 void writeVertex(std::ostream& out, NFA::VertexDescriptor v, const NFA& graph) {
   out << "  " << v << " [label=\"" << v << "\"";
 
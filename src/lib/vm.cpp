@@ -125,6 +125,8 @@ Vm::Vm(ProgramPtr prog):
   ProgEnd(&(*prog)[prog->size() - 2]), // not end, but penultimate, guaranteed to be a halt; threads die just short of the finish
   First(), Active(1, &(*prog)[0]), Next(),
   CheckLabels(prog->MaxCheck+1),
+  DedupThreads(false), PCLocks(), PCLockLabels(), StaleFinish(),
+  MaxThreads(0), DroppedThreads(0),
   LiveNoLabel(false), Live(prog->MaxLabel+1),
   MatchEnds(prog->MaxLabel+1), MatchEndsMax(0),
   CurHitFn(nullptr), UserData(nullptr)
@@ -165,6 +167,8 @@ void Vm::reset() {
   Next.clear();
 
   CheckLabels.clear();
+  PCLocks.clear();
+  StaleFinish.clear();
 
   LiveNoLabel = false;
   Live.clear();
@@ -172,6 +176,8 @@ void Vm::reset() {
   MatchEnds.assign(MatchEnds.size(), 0);
   MatchEndsMax = 0;
 
+  DroppedThreads = 0;
+
   CurHitFn = nullptr;
 
   #ifdef LBT_TRACE_ENABLED
@@ -179,6 +185,22 @@ void Vm::reset() {
   #endif
 }
 
+void Vm::setDedupThreads(bool dedup) {
+  DedupThreads = dedup;
+
+  if (DedupThreads) {
+    PCLocks.resize(Prog->size());
+    PCLockLabels.resize(Prog->size());
+    StaleFinish.resize(Prog->MaxLabel+1);
+  }
+  else {
+    PCLocks.resize(0);
+    PCLockLabels.clear();
+    PCLockLabels.shrink_to_fit();
+    StaleFinish.resize(0);
+  }
+}
+
 inline void Vm::_markLive(const uint32_t label) {
   if (label == Thread::NOLABEL) {
     LiveNoLabel = true;
@@ -255,6 +277,55 @@ inline bool Vm::_liveCheck(const uint64_t start, const uint32_t label) const {
   }
 }
 
+inline bool Vm::_dedupCheck(const uint64_t start, const uint32_t label) const {
+  // Threads at the same PC with the same label have the same future, and
+  // any match a later one could make overlaps one the lock holder could
+  // make. Only an emission ending before the current offset can kill the
+  // lock holder while sparing a later-starting thread, so only pending
+  // matches from earlier frames (and, for unlabeled threads, matches
+  // already emitted) block the lock.
+  if (label == Thread::NOLABEL) {
+    return StaleFinish.size() > 0 || start < MatchEndsMax;
+  }
+  else {
+    return StaleFinish.find(label);
+  }
+}
+
+inline void Vm::_pushNext(const Instruction* const base, ThreadList::iterator t, const uint64_t offset) {
+  if (DedupThreads) {
+    if (t->PC->OpCode == FINISH_OP) {
+      if (t->End < offset && !StaleFinish.find(t->Label)) {
+        StaleFinish.insert(t->Label);
+      }
+    }
+    else {
+      const uint32_t pc = t->PC - base;
+      std::vector<uint32_t>& labels = PCLockLabels[pc];
+      if (PCLocks.find(pc)) {
+        if (std::find(labels.begin(), labels.end(), t->Label) != labels.end()) {
+          // another thread has the lock, we die
+          t->PC = 0;
+          return;
+        }
+        else if (!_dedupCheck(t->Start, t->Label)) {
+          // the first thread at this PC with our label takes the lock
+          labels.push_back(t->Label);
+        }
+      }
+      else if (!_dedupCheck(t->Start, t->Label)) {
+        // nothing blocks us, we take the lock; the labels locked in an
+        // earlier frame are stale
+        PCLocks.insert(pc);
+        labels.assign(1, t->Label);
+      }
+    }
+  }
+
+  _markLive(t->Label);
+  Next.push_back(*t);
+}
+
 // while base is always == &Program[0], we pass it in because it then should get inlined away
 template <uint32_t X>
 inline bool Vm::_executeEpsilon(const Instruction* const base, ThreadList::iterator t, const uint64_t offset) {
@@ -318,8 +389,7 @@ inline bool Vm::_executeEpsilon(const Instruction* const base, ThreadList::itera
 
       // recurse to keep going in sequence
       if (_executeEpSequence<X == 0 ? 0 : X-1>(base, t, offset)) {
-        _markLive(t->Label);
-        Next.push_back(*t);
+        _pushNext(base, t, offset);
       }
 
       // Now back up to the fork, fall through to handle it as a longjump.
@@ -388,13 +458,11 @@ inline void Vm::_executeThread(const Instruction* const base, ThreadList::iterat
   post_run_thread_json(std::clog, offset, *t, base);
 
   if (alive && _executeEpSequence<10>(base, t, offset)) {
-    _markLive(t->Label);
-    Next.push_back(*t);
+    _pushNext(base, t, offset);
   }
   #else
   if (_execute(base, t, cur) && _executeEpSequence<10>(base, t, offset)) {
-    _markLive(t->Label);
-    Next.push_back(*t);
+    _pushNext(base, t, offset);
   }
   #endif
 }
@@ -456,6 +524,26 @@ inline void Vm::_executeNewThreads(const Instruction* const base, ThreadList::it
   }
 }
 
+inline bool Vm::_passesFilterWindows(const byte* const cur) const {
+  for (const FilterWindow& w : Prog->FilterWindows) {
+    if (!w.admits(cur)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline const byte* Vm::_nextCandidate(const std::bitset<256*256>& filter, const byte* cur, const byte* const end) const {
+  const uint32_t off = Prog->FilterOff;
+  if (Prog->FilterStride == 1) {
+    for ( ; cur < end && !filter[cur[off] | (cur[off+1] << 8)]; ++cur);
+  }
+  else {
+    for ( ; cur < end && !filter[cur[off] | (cur[off+2] << 8)]; ++cur);
+  }
+  return cur;
+}
+
 inline void Vm::_executeFrame(const std::bitset<256*256>& filter, ThreadList::iterator t, const Instruction* const base, const byte* const cur, const uint64_t offset) {
   // run old threads at this offset
   // uint32_t count = 0;
@@ -466,7 +554,8 @@ inline void Vm::_executeFrame(const std::bitset<256*256>& filter, ThreadList::it
   }
 
   // create new threads at this offset
-  if (filter[*reinterpret_cast<const uint16_t* const>(cur+Prog->FilterOff)]) {
+  if (filter[Prog->filterKey(cur)] && _passesFilterWindows(cur))
+  {
     _executeNewThreads(base, t, cur, offset);
   }
   // ThreadCountHist.resize(count + 1, 0);
@@ -489,11 +578,39 @@ inline void Vm::_executeFrame(ThreadList::iterator t, const Instruction* const b
   // ++ThreadCountHist[count];
 }
 
-inline void Vm::_cleanup() {
+void Vm::_shedThreads() {
+  // Threads are in priority order, so drop from the back, but keep any
+  // threads holding matches which have yet to be reported: those waiting
+  // to finish, and those which have matched and are trying to extend it.
+  const auto droppable = [](const Thread& t) {
+    return t.PC->OpCode != FINISH_OP && t.End == Thread::NONE;
+  };
+
+  ThreadList::size_type excess = Active.size() - MaxThreads;
+  ThreadList::iterator cut(Active.end());
+  while (excess && cut != Active.begin()) {
+    if (droppable(*--cut)) {
+      --excess;
+    }
+  }
+
+  const ThreadList::iterator e(std::remove_if(cut, Active.end(), droppable));
+
+  DroppedThreads += Active.end() - e;
+  Active.erase(e, Active.end());
+}
+
+inline void Vm::_cleanup(const bool anchored) {
   Active.swap(Next);
   Next.clear();
 
+  if (MaxThreads && Active.size() > MaxThreads && !anchored) {
+    _shedThreads();
+  }
+
   CheckLabels.clear();
+  PCLocks.clear();
+  StaleFinish.clear();
 
   LiveNoLabel = false;
   Live.clear();
@@ -529,13 +646,43 @@ void Vm::executeFrame(const byte* const cur, uint64_t offset, HitCallback hitFn,
 void Vm::startsWith(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData) {
   CurHitFn = hitFn;
   UserData = userData;
+
+  if (_startsWith(&(*Prog)[0], beg, end, startOffset)) {
+    reset();
+  }
+}
+
+void Vm::startsWithMany(const byte* const beg, const byte* const end, const uint64_t startOffset, const uint64_t* const offsets, const size_t num, HitCallback hitFn, void* userData) {
+  CurHitFn = hitFn;
+  UserData = userData;
   const Instruction* const base = &(*Prog)[0];
-  uint64_t offset = startOffset;
+  const uint64_t len = end - beg;
+
+  for (size_t i = 0; i < num; ++i) {
+    if (offsets[i] >= len) {
+      continue;
+    }
+
+    if (_startsWith(base, beg + offsets[i], end, startOffset + offsets[i])) {
+      // everything else is cleared frame by frame; the match ends need
+      // clearing only if there were hits, which spares a full reset for
+      // each of the many candidates which match nothing
+      Active.clear();
+      if (MatchEndsMax) {
+        MatchEnds.assign(MatchEnds.size(), 0);
+        MatchEndsMax = 0;
+      }
+    }
+  }
 
-  const byte* const filterOff = beg+Prog->FilterOff;
+  reset();
+}
 
-  if (end - beg == 1 || (filterOff < end - 1 &&
-      Prog->Filter[*(reinterpret_cast<const uint16_t*>(filterOff))]))
+bool Vm::_startsWith(const Instruction* const base, const byte* const beg, const byte* const end, uint64_t offset) {
+  // a filter window running past the end can't be checked, so the
+  // threads are started without it, as at the end of a search
+  if (beg + Prog->FilterOff + Prog->FilterStride >= end ||
+      Prog->Filter[Prog->filterKey(beg)])
   {
     for (ThreadList::const_iterator t(First.begin()); t != First.end(); ++t) {
       Active.emplace_back(t->PC, Thread::NOLABEL, offset, Thread::NONE);
@@ -546,17 +693,21 @@ void Vm::startsWith(const byte* const beg, const byte* const end, const uint64_t
         _executeThread(base, t, cur, offset);
       }
 
-      _cleanup();
+      // a dropped thread here takes its hits with it, as no thread starting
+      // at a later offset could find them again
+      _cleanup(true);
 
       if (Active.empty()) {
         // early exit if threads die out
         break;
       }
     }
-  
-    closeOut(hitFn, userData);
-    reset();
+
+    closeOut(CurHitFn, UserData);
+    return true;
   }
+
+  return false;
 }
 
 uint64_t Vm::_startOfLeftmostLiveThread(const uint64_t offset) const {
@@ -579,12 +730,23 @@ uint64_t Vm::search(const byte* const beg, const byte* const end, const uint64_t
   const Instruction* const base = &(*Prog)[0];
 
   const std::bitset<256*256>& filter = Prog->Filter;
-  const byte* const filterEnd = end - Prog->FilterOff - 1;
+  const byte* const filterEnd = end - Prog->filterSpan() + 1;
 
   uint64_t offset = startOffset;
 
   const byte* cur = beg;
   for ( ; cur < filterEnd; ++cur, ++offset) {
+    if (Active.empty()) {
+      // nothing is running, so pass over the offsets the filter rejects
+      // without setting up frames for them
+      const byte* const next = _nextCandidate(filter, cur, filterEnd);
+      offset += next - cur;
+      cur = next;
+      if (cur == filterEnd) {
+        break;
+      }
+    }
+
     #ifdef LBT_TRACE_ENABLED
     open_frame_json(std::clog, offset, cur);
     #endif
@@ -618,6 +780,59 @@ uint64_t Vm::search(const byte* const beg, const byte* const end, const uint64_t
   return _startOfLeftmostLiveThread(offset);
 }
 
+namespace {
+  // passes hits on, counting them
+  struct CountedHits {
+    HitCallback Fn;
+    void* UserData;
+    uint64_t Num;
+
+    static void hit(void* userData, const LG_SearchHit* const hit) {
+      CountedHits* c = static_cast<CountedHits*>(userData);
+      ++c->Num;
+      if (c->Fn) {
+        (*c->Fn)(c->UserData, hit);
+      }
+    }
+  };
+}
+
+uint64_t Vm::searchZeros(const uint64_t count, const uint64_t startOffset, HitCallback hitFn, void* userData) {
+  static const byte zeros[4096] = {0};
+
+  const uint64_t end = startOffset + count;
+  uint64_t offset = startOffset;
+
+  ThreadList before;
+
+  while (offset < end) {
+    // If a zero leaves the threads as they were and reports nothing, then
+    // so will every zero after it, and we can skip to the end of the run.
+    // That's the usual case: no live threads and no pattern beginning with
+    // a zero, or threads which loop on any byte, as in a[^b]*b. Patterns
+    // which match a zero report a hit at every one, so are never skipped.
+    before = Active;
+    const uint64_t dropped = DroppedThreads, matchEndsMax = MatchEndsMax;
+
+    CountedHits counted{hitFn, userData, 0};
+    search(zeros, zeros + 1, offset, &CountedHits::hit, &counted);
+    ++offset;
+
+    if (!counted.Num && MatchEndsMax == matchEndsMax &&
+        Active == before && DroppedThreads == dropped)
+    {
+      offset = end;
+      break;
+    }
+
+    const uint64_t len = std::min(end - offset, static_cast<uint64_t>(sizeof(zeros)));
+    search(zeros, zeros + len, offset, hitFn, userData);
+    offset += len;
+  }
+
+  return _startOfLeftmostLiveThread(offset);
+}
+
 uint64_t Vm::searchResolve(const byte* const beg, const byte* const end, const uint64_t startOffset, HitCallback hitFn, void* userData) {
   CurHitFn = hitFn;
   UserData = userData;
@@ -666,6 +881,10 @@ void Vm::closeOut(HitCallback hitFn, void* userData) {
       if (t->Start >= MatchEnds[t->Label]) {
         MatchEnds[t->Label] = t->End + 1;
 
+        if (t->End + 1 > MatchEndsMax) {
+          MatchEndsMax = t->End + 1;
+        }
+
         hit.Start = t->Start;
         hit.End = t->End + 1;
         hit.KeywordIndex = t->Label;
@@ -63,7 +63,7 @@ void STest::init(const std::vector<Pattern>& pats) {
     ++i;
   }
 
-  LG_ProgramOptions progOpts{0xFFFFFFFF};
+  LG_ProgramOptions progOpts{0xFFFFFFFF, 1};
 
   Prog = std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)>(
     lg_create_program(fsm.get(), &progOpts),
@@ -71,7 +71,7 @@ void STest::init(const std::vector<Pattern>& pats) {
   );
 
   if (Prog) {
-    LG_ContextOptions ctxOpts;
+    LG_ContextOptions ctxOpts{};
 
     Ctx = std::unique_ptr<ContextHandle,void(*)(ContextHandle*)>(
       lg_create_context(Prog.get(), &ctxOpts),
@@ -63,7 +63,7 @@ public:
   STest(ProgPtr prog):
     Hits(), Prog(std::move(prog)), RetVal(0), Ctx(nullptr, nullptr)
   {
-    LG_ContextOptions ctxOpts;
+    LG_ContextOptions ctxOpts{};
     Ctx = std::unique_ptr<ContextHandle, void(*)(ContextHandle*)>(
       lg_create_context(Prog.get(), &ctxOpts),
       lg_destroy_context
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include "allocator.h"
+#include "handles.h"
+#include "lightgrep/api.h"
+
+namespace {
+  // every block the hooks hand out, and its size
+  struct Counts {
+    std::map<void*, size_t> Live;
+    size_t Allocs = 0, BadFrees = 0;
+  };
+
+  void* countAlloc(void* userData, size_t size) {
+    Counts* c = static_cast<Counts*>(userData);
+    void* p = std::malloc(size);
+    c->Live[p] = size;
+    ++c->Allocs;
+    return p;
+  }
+
+  void countFree(void* userData, void* p, size_t size) {
+    Counts* c = static_cast<Counts*>(userData);
+    const auto i = c->Live.find(p);
+    if (i == c->Live.end() || i->second != size) {
+      ++c->BadFrees;
+    }
+    else {
+      c->Live.erase(i);
+    }
+    std::free(p);
+  }
+
+  // restores the default allocator when the test ends
+  struct UseAllocator {
+    UseAllocator(const LG_Allocator& alloc) { lg_set_allocator(&alloc); }
+    ~UseAllocator() { lg_set_allocator(nullptr); }
+  };
+
+  struct Throws: public HookAllocated<Throws> {
+    Throws() { throw std::runtime_error("ctor"); }
+    char Pad[40];
+  };
+}
+
+TEST_CASE("arenaAlignsAndGrows") {
+  Arena a;
+  char* prev = nullptr;
+  for (size_t i = 1; i < 5000; ++i) {
+    char* p = static_cast<char*>(a.alloc(i % 37 + 1, i % 2 ? 1 : 8));
+    if (i % 2 == 0) {
+      REQUIRE(0 == reinterpret_cast<uintptr_t>(p) % 8);
+    }
+    REQUIRE(p != prev);
+    std::memset(p, 0xFF, i % 37 + 1);
+    prev = p;
+  }
+
+  // bigger than any block
+  char* big = static_cast<char*>(a.alloc(Arena::BlockMax * 3));
+  std::memset(big, 0, Arena::BlockMax * 3);
+}
+
+TEST_CASE("allocatorHooksSeeEveryBlock") {
+  Counts counts;
+  {
+    UseAllocator use(LG_Allocator{countAlloc, countFree, &counts, 0});
+
+    const char* defEncs[] = { "ASCII", "UTF-16LE" };
+    const LG_KeyOptions opts{0, 0, 0};
+    LG_Error* err = nullptr;
+
+    std::unique_ptr<FSMHandle,void(*)(FSMHandle*)> fsm(
+      lg_create_fsm(0, 0),
+      lg_destroy_fsm
+    );
+    REQUIRE(-1 == lg_add_pattern_list(fsm.get(), "foo\nb[aeiou]+r\n(x", "test", defEncs, 2, &opts, &err));
+    REQUIRE(err);
+    REQUIRE(counts.Live.count(err));
+    lg_free_error(err);
+
+    const size_t before = counts.Allocs;
+    const LG_ProgramOptions progOpts{1, 1};
+    std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
+      lg_create_program(fsm.get(), &progOpts),
+      lg_destroy_program
+    );
+    REQUIRE(prog);
+    REQUIRE(counts.Live.count(prog.get()));
+    REQUIRE(counts.Allocs > before);
+
+    std::unique_ptr<ContextHandle,void(*)(ContextHandle*)> ctx(
+      lg_create_context(prog.get(), nullptr),
+      lg_destroy_context
+    );
+
+    const std::string text = "foo bar baaar";
+    LG_SearchHit* hits = nullptr;
+    size_t numHits = 0;
+    REQUIRE(lg_search_hits(ctx.get(), text.data(), text.data() + text.size(), 0, &hits, &numHits, &err));
+    REQUIRE(3 == numHits);
+    lg_free_hits(hits);
+  }
+
+  // everything was given back, at the size it was taken
+  REQUIRE(0 == counts.BadFrees);
+  REQUIRE(counts.Live.empty());
+}
+
+TEST_CASE("nothrowNewFreesThroughHooksIfCtorThrows") {
+  Counts counts;
+  {
+    UseAllocator use(LG_Allocator{countAlloc, countFree, &counts, 0});
+    REQUIRE_THROWS_AS(new (std::nothrow) Throws, std::runtime_error);
+  }
+
+  REQUIRE(1 == counts.Allocs);
+  REQUIRE(0 == counts.BadFrees);
+  REQUIRE(counts.Live.empty());
+}
+
+#ifdef __linux__
+TEST_CASE("allocLargeUsesHugePageBoundaries") {
+  const size_t huge = 2 << 20;
+  UseAllocator use(LG_Allocator{nullptr, nullptr, nullptr, huge});
+
+  for (size_t size: {huge, huge + 1, 3 * huge - 5}) {
+    char* p = static_cast<char*>(lgAllocLarge(size));
+    REQUIRE(0 == reinterpret_cast<uintptr_t>(p) % huge);
+    std::memset(p, 0x5A, size);
+    lgFreeLarge(p, size);
+  }
+
+  // smaller blocks come from the hooks
+  void* p = lgAllocLarge(100);
+  lgFreeLarge(p, 100);
+}
+
+TEST_CASE("freeLargeIgnoresLaterHugePageMin") {
+  const size_t huge = 2 << 20;
+  Counts counts;
+  UseAllocator use(LG_Allocator{countAlloc, countFree, &counts, huge});
+
+  // mapped, then freed after the threshold is raised past it
+  void* mapped = lgAllocLarge(huge);
+  REQUIRE(0 == counts.Allocs);
+  const LG_Allocator higher{countAlloc, countFree, &counts, 4 * huge};
+  lg_set_allocator(&higher);
+  lgFreeLarge(mapped, huge);
+  REQUIRE(0 == counts.BadFrees);
+
+  // from the hooks, then freed after the threshold is lowered under it
+  void* hooked = lgAllocLarge(huge);
+  REQUIRE(1 == counts.Allocs);
+  const LG_Allocator lower{countAlloc, countFree, &counts, huge / 2};
+  lg_set_allocator(&lower);
+  lgFreeLarge(hooked, huge);
+  REQUIRE(0 == counts.BadFrees);
+  REQUIRE(counts.Live.empty());
+}
+#endif
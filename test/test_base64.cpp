@@ -0,0 +1,212 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "lightgrep/api.h"
+#include "lightgrep/util.h"
+
+#include "decoders/base64decoder.h"
+#include "decoders/bytesource.h"
+#include "handles.h"
+
+namespace {
+  std::string encode(const std::string& s) {
+    const char alpha[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string out;
+    for (size_t i = 0; i < s.size(); i += 3) {
+      const size_t n = std::min<size_t>(3, s.size() - i);
+      uint32_t g = 0;
+      for (size_t j = 0; j < 3; ++j) {
+        g = (g << 8) | (j < n ? static_cast<byte>(s[i + j]) : 0);
+      }
+      for (size_t j = 0; j < 4; ++j) {
+        out += j <= n ? alpha[(g >> (18 - 6*j)) & 63] : '=';
+      }
+    }
+    return out;
+  }
+
+  struct Hits {
+    std::vector<LG_SearchHit> V;
+
+    static void collect(void* userData, const LG_SearchHit* const hit) {
+      static_cast<Hits*>(userData)->V.push_back(*hit);
+    }
+  };
+
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> makeProgram(const char* pat, const char* chain) {
+    std::unique_ptr<PatternHandle,void(*)(PatternHandle*)> p(
+      lg_create_pattern(), lg_destroy_pattern
+    );
+    std::unique_ptr<FSMHandle,void(*)(FSMHandle*)> fsm(
+      lg_create_fsm(0, 0), lg_destroy_fsm
+    );
+
+    const LG_KeyOptions keyOpts{0, 0, 0};
+    LG_Error* err = nullptr;
+    lg_parse_pattern(p.get(), pat, &keyOpts, &err);
+    REQUIRE(!err);
+    REQUIRE(0 == lg_add_pattern(fsm.get(), p.get(), chain, 0, &err));
+    REQUIRE(!err);
+
+    const LG_ProgramOptions progOpts{10, 1};
+    return std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)>(
+      lg_create_program(fsm.get(), &progOpts), lg_destroy_program
+    );
+  }
+
+  std::vector<LG_SearchHit> search(LG_HPROGRAM prog, const std::string& s) {
+    std::shared_ptr<ContextHandle> ctx(
+      lg_create_context(prog, nullptr), lg_destroy_context
+    );
+
+    Hits hits;
+    lg_search(ctx.get(), s.data(), s.data() + s.size(), 0, &hits, Hits::collect);
+    lg_closeout_search(ctx.get(), &hits, Hits::collect);
+    return hits.V;
+  }
+}
+
+TEST_CASE("base64DecoderNext") {
+  const std::string enc = encode("Man is");
+  REQUIRE("TWFuIGlz" == enc);
+
+  const byte* b = reinterpret_cast<const byte*>(enc.data());
+  Base64Decoder dec{ByteSource(b, b + enc.size())};
+
+  // each byte is reported at the character which completes it
+  const std::pair<int32_t,const byte*> expected[] = {
+    {'M', b+1}, {'a', b+2}, {'n', b+3}, {' ', b+5}, {'i', b+6}, {'s', b+7}
+  };
+  for (const auto& e: expected) {
+    REQUIRE(e == dec.next());
+  }
+  REQUIRE(Decoder::END == dec.next().first);
+
+  // padding is bad, and starts a new group
+  const byte pad[] = "TQ==TWE";
+  dec.reset(pad, pad + 7);
+  REQUIRE(std::make_pair(int32_t('M'), pad+1) == dec.next());
+  REQUIRE(std::make_pair(-'='-1, pad+2) == dec.next());
+  REQUIRE(std::make_pair(-'='-1, pad+3) == dec.next());
+  REQUIRE(std::make_pair(int32_t('M'), pad+5) == dec.next());
+  REQUIRE(std::make_pair(int32_t('a'), pad+6) == dec.next());
+  REQUIRE(Decoder::END == dec.next().first);
+}
+
+TEST_CASE("base64PatternEveryAlignment") {
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
+    makeProgram("hel+o", "ASCII|Base64")
+  );
+  REQUIRE(prog);
+
+  std::unique_ptr<DecoderHandle,void(*)(DecoderHandle*)> hdec(
+    lg_create_decoder(), lg_destroy_decoder
+  );
+
+  std::mt19937 rng(5);
+  for (size_t pre = 0; pre < 6; ++pre) {
+    for (const std::string word: {"helo", "hello", "helllo"}) {
+      for (size_t post = 0; post < 4; ++post) {
+        std::string plain;
+        for (size_t i = 0; i < pre; ++i) {
+          plain += static_cast<char>('0' + rng() % 10);
+        }
+        plain += word;
+        for (size_t i = 0; i < post; ++i) {
+          plain += static_cast<char>('0' + rng() % 10);
+        }
+
+        const std::string enc = encode(plain);
+        INFO(plain << ' ' << enc);
+
+        // the hit begins with the group holding the first byte and ends
+        // with the character holding the last bits of the last byte
+        const uint64_t start = pre / 3 * 4;
+        const uint64_t end = (8 * (pre + word.size()) + 5) / 6;
+
+        const std::vector<LG_SearchHit> hits = search(prog.get(), enc);
+        REQUIRE(1 == hits.size());
+        REQUIRE(start == hits[0].Start);
+        REQUIRE(end == hits[0].End);
+
+        // and decodes to the match, after the group's bytes before it
+        const LG_Window inner{hits[0].Start, hits[0].End};
+        LG_Window outer, dh;
+        const char* utf8 = nullptr;
+        LG_Error* err = nullptr;
+        lg_hit_context(
+          hdec.get(), enc.data(), enc.data() + enc.size(), 0, &inner,
+          "ASCII|Base64", 0, 0xFFFD, &utf8, &outer, &dh, &err
+        );
+        REQUIRE(!err);
+        REQUIRE(plain.substr(pre / 3 * 3, pre % 3 + word.size()) == utf8);
+        lg_free_hit_context_string(utf8);
+      }
+    }
+  }
+}
+
+TEST_CASE("base64PatternClassesAndNonMatches") {
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
+    makeProgram("x[0-9]{3}y", "ASCII|Base64")
+  );
+  REQUIRE(prog);
+
+  for (size_t pre = 0; pre < 3; ++pre) {
+    const std::string p(pre, '_');
+    REQUIRE(1 == search(prog.get(), encode(p + "x123y")).size());
+    REQUIRE(1 == search(prog.get(), encode(p + "x907y...")).size());
+    REQUIRE(search(prog.get(), encode(p + "x12y")).empty());
+    REQUIRE(search(prog.get(), encode(p + "x1234y")).empty());
+    REQUIRE(search(prog.get(), encode(p + "x12ay")).empty());
+  }
+
+  // the plain text is not matched
+  REQUIRE(search(prog.get(), "x123y").empty());
+}
+
+TEST_CASE("base64MustBeLastTransform") {
+  std::unique_ptr<PatternHandle,void(*)(PatternHandle*)> p(
+    lg_create_pattern(), lg_destroy_pattern
+  );
+  std::unique_ptr<FSMHandle,void(*)(FSMHandle*)> fsm(
+    lg_create_fsm(0, 0), lg_destroy_fsm
+  );
+
+  const LG_KeyOptions keyOpts{0, 0, 0};
+  LG_Error* err = nullptr;
+  lg_parse_pattern(p.get(), "abc", &keyOpts, &err);
+  REQUIRE(!err);
+
+  REQUIRE(0 > lg_add_pattern(fsm.get(), p.get(), "ASCII|Base64|OCE", 0, &err));
+  REQUIRE(err);
+  lg_free_error(err);
+  err = nullptr;
+
+  REQUIRE(0 == lg_add_pattern(fsm.get(), p.get(), "UTF-16LE|OCE|base64", 0, &err));
+  REQUIRE(!err);
+}
@@ -20,14 +20,21 @@
 #include "lightgrep/api.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
 
 #include <iostream>
 
 #include "pattern_map.h"
 #include "stest.h"
 #include "handles.h"
+#include "program.h"
 
 // #include "basic.h"
 
@@ -47,6 +54,7 @@ TEST_CASE("testDedupeOnDiffEncodings") {
 
   LG_ProgramOptions progOpts;
   progOpts.DeterminizeDepth = std::numeric_limits<uint32_t>::max();
+  progOpts.Partitions = 1;
 
   std::shared_ptr<ProgramHandle> prog(
     lg_create_program(parser.get(), &progOpts),
@@ -152,6 +160,10 @@ TEST_CASE("testDestroyPatternWithNull") {
   lg_destroy_pattern(nullptr);
 }
 
+TEST_CASE("testContextDroppedThreadsWithNull") {
+  REQUIRE(0u == lg_context_dropped_threads(nullptr));
+}
+
 TEST_CASE("testParsePatternWithNull") {
   LG_KeyOptions keyOpts;
   LG_Error* errPtr = nullptr;
@@ -315,7 +327,7 @@ TEST_CASE("testLgAddPatternListCRLFHeck") {
     REQUIRE(!std::strcmp(exp_pats[i], pi->Pattern));
   }
 
-  const LG_ProgramOptions progOpts{0xFFFFFFFF};
+  const LG_ProgramOptions progOpts{0xFFFFFFFF, 1};
   std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
     lg_create_program(fsm.get(), &progOpts),
     lg_destroy_program
@@ -414,7 +426,7 @@ TEST_CASE("testLgAddPatternListCopyOnWritePatternMap") {
   REQUIRE(lg_fsm_pattern_count(fsm.get()) == 1);
 
   // make a program
-  const LG_ProgramOptions progOpts{0xFFFFFFFF};
+  const LG_ProgramOptions progOpts{0xFFFFFFFF, 1};
   std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog1(
     lg_create_program(fsm.get(), &progOpts),
     lg_destroy_program
@@ -483,7 +495,7 @@ TEST_CASE("testLgWriteProgramLgReadProgram") {
   std::unique_ptr<LG_Error,void(*)(LG_Error*)> e{err, lg_free_error};
   REQUIRE(!err);
 
-  const LG_ProgramOptions progOpts{0xFFFFFFFF};
+  const LG_ProgramOptions progOpts{0xFFFFFFFF, 1};
   std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog1(
     lg_create_program(fsm.get(), &progOpts),
     lg_destroy_program
@@ -556,3 +568,982 @@ TEST_CASE("testLgWriteProgramLgReadProgram") {
   lg_search(ctx.get(), s.data(), s.data() + s.size(), 0, &numHits, gotHit);
   REQUIRE(numHits == 2);
 }
+
+TEST_CASE("testLgAnalyzePattern") {
+  std::unique_ptr<FSMHandle,void(*)(FSMHandle*)> fsm(
+    lg_create_fsm(0, 0),
+    lg_destroy_fsm
+  );
+
+  const char* patterns = "a+b\n.+\tISO-8859-1\nabcd";
+  const char* defEnc[] = { "ASCII" };
+  LG_KeyOptions keyOpts{0, 0, 0};
+  LG_Error* err = nullptr;
+
+  lg_add_pattern_list(fsm.get(), patterns, "", defEnc, 1, &keyOpts, &err);
+  REQUIRE(!err);
+  REQUIRE(3u == lg_fsm_pattern_count(fsm.get()));
+
+  LG_PatternStats aplusb, dotplus, abcd;
+  REQUIRE(lg_analyze_pattern(fsm.get(), 0, &aplusb, &err) > 0);
+  REQUIRE(lg_analyze_pattern(fsm.get(), 1, &dotplus, &err) > 0);
+  REQUIRE(lg_analyze_pattern(fsm.get(), 2, &abcd, &err) > 0);
+  REQUIRE(!err);
+
+  REQUIRE(1u == aplusb.MaxFanOut);
+  REQUIRE(1u == aplusb.Loops);
+  REQUIRE(2u == aplusb.MinLength);
+  REQUIRE(2u == aplusb.FilterPairs);
+  REQUIRE(!aplusb.DefeatsPrefilter);
+
+  REQUIRE(1u == dotplus.Loops);
+  REQUIRE(1u == dotplus.MinLength);
+  REQUIRE(256u*256u == dotplus.FilterPairs);
+  REQUIRE(dotplus.DefeatsPrefilter);
+
+  REQUIRE(0u == abcd.Loops);
+  REQUIRE(4u == abcd.MinLength);
+  REQUIRE(1u == abcd.FilterPairs);
+
+  REQUIRE(dotplus.Cost > aplusb.Cost);
+  REQUIRE(aplusb.Cost > abcd.Cost);
+
+  // out of range
+  REQUIRE(0 == lg_analyze_pattern(fsm.get(), 3, &abcd, &err));
+  REQUIRE(err);
+  lg_free_error(err);
+  err = nullptr;
+
+  // compiling the program rewrites the FSM, after which analysis is refused
+  LG_ProgramOptions progOpts{0, 1};
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
+    lg_create_program(fsm.get(), &progOpts),
+    lg_destroy_program
+  );
+  REQUIRE(prog);
+
+  REQUIRE(0 == lg_analyze_pattern(fsm.get(), 0, &aplusb, &err));
+  REQUIRE(err);
+  lg_free_error(err);
+}
+
+TEST_CASE("testLgAnalyzeDuplicatePattern") {
+  std::unique_ptr<FSMHandle,void(*)(FSMHandle*)> fsm(
+    lg_create_fsm(0, 0),
+    lg_destroy_fsm
+  );
+
+  const char* patterns = "a+b\nabcd\na+b";
+  const char* defEnc[] = { "ASCII" };
+  LG_KeyOptions keyOpts{0, 0, 0};
+  LG_Error* err = nullptr;
+
+  lg_add_pattern_list(fsm.get(), patterns, "", defEnc, 1, &keyOpts, &err);
+  REQUIRE(!err);
+  REQUIRE(3u == lg_fsm_pattern_count(fsm.get()));
+
+  LG_PatternStats orig, dup;
+  REQUIRE(lg_analyze_pattern(fsm.get(), 0, &orig, &err) > 0);
+  REQUIRE(lg_analyze_pattern(fsm.get(), 2, &dup, &err) > 0);
+  REQUIRE(!err);
+
+  REQUIRE(orig.MaxFanOut == dup.MaxFanOut);
+  REQUIRE(orig.Loops == dup.Loops);
+  REQUIRE(orig.MinLength == dup.MinLength);
+  REQUIRE(orig.FilterPairs == dup.FilterPairs);
+  REQUIRE(orig.DefeatsPrefilter == dup.DefeatsPrefilter);
+  REQUIRE(orig.Cost == dup.Cost);
+}
+
+namespace {
+  void collectHit(void* ctx, const LG_SearchHit* const hit) {
+    static_cast<std::vector<SearchHit>*>(ctx)->emplace_back(*hit);
+  }
+
+  std::vector<SearchHit> searchAll(LG_HPROGRAM prog, const std::string& s) {
+    std::shared_ptr<ContextHandle> ctx(
+      lg_create_context(prog, nullptr),
+      lg_destroy_context
+    );
+
+    std::vector<SearchHit> hits;
+    lg_search(ctx.get(), s.data(), s.data() + s.size(), 0, &hits, collectHit);
+    lg_closeout_search(ctx.get(), &hits, collectHit);
+    std::sort(hits.begin(), hits.end());
+    return hits;
+  }
+
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> makeProgram(const char* pats, uint32_t partitions) {
+    const char* defEncs[] = { "ASCII", "UTF-16LE" };
+    const LG_KeyOptions defOpts{0, 0, 0};
+
+    std::unique_ptr<FSMHandle,void(*)(FSMHandle*)> fsm(
+      lg_create_fsm(0, 0),
+      lg_destroy_fsm
+    );
+
+    LG_Error* err = nullptr;
+    lg_add_pattern_list(
+      fsm.get(), pats, "makeProgram", defEncs, 2, &defOpts, &err
+    );
+    REQUIRE(!err);
+
+    const LG_ProgramOptions progOpts{10, partitions};
+    return std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)>(
+      lg_create_program(fsm.get(), &progOpts),
+      lg_destroy_program
+    );
+  }
+}
+
+TEST_CASE("testPartitionedProgramMatchesSingleProgram") {
+  const char pats[] =
+    "foo\n"
+    "fo+b\n"
+    "bar\n"
+    "ba[rz]+\n"
+    "qu+x\n"
+    "\\d{3}-\\d{4}\n"
+    "a.c\n";
+
+  const char text[] =
+    "foob fooob barzz quux 555-1234 abc foo bar"
+    "f\0o\0o\0b\0a\0r\0";
+  const std::string s(text, sizeof(text) - 1);
+
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> single(
+    makeProgram(pats, 1)
+  );
+  REQUIRE(single);
+  REQUIRE(single->Prog);
+
+  const std::vector<SearchHit> expected(searchAll(single.get(), s));
+  REQUIRE(!expected.empty());
+
+  for (uint32_t k: {2, 3, 100}) {
+    std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> parted(
+      makeProgram(pats, k)
+    );
+    REQUIRE(parted);
+    REQUIRE(!parted->Prog);
+    REQUIRE(std::min(k, 14u) == parted->Parts.size());
+
+    REQUIRE(expected == searchAll(parted.get(), s));
+
+    // partitioned programs survive serialization
+    const size_t psize = lg_program_size(parted.get());
+    std::unique_ptr<char[]> buf(new char[psize]);
+    lg_write_program(parted.get(), buf.get());
+
+    std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> copy(
+      lg_read_program(buf.get(), psize),
+      lg_destroy_program
+    );
+    REQUIRE(copy);
+    REQUIRE(parted->PartLabels == copy->PartLabels);
+    REQUIRE(psize == lg_program_size(copy.get()));
+
+    REQUIRE(expected == searchAll(copy.get(), s));
+  }
+}
+
+TEST_CASE("testDuplicatePatternsShareAutomaton") {
+  const char* defEncs[] = { "ASCII", "UTF-16LE" };
+  const LG_KeyOptions defOpts{0, 0, 0};
+
+  // labels 4 and 6 are duplicates of 0, and 5 and 7 of 1
+  const char pats[] =
+    "foo\n"
+    "ba[rz]+\n"
+    "foo\n"
+    "(foo)\n";
+
+  std::unique_ptr<FSMHandle,void(*)(FSMHandle*)> fsm(
+    lg_create_fsm(0, 0),
+    lg_destroy_fsm
+  );
+
+  std::unique_ptr<FSMHandle,void(*)(FSMHandle*)> distinct(
+    lg_create_fsm(0, 0),
+    lg_destroy_fsm
+  );
+
+  LG_Error* err = nullptr;
+  lg_add_pattern_list(fsm.get(), pats, "dups", defEncs, 2, &defOpts, &err);
+  REQUIRE(!err);
+  lg_add_pattern_list(distinct.get(), "foo\nba[rz]+\n", "distinct", defEncs, 2, &defOpts, &err);
+  REQUIRE(!err);
+
+  REQUIRE(8 == lg_fsm_pattern_count(fsm.get()));
+  REQUIRE(distinct->Impl->Fsm->verticesSize() == fsm->Impl->Fsm->verticesSize());
+
+  const uint32_t originals[] = { 0, 1, 2, 3, 0, 1, 0, 1 };
+  for (uint32_t i = 0; i < 8; ++i) {
+    REQUIRE(originals[i] == fsm->PMap->original(i));
+  }
+
+  const char text[] =
+    "foo barz f\0o\0o\0 b\0a\0r\0 foofoo";
+  const std::string s(text, sizeof(text) - 1);
+
+  // partitioning leaves the graph as it was, so comes first
+  for (uint32_t k: {3, 1}) {
+    const LG_ProgramOptions progOpts{10, k};
+    std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
+      lg_create_program(fsm.get(), &progOpts),
+      lg_destroy_program
+    );
+    REQUIRE(prog);
+
+    // each duplicate has the hits of its original
+    std::vector<std::vector<std::pair<uint64_t,uint64_t>>> spans(8);
+    for (const SearchHit& h: searchAll(prog.get(), s)) {
+      spans[h.KeywordIndex].emplace_back(h.Start, h.End);
+    }
+
+    REQUIRE(3 == spans[0].size());
+    REQUIRE(1 == spans[1].size());
+    for (uint32_t i = 0; i < 8; ++i) {
+      REQUIRE(spans[originals[i]] == spans[i]);
+    }
+
+    // and still has them after serialization
+    const size_t psize = lg_program_size(prog.get());
+    std::unique_ptr<char[]> buf(new char[psize]);
+    lg_write_program(prog.get(), buf.get());
+
+    std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> copy(
+      lg_read_program(buf.get(), psize),
+      lg_destroy_program
+    );
+    REQUIRE(copy);
+    REQUIRE(searchAll(prog.get(), s) == searchAll(copy.get(), s));
+  }
+}
+
+TEST_CASE("testLgSearchZerosMatchesSearchingZeros") {
+  const char* const patSets[] = {
+    "ab\n"
+    "a[^b]*b\n"
+    "a\\x00+\n"
+    "\\x00{3}c\n"
+    "z\\x00*y\n",
+
+    // each zero is a hit
+    "\\x00\n",
+    ".\n",
+    "[\\x00-\\x05]\n"
+    "z\\x00*y\n"
+  };
+
+  const std::string pre("xxaz"), post("\0\0cb y", 6);
+  const size_t zlen = 10000;
+
+  std::string whole(pre);
+  whole.append(zlen, '\0');
+  whole.append(post);
+
+  for (const char* pats: patSets) {
+    INFO(pats);
+
+    // partitioning leaves the graph as it was, so comes first
+    for (uint32_t k: {3, 1}) {
+      std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
+        makeProgram(pats, k)
+      );
+      REQUIRE(prog);
+
+      const std::vector<SearchHit> expected(searchAll(prog.get(), whole));
+      REQUIRE(!expected.empty());
+
+      std::shared_ptr<ContextHandle> ctx(
+        lg_create_context(prog.get(), nullptr),
+        lg_destroy_context
+      );
+
+      std::vector<SearchHit> actual;
+      lg_search(ctx.get(), pre.data(), pre.data() + pre.size(), 0, &actual, collectHit);
+      lg_search_zeros(ctx.get(), zlen, pre.size(), &actual, collectHit);
+      lg_search(ctx.get(), post.data(), post.data() + post.size(), pre.size() + zlen, &actual, collectHit);
+      lg_closeout_search(ctx.get(), &actual, collectHit);
+      std::sort(actual.begin(), actual.end());
+
+      REQUIRE(expected == actual);
+    }
+  }
+}
+
+TEST_CASE("testLgStartsWithBatchMatchesOneAtATime") {
+  const char pats[] =
+    "foo\n"
+    "fo+b\n"
+    "a+\n"
+    "a+b\n"
+    "\\d{3}-\\d{4}\n"
+    "a.c\n";
+
+  const char text[] =
+    "foob aaab abc 555-1234 fooob aaaa"
+    "f\0o\0o\0b\0a\0a\0";
+  const std::string s(text, sizeof(text) - 1);
+
+  // every offset, some twice, out of order, and past the end
+  std::vector<uint64_t> offsets;
+  for (uint64_t i = 0; i < s.size(); ++i) {
+    offsets.push_back(i);
+  }
+  offsets.insert(offsets.end(), {6, 5, 0, s.size(), s.size() + 10});
+
+  // partitioning leaves the graph as it was, so comes first
+  for (uint32_t k: {3, 1}) {
+    std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
+      makeProgram(pats, k)
+    );
+    REQUIRE(prog);
+
+    std::shared_ptr<ContextHandle> ctx(
+      lg_create_context(prog.get(), nullptr),
+      lg_destroy_context
+    );
+
+    std::vector<SearchHit> expected;
+    for (const uint64_t off: offsets) {
+      if (off < s.size()) {
+        lg_starts_with(ctx.get(), s.data() + off, s.data() + s.size(), 100 + off, &expected, collectHit);
+      }
+    }
+    std::sort(expected.begin(), expected.end());
+
+    std::vector<SearchHit> actual;
+    lg_starts_with_batch(ctx.get(), s.data(), s.data() + s.size(), 100, offsets.data(), offsets.size(), &actual, collectHit);
+    std::sort(actual.begin(), actual.end());
+
+    REQUIRE(expected == actual);
+
+    // overlapping matches of a+ from different offsets are all found
+    for (uint64_t start: {105, 106, 107}) {
+      REQUIRE(std::find(actual.begin(), actual.end(), SearchHit(start, 108, 4)) != actual.end());
+    }
+
+    // and the context is left ready for another search
+    std::vector<SearchHit> again;
+    lg_starts_with(ctx.get(), s.data(), s.data() + s.size(), 0, &again, collectHit);
+    REQUIRE(!again.empty());
+    REQUIRE(0 == again.front().Start);
+  }
+}
+
+namespace {
+  typedef std::tuple<uint64_t,uint64_t,uint32_t,uint32_t> XorHit;
+
+  void collectXorHit(void* ctx, const LG_XorSearchHit* const hit) {
+    static_cast<std::vector<XorHit>*>(ctx)->emplace_back(
+      hit->Hit.Start, hit->Hit.End, hit->Hit.KeywordIndex, hit->Key
+    );
+  }
+
+  std::unique_ptr<FSMHandle,void(*)(FSMHandle*)> makeFsm(const char* pats, uint32_t numEncs = 2) {
+    const char* defEncs[] = { "ASCII", "UTF-16LE" };
+    const LG_KeyOptions defOpts{0, 0, 0};
+
+    std::unique_ptr<FSMHandle,void(*)(FSMHandle*)> fsm(
+      lg_create_fsm(0, 0),
+      lg_destroy_fsm
+    );
+
+    LG_Error* err = nullptr;
+    lg_add_pattern_list(
+      fsm.get(), pats, "makeFsm", defEncs, numEncs, &defOpts, &err
+    );
+    REQUIRE(!err);
+    return fsm;
+  }
+}
+
+TEST_CASE("testLgSearchXorMatchesEveryKey") {
+  const char pats[] =
+    "foo\n"
+    "hello world\n"
+    "ab\n"
+    "x\\d{2}y\n"
+    "a.c\n";
+
+  // random bytes, with the patterns planted under various keys
+  std::mt19937 rng(7);
+  std::string s(20000, '\0');
+  for (char& c: s) {
+    c = rng();
+  }
+
+  const std::string plants[] = { "foo", "hello world", "ab", "x42y", "aZc", std::string("f\0o\0o\0", 6) };
+  for (uint32_t i = 0; i < 200; ++i) {
+    const std::string& p = plants[i % 6];
+    const char key = i % 7 ? rng() : 0;
+    const size_t off = 100 * i;
+    for (size_t j = 0; j < p.size(); ++j) {
+      s[off + j] = p[j] ^ key;
+    }
+  }
+
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> plain(
+    makeProgram(pats, 1)
+  );
+  REQUIRE(plain);
+
+  // the text under each key, searched plainly
+  std::vector<XorHit> expected;
+  for (uint32_t key = 0; key < 256; ++key) {
+    std::string d(s);
+    for (char& c: d) {
+      c ^= key;
+    }
+    for (const SearchHit& h: searchAll(plain.get(), d)) {
+      // a match of one byte has no differences to be found by
+      if (h.length() > 1) {
+        expected.emplace_back(h.Start, h.End, h.KeywordIndex, key);
+      }
+    }
+  }
+  std::sort(expected.begin(), expected.end());
+  REQUIRE(expected.size() >= 200);
+
+  const LG_ProgramOptions progOpts{10, 1};
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
+    lg_create_xor_program(makeFsm(pats).get(), &progOpts),
+    lg_destroy_program
+  );
+  REQUIRE(prog);
+  REQUIRE(prog->Diff);
+
+  // the program survives serialization
+  const size_t psize = lg_program_size(prog.get());
+  std::unique_ptr<char[]> buf(new char[psize]);
+  lg_write_program(prog.get(), buf.get());
+
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> read(
+    lg_read_program(buf.get(), psize),
+    lg_destroy_program
+  );
+  REQUIRE(read);
+  REQUIRE(read->Diff);
+  REQUIRE(prog->XorFirst == read->XorFirst);
+  // "hello world" in UTF-16LE
+  REQUIRE(22 == read->XorMaxLen);
+
+  for (LG_HPROGRAM p: {prog.get(), read.get()}) {
+    std::shared_ptr<ContextHandle> ctx(
+      lg_create_context(p, nullptr),
+      lg_destroy_context
+    );
+
+    std::vector<XorHit> actual;
+    lg_search_xor(ctx.get(), s.data(), s.data() + s.size(), 0, &actual, collectXorHit);
+    REQUIRE(std::is_sorted(actual.begin(), actual.end(),
+      [](const XorHit& a, const XorHit& b) {
+        return std::get<0>(a) < std::get<0>(b);
+      }
+    ));
+    std::sort(actual.begin(), actual.end());
+
+    REQUIRE(expected == actual);
+  }
+}
+
+TEST_CASE("testLgSearchXorMatchesSearchingEachKeyRandomly") {
+  // patterns whose matches vary in length, in text made mostly of the
+  // bytes they match, under a few keys
+  const char* const patSets[] = {
+    ".\\d\n",
+    ".\n",
+    "a{1,8}b\n\\d{2}\n",
+    "x.y\nab|ba\n[a-c]{2,3}\n"
+  };
+  const byte alphabet[] = { 'A', '1', '2', 'a', 'b', 'c', 'x', 'y', 0, 0, 0xD8, 0xDC };
+
+  std::mt19937 rng(43);
+  for (uint32_t n = 0; n < 240; ++n) {
+    const char* pats = patSets[n % 4];
+
+    std::string s(rng() % 64 + 2, '\0');
+    for (char& c: s) {
+      c = alphabet[rng() % sizeof(alphabet)];
+    }
+    for (size_t i = 0, len; i < s.size(); i += len) {
+      len = rng() % 16 + 1;
+      const char key = rng() % 3 ? 0 : rng() % 4;
+      for (size_t j = i; j < std::min(i + len, s.size()); ++j) {
+        s[j] ^= key;
+      }
+    }
+
+    INFO(pats);
+    INFO(n);
+
+    std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> plain(
+      makeProgram(pats, 1)
+    );
+    REQUIRE(plain);
+
+    std::vector<XorHit> expected;
+    for (uint32_t key = 0; key < 256; ++key) {
+      std::string d(s);
+      for (char& c: d) {
+        c ^= key;
+      }
+      for (const SearchHit& h: searchAll(plain.get(), d)) {
+        if (h.length() > 1) {
+          expected.emplace_back(h.Start, h.End, h.KeywordIndex, key);
+        }
+      }
+    }
+    std::sort(expected.begin(), expected.end());
+
+    const LG_ProgramOptions progOpts{10, 1};
+    std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
+      lg_create_xor_program(makeFsm(pats).get(), &progOpts),
+      lg_destroy_program
+    );
+    REQUIRE(prog);
+
+    std::shared_ptr<ContextHandle> ctx(
+      lg_create_context(prog.get(), nullptr),
+      lg_destroy_context
+    );
+
+    std::vector<XorHit> actual;
+    lg_search_xor(ctx.get(), s.data(), s.data() + s.size(), 0, &actual, collectXorHit);
+    std::sort(actual.begin(), actual.end());
+
+    REQUIRE(expected == actual);
+  }
+}
+
+TEST_CASE("testLgCreateXorProgramOneByteMatches") {
+  const LG_ProgramOptions progOpts{10, 1};
+
+  // nothing would be left to search for
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> none(
+    lg_create_xor_program(makeFsm("a\n[bc]\n", 1).get(), &progOpts),
+    lg_destroy_program
+  );
+  REQUIRE(!none);
+
+  // a pattern which may match one byte or more is found when longer
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
+    lg_create_xor_program(makeFsm("ab{0,4}\n", 1).get(), &progOpts),
+    lg_destroy_program
+  );
+  REQUIRE(prog);
+
+  std::shared_ptr<ContextHandle> ctx(
+    lg_create_context(prog.get(), nullptr),
+    lg_destroy_context
+  );
+
+  // "a", then "abb" under key 1
+  const std::string s("za`cc");
+  std::vector<XorHit> actual;
+  lg_search_xor(ctx.get(), s.data(), s.data() + s.size(), 10, &actual, collectXorHit);
+  REQUIRE(std::vector<XorHit>{XorHit(12, 15, 0, 1)} == actual);
+}
+
+TEST_CASE("testLgCreateXorProgramUnboundedMatches") {
+  const LG_ProgramOptions progOpts{10, 1};
+  for (const char* pats: {"a.*b\n", "foo\nab+\n"}) {
+    std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
+      lg_create_xor_program(makeFsm(pats, 1).get(), &progOpts),
+      lg_destroy_program
+    );
+    REQUIRE(!prog);
+  }
+}
+
+TEST_CASE("testLgSearchXorTimeIsNearLinear") {
+  const LG_ProgramOptions progOpts{10, 1};
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
+    lg_create_xor_program(makeFsm("a.{0,30}b\n", 1).get(), &progOpts),
+    lg_destroy_program
+  );
+  REQUIRE(prog);
+  REQUIRE(32 == prog->XorMaxLen);
+
+  std::shared_ptr<ContextHandle> ctx(
+    lg_create_context(prog.get(), nullptr),
+    lg_destroy_context
+  );
+
+  // text in which nearly every offset begins a candidate under some key
+  const auto timeSearch = [&ctx](size_t len) {
+    std::mt19937 rng(5);
+    std::string s(len, '\0');
+    for (char& c: s) {
+      c = "ab"[rng() % 2];
+    }
+
+    std::vector<XorHit> actual;
+    const auto start = std::chrono::steady_clock::now();
+    lg_search_xor(ctx.get(), s.data(), s.data() + s.size(), 0, &actual, collectXorHit);
+    const auto stop = std::chrono::steady_clock::now();
+    REQUIRE(!actual.empty());
+    return std::chrono::duration<double>(stop - start).count();
+  };
+
+  // four times the text should take about four times as long, not sixteen
+  const double small = timeSearch(20000), big = timeSearch(80000);
+  REQUIRE(big < 8 * std::max(small, 0.001));
+}
+
+TEST_CASE("testLgSearchXorPlainProgram") {
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
+    makeProgram("foo\n", 1)
+  );
+  std::shared_ptr<ContextHandle> ctx(
+    lg_create_context(prog.get(), nullptr),
+    lg_destroy_context
+  );
+
+  // not an XOR program, so there is nothing to report
+  const std::string s("foo");
+  std::vector<XorHit> actual;
+  lg_search_xor(ctx.get(), s.data(), s.data() + s.size(), 0, &actual, collectXorHit);
+  REQUIRE(actual.empty());
+}
+
+TEST_CASE("testLgSearchWideFilterFindsEveryAlignment") {
+  const char* pats[] = { "foo", "hello", "wide", "ab" };
+  const char* encs[] = { "UTF-16LE" };
+  const LG_KeyOptions opts{1, 0, 0};
+
+  std::unique_ptr<FSMHandle,void(*)(FSMHandle*)> fsm(
+    lg_create_fsm(0, 0),
+    lg_destroy_fsm
+  );
+
+  std::unique_ptr<PatternHandle,void(*)(PatternHandle*)> pat(
+    lg_create_pattern(),
+    lg_destroy_pattern
+  );
+
+  LG_Error* err = nullptr;
+  for (uint32_t i = 0; i < 4; ++i) {
+    REQUIRE(lg_parse_pattern(pat.get(), pats[i], &opts, &err));
+    REQUIRE(0 <= lg_add_pattern(fsm.get(), pat.get(), encs[0], i, &err));
+  }
+  REQUIRE(!err);
+
+  const LG_ProgramOptions progOpts{10, 1};
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
+    lg_create_program(fsm.get(), &progOpts),
+    lg_destroy_program
+  );
+  REQUIRE(prog);
+  REQUIRE(2u == prog->Prog->FilterStride);
+
+  // wide text, with the patterns planted at even and odd offsets
+  std::mt19937 rng(47);
+  std::string s;
+  std::vector<SearchHit> expected;
+  for (uint32_t i = 0; i < 400; ++i) {
+    for (uint32_t j = rng() % 20; j > 0; --j) {
+      s += 'q' + rng() % 8;
+      s += '\0';
+    }
+    if (i % 3 == 0) {
+      s += '\0';
+    }
+
+    const std::string p(pats[i % 4]);
+    expected.emplace_back(s.size(), s.size() + 2*p.size(), i % 4);
+    for (const char c : p) {
+      s += c;
+      s += '\0';
+    }
+  }
+
+  std::sort(expected.begin(), expected.end());
+  REQUIRE(expected == searchAll(prog.get(), s));
+}
+
+TEST_CASE("testLgStartsWithWideMatchFillingBuffer") {
+  const char* encs[] = { "UTF-16LE" };
+  const LG_KeyOptions opts{0, 0, 0};
+
+  std::unique_ptr<FSMHandle,void(*)(FSMHandle*)> fsm(
+    lg_create_fsm(0, 0),
+    lg_destroy_fsm
+  );
+
+  std::unique_ptr<PatternHandle,void(*)(PatternHandle*)> pat(
+    lg_create_pattern(),
+    lg_destroy_pattern
+  );
+
+  LG_Error* err = nullptr;
+  REQUIRE(lg_parse_pattern(pat.get(), "\\d", &opts, &err));
+  REQUIRE(0 <= lg_add_pattern(fsm.get(), pat.get(), encs[0], 0, &err));
+
+  const LG_ProgramOptions progOpts{10, 1};
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
+    lg_create_program(fsm.get(), &progOpts),
+    lg_destroy_program
+  );
+  REQUIRE(prog);
+
+  // key the filter across the zero, so that its window runs past a
+  // buffer holding only the match
+  Program& p = *prog->Prog;
+  p.FilterOff = 0;
+  p.FilterStride = 2;
+  p.Filter.reset();
+  for (uint32_t c = '0'; c <= '9'; ++c) {
+    for (uint32_t b = 0; b < 256; ++b) {
+      p.Filter.set(c | (b << 8));
+    }
+  }
+
+  std::shared_ptr<ContextHandle> ctx(
+    lg_create_context(prog.get(), nullptr),
+    lg_destroy_context
+  );
+
+  const std::string s("1\0", 2);
+  std::vector<SearchHit> actual;
+  lg_starts_with(ctx.get(), s.data(), s.data() + s.size(), 0, &actual, collectHit);
+  REQUIRE(std::vector<SearchHit>{SearchHit(0, 2, 0)} == actual);
+}
+
+namespace {
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> makeDelta(LG_HPROGRAM base, const char* pats, uint32_t partitions) {
+    const LG_ProgramOptions progOpts{10, partitions};
+    std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
+      lg_create_delta_program(base, makeFsm(pats).get(), &progOpts),
+      lg_destroy_program
+    );
+    REQUIRE(prog);
+    return prog;
+  }
+}
+
+TEST_CASE("testDeltaProgramMatchesFullProgram") {
+  const char pats1[] = "foo\nba[rz]+\n";
+  const char pats2[] = "qu+x\nfoo\n";
+  const char pats3[] = "\\d{3}-\\d{4}\na.c\nzz\n";
+
+  const char text[] =
+    "foob fooob barzz quux 555-1234 abc foo bar zzz"
+    "f\0o\0o\0b\0a\0r\0q\0u\0x\0";
+  const std::string s(text, sizeof(text) - 1);
+
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> base(
+    makeProgram(pats1, 1)
+  );
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> delta(
+    makeDelta(base.get(), pats2, 1)
+  );
+
+  // the base program's bytecode is shared, and the duplicate of one of
+  // its patterns gets its own index
+  REQUIRE(2 == delta->Parts.size());
+  REQUIRE(base->Prog == delta->Parts[0]);
+
+  const std::string pats12 = std::string(pats1) + pats2;
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> full(
+    makeProgram(pats12.c_str(), 1)
+  );
+
+  REQUIRE(lg_prog_pattern_count(full.get()) == lg_prog_pattern_count(delta.get()));
+  REQUIRE(!searchAll(full.get(), s).empty());
+  REQUIRE(searchAll(full.get(), s) == searchAll(delta.get(), s));
+
+  // a delta of a delta, itself partitioned; the base may go
+  base.reset();
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> delta2(
+    makeDelta(delta.get(), pats3, 2)
+  );
+  REQUIRE(4 == delta2->Parts.size());
+
+  const std::string pats123 = pats12 + pats3;
+  full = makeProgram(pats123.c_str(), 1);
+
+  const std::vector<SearchHit> expected(searchAll(full.get(), s));
+  REQUIRE(expected == searchAll(delta2.get(), s));
+
+  // deltas survive serialization
+  const size_t psize = lg_program_size(delta2.get());
+  std::unique_ptr<char[]> buf(new char[psize]);
+  lg_write_program(delta2.get(), buf.get());
+
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> copy(
+    lg_read_program(buf.get(), psize),
+    lg_destroy_program
+  );
+  REQUIRE(copy);
+  REQUIRE(expected == searchAll(copy.get(), s));
+}
+
+TEST_CASE("testDeltaProgramPartsAreCapped") {
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> prog(
+    makeProgram("foo\n", 1)
+  );
+
+  // each delta adds a part
+  for (uint32_t i = 1; i < 64; ++i) {
+    const std::string pat = "bar" + std::to_string(i) + "\n";
+    prog = makeDelta(prog.get(), pat.c_str(), 1);
+    REQUIRE(i + 1 == prog->Parts.size());
+  }
+
+  const LG_ProgramOptions progOpts{10, 1};
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> over(
+    lg_create_delta_program(prog.get(), makeFsm("baz\n").get(), &progOpts),
+    lg_destroy_program
+  );
+  REQUIRE(!over);
+
+  // foo, bar6, and bar63
+  const std::string s("foo bar63");
+  REQUIRE(3 == searchAll(prog.get(), s).size());
+}
+
+TEST_CASE("testSwapProgramAtBlockBoundary") {
+  const char pats1[] = "abc\\s*def\nxyz\n";
+  const char pats2[] = "def\n";
+
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> before(
+    makeProgram(pats1, 1)
+  );
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> after(
+    makeDelta(before.get(), pats2, 1)
+  );
+
+  // a match of the old patterns spans the boundary, and the new pattern
+  // occurs on both sides of it
+  const std::string block1 = "def xyz abc  ";
+  const std::string block2 = "  def xyz def";
+  const uint64_t boundary = block1.size();
+
+  std::shared_ptr<ContextHandle> ctx(
+    lg_create_context(before.get(), nullptr),
+    lg_destroy_context
+  );
+
+  std::vector<SearchHit> actual;
+  lg_search(ctx.get(), block1.data(), block1.data() + block1.size(), 0, &actual, collectHit);
+
+  LG_Error* err = nullptr;
+  REQUIRE(lg_swap_program(ctx.get(), after.get(), &err));
+  REQUIRE(!err);
+
+  lg_search(ctx.get(), block2.data(), block2.data() + block2.size(), boundary, &actual, collectHit);
+  lg_closeout_search(ctx.get(), &actual, collectHit);
+  std::sort(actual.begin(), actual.end());
+
+  // the hits over the whole input, but for those of the new pattern which
+  // begin before the swap
+  const std::string whole = block1 + block2;
+  std::vector<SearchHit> expected;
+  for (const SearchHit& h : searchAll(after.get(), whole)) {
+    if (h.KeywordIndex < lg_prog_pattern_count(before.get()) || h.Start >= boundary) {
+      expected.push_back(h);
+    }
+  }
+
+  REQUIRE(expected == actual);
+  REQUIRE(expected.end() != std::find(expected.begin(), expected.end(), SearchHit(8, 18, 0)));
+
+  // the old program has finished, and the next swap can come from another
+  // thread
+  actual.clear();
+  lg_reset_context(ctx.get());
+
+  std::thread swapper([&]() { lg_swap_program(ctx.get(), before.get(), nullptr); });
+  swapper.join();
+
+  lg_search(ctx.get(), whole.data(), whole.data() + whole.size(), 0, &actual, collectHit);
+  lg_closeout_search(ctx.get(), &actual, collectHit);
+  std::sort(actual.begin(), actual.end());
+  REQUIRE(searchAll(before.get(), whole) == actual);
+}
+
+TEST_CASE("testSwapProgramInsideMatch") {
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> before(
+    makeProgram("a+\n", 1)
+  );
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> after(
+    makeDelta(before.get(), "b\n", 1)
+  );
+
+  // the new program would begin its own match of a+ at the boundary,
+  // inside the old program's
+  for (const std::string& block2: {std::string("aaa"), std::string("aaab aa")}) {
+    INFO(block2);
+    const std::string block1 = "aaa";
+    const std::string whole = block1 + block2;
+
+    std::shared_ptr<ContextHandle> ctx(
+      lg_create_context(before.get(), nullptr),
+      lg_destroy_context
+    );
+
+    std::vector<SearchHit> actual;
+    lg_search(ctx.get(), block1.data(), block1.data() + block1.size(), 0, &actual, collectHit);
+    REQUIRE(lg_swap_program(ctx.get(), after.get(), nullptr));
+    lg_search(ctx.get(), block2.data(), block2.data() + block2.size(), block1.size(), &actual, collectHit);
+    lg_closeout_search(ctx.get(), &actual, collectHit);
+    std::sort(actual.begin(), actual.end());
+
+    REQUIRE(searchAll(after.get(), whole) == actual);
+    REQUIRE(searchAll(before.get(), block1 + "aaa") == std::vector<SearchHit>{SearchHit(0, 6, 0)});
+  }
+}
+
+TEST_CASE("testSwapProgramRetiresOldProgramAtLimit") {
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> before(
+    makeProgram("a.*z\n", 1)
+  );
+  std::unique_ptr<ProgramHandle,void(*)(ProgramHandle*)> after(
+    makeDelta(before.get(), "b\n", 1)
+  );
+
+  std::shared_ptr<ContextHandle> ctx(
+    lg_create_context(before.get(), nullptr),
+    lg_destroy_context
+  );
+
+  // the old program begins a match of a.*z before the swap which never
+  // ends, and the new one finds b throughout the stream after it
+  const std::string block1 = "xa";
+  std::vector<SearchHit> actual;
+  lg_search(ctx.get(), block1.data(), block1.data() + block1.size(), 0, &actual, collectHit);
+  REQUIRE(lg_swap_program(ctx.get(), after.get(), nullptr));
+
+  std::string chunk;
+  for (uint32_t i = 0; i < 5000; ++i) {
+    chunk += "b ";
+  }
+
+  const uint64_t until = block1.size() + HandoffVm::DEFAULT_LIMIT;
+  uint64_t off = block1.size();
+  while (off < until + 3 * chunk.size()) {
+    lg_search(ctx.get(), chunk.data(), chunk.data() + chunk.size(), off, &actual, collectHit);
+    off += chunk.size();
+
+    if (off < until) {
+      // held while the old program might yet match over them
+      REQUIRE(actual.empty());
+    }
+    else {
+      // from the search which retires the old program, every hit found is
+      // reported by the search which found it
+      REQUIRE((off - block1.size()) / 2 == actual.size());
+    }
+  }
+
+  lg_closeout_search(ctx.get(), &actual, collectHit);
+  REQUIRE((off - block1.size()) / 2 == actual.size());
+  REQUIRE(std::all_of(actual.begin(), actual.end(),
+    [&block1](const SearchHit& h) {
+      return h.End - h.Start == 1 && (h.Start - block1.size()) % 2 == 0;
+    }
+  ));
+}
@@ -21,6 +21,7 @@
 #include <memory>
 #include <vector>
 #include <stdexcept>
+#include <type_traits>
 
 #include "lightgrep/util.h"
 
@@ -308,3 +309,87 @@ TEST_CASE("lgReadWindowTestLeadingUTF8JunkUTF8Again") {
     3, 6
   );
 }
+
+TEST_CASE("lgHitContextsMatchesOneAtATime") {
+  // UTF-8 with junk, then UTF-16LE
+  const std::vector<byte> data{
+    'x', 0xFF, 'y', 'a', 'b', 'c', 0xD0, 0x96, ' ', 0x80, 'a', 'b', 'c',
+    '\n', 'a', 0, 'b', 0, 'c', 0, 0x16, 0x04, 'z', 0
+  };
+
+  const LG_Window inners[] = {
+    {103, 106}, {110, 113}, {103, 106}, {114, 120}, {115, 117}
+  };
+  const char* const encodings[] = {
+    "UTF-8", "UTF-8", "ASCII", "UTF-16LE", "UTF-16LE"
+  };
+  const size_t num = std::extent_v<decltype(inners)>;
+
+  std::unique_ptr<DecoderHandle, void(*)(DecoderHandle*)> hdec{
+    lg_create_decoder(),
+    lg_destroy_decoder
+  };
+
+  const char* beg = reinterpret_cast<const char*>(data.data());
+  const char* end = beg + data.size();
+
+  for (size_t window: {0, 2, 5, 30}) {
+    const char* utf8[num];
+    LG_Window outers[num], dhs[num];
+    unsigned int bad[num];
+    LG_Error* err = nullptr;
+
+    REQUIRE(num == lg_hit_contexts(
+      hdec.get(), beg, end, 100, inners, encodings, num, window, 0xFFFD,
+      utf8, outers, dhs, bad, &err
+    ));
+    REQUIRE(!err);
+
+    for (size_t i = 0; i < num; ++i) {
+      const char* eutf8 = nullptr;
+      LG_Window eouter, edh;
+
+      const unsigned int ebad = lg_hit_context(
+        hdec.get(), beg, end, 100, inners + i, encodings[i], window, 0xFFFD,
+        &eutf8, &eouter, &edh, &err
+      );
+      REQUIRE(!err);
+
+      REQUIRE(ebad == bad[i]);
+      REQUIRE(std::string(eutf8) == utf8[i]);
+      REQUIRE(eouter.begin == outers[i].begin);
+      REQUIRE(eouter.end == outers[i].end);
+      REQUIRE(edh.begin == dhs[i].begin);
+      REQUIRE(edh.end == dhs[i].end);
+
+      lg_free_hit_context_string(eutf8);
+      lg_free_hit_context_string(utf8[i]);
+    }
+  }
+}
+
+TEST_CASE("lgHitContextsStopsAtError") {
+  const std::vector<byte> data{'a', 'b', 'c'};
+  const LG_Window inners[] = { {0, 1}, {1, 2} };
+  const char* const encodings[] = { "ASCII", "no-such-encoding" };
+
+  std::unique_ptr<DecoderHandle, void(*)(DecoderHandle*)> hdec{
+    lg_create_decoder(),
+    lg_destroy_decoder
+  };
+
+  const char* utf8[2] = { nullptr, nullptr };
+  LG_Window outers[2], dhs[2];
+  LG_Error* err = nullptr;
+
+  const char* beg = reinterpret_cast<const char*>(data.data());
+  REQUIRE(1 == lg_hit_contexts(
+    hdec.get(), beg, beg + data.size(), 0, inners, encodings, 2, 1, 0xFFFD,
+    utf8, outers, dhs, nullptr, &err
+  ));
+  REQUIRE(err);
+  lg_free_error(err);
+
+  REQUIRE(std::string("ab") == utf8[0]);
+  lg_free_hit_context_string(utf8[0]);
+}
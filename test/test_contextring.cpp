@@ -0,0 +1,180 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "contextring.h"
+#include "stest.h"
+
+namespace {
+  std::string makeText() {
+    std::string text;
+    for (uint32_t i = 0; i < 200; ++i) {
+      text += "line " + std::to_string(i) + (i % 3 ? " foo" : "") + " end\n";
+    }
+    return text;
+  }
+
+  std::vector<LG_SearchHit> findHits(const std::string& text) {
+    std::vector<LG_SearchHit> hits;
+    for (size_t i = text.find("foo"); i != std::string::npos; i = text.find("foo", i + 1)) {
+      hits.push_back(LG_SearchHit{i, i + 3, 0});
+    }
+    return hits;
+  }
+
+  // The hits, with context, written from the whole text at once
+  std::string writeWhole(const STest& s, const std::string& text, const std::vector<LG_SearchHit>& hits) {
+    std::ostringstream out;
+    HitOutputData data(out, s.Prog.get(), '\t', "--", 2, 2, true);
+    data.setBuffer(text.data(), text.size(), 0);
+    for (const LG_SearchHit& hit: hits) {
+      callbackFn<DoNotWritePath, WriteContext, true>(&data, &hit);
+    }
+    data.flush();
+    return out.str();
+  }
+
+  // The hits, with context, written through the ring from blocks of text,
+  // each block copied so that it cannot be read once stale
+  std::string writeBlocks(const STest& s, const std::string& text, const std::vector<LG_SearchHit>& hits, size_t blockSize, size_t reach) {
+    std::ostringstream out;
+    HitOutputData data(out, s.Prog.get(), '\t', "--", 2, 2, true);
+    ContextRing ring(reach);
+
+    std::vector<std::string> blocks;
+    for (size_t off = 0; off < text.size(); off += blockSize) {
+      blocks.push_back(text.substr(off, blockSize));
+    }
+    blocks.emplace_back();
+
+    auto h = hits.begin();
+    uint64_t off = 0;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      ring.advance(blocks[i].data(), blocks[i].size(), off);
+      if (i >= 1) {
+        std::fill(blocks[i - 1].begin(), blocks[i - 1].end(), '#');
+      }
+      off += blocks[i].size();
+
+      // a hit is found in the block where it ends
+      for ( ; h != hits.end() && (h->End <= off || i + 1 == blocks.size()); ++h) {
+        ContextRing::hold(&ring, &*h);
+      }
+
+      if (i + 1 < blocks.size()) {
+        const std::string& next = blocks[i + 1];
+        ring.release(next.data(), next.size(), next.empty(), &data, &callbackFn<DoNotWritePath, WriteContext, true>);
+      }
+    }
+    ring.release(nullptr, 0, true, &data, &callbackFn<DoNotWritePath, WriteContext, true>);
+    REQUIRE(0 == ring.held());
+
+    data.flush();
+    return out.str();
+  }
+}
+
+TEST_CASE("contextRingMatchesWholeBuffer") {
+  const STest s("foo");
+  const std::string text = makeText();
+  const std::vector<LG_SearchHit> hits = findHits(text);
+  const std::string expected = writeWhole(s, text, hits);
+
+  // blocks smaller than a hit, than a line, and than the reach
+  for (size_t blockSize: {1, 2, 7, 16, 100, 1000, 100000}) {
+    INFO(blockSize);
+    REQUIRE(expected == writeBlocks(s, text, hits, blockSize, 64));
+  }
+}
+
+TEST_CASE("contextRingHitSpanningManyBlocks") {
+  const STest s("foo");
+  const std::string text = "one\ntwo\nthree " + std::string(500, 'x') + " four\nfive\nsix\n";
+  const std::vector<LG_SearchHit> hits{{14, 514, 0}};
+  const std::string expected = writeWhole(s, text, hits);
+
+  // a hit is read whole if no longer than the reach
+  for (size_t blockSize: {3, 50, 600}) {
+    INFO(blockSize);
+    REQUIRE(expected == writeBlocks(s, text, hits, blockSize, 1024));
+  }
+}
+
+TEST_CASE("contextRingCountsLines") {
+  const STest s("foo");
+  const std::string text = makeText();
+  const std::vector<LG_SearchHit> hits = findHits(text);
+
+  for (size_t blockSize: {1, 7, 100, 100000}) {
+    INFO(blockSize);
+
+    std::ostringstream out;
+    HitOutputData data(out, s.Prog.get(), '\t', "--", -1, -1, false);
+    data.OutInfo.LineNumbers = true;
+    ContextRing ring(16, true);
+
+    auto h = hits.begin();
+    for (uint64_t off = 0; off <= text.size(); off += blockSize) {
+      const size_t len = std::min(blockSize, text.size() - off);
+      ring.advance(text.data() + off, len, off);
+      for ( ; h != hits.end() && h->End <= off + len; ++h) {
+        ContextRing::hold(&ring, &*h);
+      }
+      const size_t nlen = std::min(blockSize, text.size() - std::min(text.size(), off + len));
+      ring.release(text.data() + off + len, nlen, !nlen, &data, &callbackFn<DoNotWritePath, NoContext, true>);
+      if (!len) {
+        break;
+      }
+    }
+    data.flush();
+
+    // every line but each third has a hit
+    std::istringstream in(out.str());
+    std::string line;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < 200; ++i) {
+      if (i % 3) {
+        REQUIRE(std::getline(in, line));
+        REQUIRE(std::to_string(i + 1) + "\t" == line.substr(0, line.find('\t') + 1));
+        ++n;
+      }
+    }
+    REQUIRE(hits.size() == n);
+  }
+}
+
+TEST_CASE("contextRingLimitsContextToReach") {
+  const STest s("foo");
+  const std::string text = std::string(100, 'a') + "foo" + std::string(100, 'b') + "\n";
+  const std::vector<LG_SearchHit> hits{{100, 103, 0}};
+
+  std::ostringstream out;
+  HitOutputData data(out, s.Prog.get(), '\t', "--", 1, 1, false);
+  ContextRing ring(10);
+  ring.advance(text.data(), text.size(), 0);
+  ContextRing::hold(&ring, &hits[0]);
+  ring.release(nullptr, 0, true, &data, &callbackFn<DoNotWritePath, WriteContext, true>);
+  data.flush();
+
+  REQUIRE("100\t103\t0\tfoo\tUS-ASCII\t90\taaaaaaaaaafoobbbbbbbbbb\n" == out.str());
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <catch2/catch_test_macros.hpp>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "encoders/encodingtable.h"
+#include "encoders/icuencoder.h"
+
+namespace {
+  // ICUEncoder as it was, converting each code point through ICU
+  class PlainICUEncoder: public EncoderBase {
+  public:
+    PlainICUEncoder(const std::string& name): Conv(name) {
+      Valid = Conv.validCodePoints();
+    }
+
+    virtual PlainICUEncoder* clone() const { return new PlainICUEncoder(*this); }
+
+    virtual uint32_t maxByteLength() const { return Conv.maxByteLength(); }
+
+    virtual std::string name() const { return Conv.name(); }
+
+    virtual uint32_t write(int32_t cp, byte buf[]) const { return Conv.cp_to_bytes(cp, buf); }
+
+    using EncoderBase::write;
+
+    virtual uint32_t write(const byte[], int32_t&) const { return 0; }
+
+  private:
+    ICUConverter Conv;
+  };
+
+  const char* const ENCODINGS[] = {
+    "Shift_JIS", "GB18030", "IBM037", "EUC-KR", "Big5", "windows-1252"
+  };
+}
+
+TEST_CASE("encodingTableWriteMatchesICU") {
+  for (const char* name: ENCODINGS) {
+    INFO(name);
+    const ICUConverter conv(name);
+    const UnicodeSet valid = conv.validCodePoints();
+    const EncodingTable table(conv, valid);
+
+    // far fewer runs than code points
+    REQUIRE(table.runs() < valid.count());
+
+    byte exp[16], act[16];
+    for (const UnicodeSet::range r : valid) {
+      for (uint32_t cp = r.first; cp < r.second; ++cp) {
+        const uint32_t len = conv.cp_to_bytes(cp, exp);
+        REQUIRE(len == table.write(cp, act));
+        REQUIRE(std::vector<byte>(exp, exp+len) == std::vector<byte>(act, act+len));
+      }
+    }
+
+    // invalid code points are not in the table
+    REQUIRE(0 == table.write(0xD800, act));
+  }
+}
+
+TEST_CASE("icuEncoderWriteSetMatchesPerCodePoint") {
+  std::mt19937 gen(44);
+  std::uniform_int_distribution<uint32_t> cps(0, 0x10FFFF), lens(1, 5000);
+
+  for (const char* name: ENCODINGS) {
+    INFO(name);
+    const ICUEncoder enc(name);
+    const PlainICUEncoder plain(name);
+    REQUIRE(plain.validCodePoints() == enc.validCodePoints());
+
+    std::vector<UnicodeSet> sets{
+      enc.validCodePoints(),
+      UnicodeSet{{'A', 'Z'+1}, {'a', 'z'+1}},
+      UnicodeSet{{0x3040, 0x3100}, {0x4E00, 0x9FA0}}
+    };
+
+    for (uint32_t i = 0; i < 20; ++i) {
+      UnicodeSet s;
+      for (uint32_t j = 0; j < 10; ++j) {
+        const uint32_t l = i < 10 ? cps(gen) % 0x10000 : cps(gen);
+        s.insert(l, std::min(l + lens(gen), 0x110000u));
+      }
+      sets.push_back(s & enc.validCodePoints());
+    }
+
+    for (const UnicodeSet& s: sets) {
+      std::vector<std::vector<ByteSet>> exp, act;
+      plain.write(s, exp);
+      enc.write(s, act);
+      REQUIRE(exp == act);
+    }
+  }
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+#include "histogram.h"
+
+namespace {
+  // two encodings of one pattern, and a second pattern
+  const LG_PatternInfo INFOS[] = {
+    {"a.c", "UTF-8", 0},
+    {"a.c", "UTF-16LE", 0},
+    {"x+", "UTF-8", 1}
+  };
+
+  void add(HitHistogram& h, uint32_t k, const std::string& text) {
+    h.add(k, &INFOS[k], text.data(), text.size());
+  }
+}
+
+TEST_CASE("hitHistogramCountsExactly") {
+  HitHistogram h;
+  LG_Histogram expected;
+
+  // enough distinct texts to grow the table several times
+  for (uint32_t i = 0; i < 5000; ++i) {
+    const uint32_t k = i % 3;
+    const std::string text = std::to_string((i * 7919) % 1000);
+    add(h, k, text);
+    ++expected[HistogramKey{text, INFOS[k].Pattern, INFOS[k].UserIndex}];
+  }
+
+  // the encodings of "a.c" are counted together
+  REQUIRE(2000 == h.size());
+  REQUIRE(expected == h.toMap());
+}
+
+TEST_CASE("hitHistogramWriteOrder") {
+  HitHistogram h;
+  add(h, 2, "xx");
+  add(h, 0, "abc");
+  add(h, 1, "abc");
+  add(h, 0, "a\tc");
+  add(h, 2, "x");
+  add(h, 2, "x");
+
+  std::ostringstream out;
+  h.write(out, '\t');
+  REQUIRE("2\tabc\t0\ta.c\n2\tx\t1\tx+\n1\ta\\tc\t0\ta.c\n1\txx\t1\tx+\n" == out.str());
+}
+
+TEST_CASE("hitHistogramTopKKeepsHeavyHitters") {
+  const uint32_t k = 20;
+  HitHistogram h(k);
+
+  // five hitters, each a tenth of the hits, among many singletons; more
+  // frequent than 1/K, so they must be kept
+  uint64_t n = 0;
+  for (uint32_t i = 0; i < 20000; ++i) {
+    add(h, 0, "heavy" + std::to_string(i % 5));
+    add(h, 2, "rare" + std::to_string(i));
+    n += 2;
+    REQUIRE(h.size() <= 2 * k);
+  }
+
+  const LG_Histogram hist = h.toMap();
+  for (uint32_t i = 0; i < 5; ++i) {
+    const auto e = hist.find(HistogramKey{"heavy" + std::to_string(i), "a.c", 0});
+    REQUIRE(e != hist.end());
+    // counts are lower bounds, and the undercount is bounded
+    REQUIRE(e->second <= 4000);
+    REQUIRE(e->second + n / k >= 4000);
+  }
+
+  // only the top K are written, the hitters first
+  std::ostringstream out;
+  h.write(out, '\t');
+  const std::string s = out.str();
+  REQUIRE(k == std::count(s.begin(), s.end(), '\n'));
+
+  std::istringstream in(s);
+  std::string line;
+  for (uint32_t i = 0; i < 5; ++i) {
+    std::getline(in, line);
+    REQUIRE(line.find("heavy") != std::string::npos);
+  }
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "hitcache.h"
+
+namespace {
+  ContentKey hash(const std::string& s) {
+    ContentHasher h;
+    h.update(s.data(), s.data() + s.size());
+    return h.finish();
+  }
+}
+
+static bool operator==(const LG_SearchHit& a, const LG_SearchHit& b) {
+  return a.Start == b.Start && a.End == b.End && a.KeywordIndex == b.KeywordIndex;
+}
+
+TEST_CASE("contentHasherIgnoresHowInputIsSplit") {
+  const std::string s = "The quick brown fox jumps over the lazy dog, twice over.";
+  const ContentKey whole = hash(s);
+  REQUIRE(s.size() == whole.Size);
+
+  for (size_t i = 0; i <= s.size(); ++i) {
+    for (size_t j = i; j <= s.size(); j += 3) {
+      ContentHasher h;
+      h.update(s.data(), s.data() + i);
+      h.update(s.data() + i, s.data() + j);
+      h.update(s.data() + j, s.data() + s.size());
+      REQUIRE(whole == h.finish());
+    }
+  }
+}
+
+TEST_CASE("contentHasherDistinguishesContents") {
+  const std::vector<std::string> inputs = {
+    "", std::string(1, '\0'), std::string(2, '\0'), std::string(8, '\0'),
+    std::string(9, '\0'), "a", "b", "ab", "ba", "abcdefgh", "abcdefgi",
+    std::string("abcdefgh\0", 9), "bbcdefgh"
+  };
+
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    for (size_t j = i + 1; j < inputs.size(); ++j) {
+      REQUIRE(hash(inputs[i]) != hash(inputs[j]));
+    }
+  }
+}
+
+TEST_CASE("hitCacheSaveLoadRoundTrip") {
+  const ContentKey prog = hash("program");
+  const ContentKey k1 = hash("file one"), k2 = hash("file two");
+  const std::vector<LG_SearchHit> hits = {{0, 3, 0}, {5, 17, 2}, {1ull << 40, (1ull << 40) + 1, 7}};
+
+  HitCache cache(prog);
+  REQUIRE(!cache.find(k1));
+
+  cache.insert(k1, hits);
+  cache.insert(k2, {});
+  REQUIRE(2 == cache.size());
+
+  std::stringstream buf;
+  cache.save(buf);
+
+  HitCache loaded(prog);
+  REQUIRE(loaded.load(buf));
+  REQUIRE(2 == loaded.size());
+  REQUIRE(loaded.find(k1));
+  REQUIRE(hits == *loaded.find(k1));
+  REQUIRE(loaded.find(k2));
+  REQUIRE(loaded.find(k2)->empty());
+}
+
+TEST_CASE("hitCacheIgnoresOtherProgramsAndTruncatedFiles") {
+  HitCache cache(hash("program"));
+  cache.insert(hash("file"), {{0, 1, 0}});
+
+  std::stringstream buf;
+  cache.save(buf);
+  const std::string saved = buf.str();
+
+  HitCache other(hash("other program"));
+  std::istringstream in(saved);
+  REQUIRE(!other.load(in));
+  REQUIRE(0 == other.size());
+
+  HitCache truncated(hash("program"));
+  std::istringstream tin(saved.substr(0, saved.size() - 1));
+  REQUIRE(!truncated.load(tin));
+  REQUIRE(0 == truncated.size());
+}
@@ -133,6 +133,7 @@ TEST_CASE("hitOutputDataAndCallback") {
     const std::string expected = "8\t11\t0\tfoo\tUS-ASCII\n";
     const LG_HITCALLBACK_FN fn = &callbackFn<DoNotWritePath, NoContext, true>;
     fn(&data, &searchHit);
+    data.flush();
     REQUIRE(expected == stream.str());
     REQUIRE(data.HistInfo.Histogram.size() == 0);
   };
@@ -141,6 +142,7 @@ TEST_CASE("hitOutputDataAndCallback") {
     const LG_SearchHit searchHit{0, 8, 0};
     const LG_HITCALLBACK_FN fn = &callbackFn<DoNotWritePath, NoContext, false>;
     fn(&data, &searchHit);
+    data.flush();
     REQUIRE("" == stream.str());
     REQUIRE(1 == data.NumHits);
     REQUIRE(data.HistInfo.Histogram.size() == 0);
@@ -155,11 +157,22 @@ TEST_CASE("hitOutputDataAndCallback") {
     fn(&data, &searchHit1);
     fn(&data, &searchHit2);
     std::string expected = "path/to/input/file\t0\t8\t0\tfoo\tUS-ASCII\npath/to/input/file\t44\t47\t0\tfoo\tUS-ASCII\npath/to/input/file\t59\t62\t0\tfoo\tUS-ASCII\n";
+    data.flush();
     REQUIRE(expected == stream.str());
     REQUIRE(3 == data.NumHits);
     REQUIRE(data.HistInfo.Histogram.size() == 0);
   };
 
+  SECTION("lineNumberYesPath") {
+    const LG_SearchHit searchHit{44, 47, 0};
+    const LG_HITCALLBACK_FN fn = &callbackFn<WritePath, NoContext, true>;
+    data.OutInfo.LineNumbers = true;
+    data.OutInfo.Line = 4;
+    fn(&data, &searchHit);
+    data.flush();
+    REQUIRE("path/to/input/file\t4\t44\t47\t0\tfoo\tUS-ASCII\n" == stream.str());
+  };
+
   SECTION("withLineContextNoPath") {
     data.OutInfo.AfterContext = 0;
     data.OutInfo.BeforeContext = 0;
@@ -168,6 +181,7 @@ TEST_CASE("hitOutputDataAndCallback") {
     const LG_HITCALLBACK_FN fn = &callbackFn<DoNotWritePath, WriteContext, true>;
     fn(&data, &searchHit);
     std::string expected = "0\t8\t0\tfoo\tUS-ASCII\t0\tthis is foo\n";
+    data.flush();
     REQUIRE(expected == stream.str());
     REQUIRE(1 == data.NumHits);
     REQUIRE(data.HistInfo.Histogram.size() == 0);
@@ -181,6 +195,7 @@ TEST_CASE("hitOutputDataAndCallback") {
     LG_HITCALLBACK_FN fn = &callbackFn<WritePath, WriteContext, true>;
     fn(&data, &searchHit);
     std::string expected = "path/to/input/file\t0\t8\t0\tfoo\tUS-ASCII\t0\tthis is foo\n";
+    data.flush();
     REQUIRE(expected == stream.str());
     REQUIRE(1 == data.NumHits);
     REQUIRE(data.HistInfo.Histogram.size() == 0);
@@ -243,6 +258,7 @@ TEST_CASE("hitOutputDataAndCallback") {
     fn(&data, &searchHit1);
     fn(&data, &searchHit2);
     std::string expected = "path/to/input/file\t0\t8\t0\tfoo\tUS-ASCII\t0\tthis is foo\\nthis is bar\\nthis is baz\\nthis is foobar\n--\npath/to/input/file\t44\t47\t0\tfoo\tUS-ASCII\t12\tthis is bar\\nthis is baz\\nthis is foobar\\nthis is foobaz\\nthis is foobarbaz\n--\npath/to/input/file\t59\t62\t0\tfoo\tUS-ASCII\t24\tthis is baz\\nthis is foobar\\nthis is foobaz\\nthis is foobarbaz\n";
+    data.flush();
     REQUIRE(expected == stream.str());
     REQUIRE(3 == data.NumHits);
     REQUIRE(data.HistInfo.Histogram.size() == 0);
@@ -280,7 +296,7 @@ TEST_CASE("getHistogramFromHitOutputData") {
   expectedHistogram[HistogramKey{"foo", "foo", 1}] = 1;
   expectedHistogram[HistogramKey{"hat", "[bch]at", 2}] = 1;
 
-  REQUIRE(expectedHistogram == data.HistInfo.Histogram);
+  REQUIRE(expectedHistogram == data.HistInfo.Histogram.toMap());
 }
 
 TEST_CASE("writeHistogram") {
@@ -312,7 +328,7 @@ TEST_CASE("writeHistogram") {
   data.writeHitToHistogram(searchHit7);
   data.writeHitToHistogram(searchHit8);
 
-  CAPTURE(data.HistInfo.Histogram);
+  CAPTURE(data.HistInfo.Histogram.toMap());
 
   data.writeHistogram(histStream);
   std::string expectedOutput = "2\tcat\t0\tc[auo]t\n2\tcat\t2\t[bch]at\n2\that\t2\t[bch]at\n1\tfoo\t1\tfoo\n1\tt\\r\\nf\t3\tt\\r\\nf\n";
@@ -355,10 +371,12 @@ TEST_CASE("decodeContextNoLineContextSecondLineAndHistogramEnabled") {
   const std::string expected = "8\t11\t0\tfoo\tUS-ASCII\n";
   const LG_HITCALLBACK_FN fn = &callbackFn<DoNotWritePath, NoContext, true>;
   fn(&data, &searchHit);
+  data.flush();
   REQUIRE(expected == stream.str());
   CHECK(data.HistInfo.Histogram.size() == 1);
-  auto found = data.HistInfo.Histogram.find(HistogramKey{"foo", "foo", 0});
-  REQUIRE(found != data.HistInfo.Histogram.end());
+  const LG_Histogram hist = data.HistInfo.Histogram.toMap();
+  auto found = hist.find(HistogramKey{"foo", "foo", 0});
+  REQUIRE(found != hist.end());
   CHECK(found->second == 1);
 }
 
@@ -371,9 +389,9 @@ TEST_CASE("testDecodeContextPassedAsFunction") {
   auto decodeFn = [](const LG_SearchHit& hit) { return HitBuffer{"", {0,0}, hit.KeywordIndex}; };
   hInfo.writeHitToHistogram(hit, info, decodeFn);
   HistogramKey hKey("", "foo", 0);
-  HistogramInfo expectedHist{true};
-  expectedHist.Histogram[hKey] = 1;
-  REQUIRE(hInfo.Histogram == expectedHist.Histogram);
+  LG_Histogram expectedHist;
+  expectedHist[hKey] = 1;
+  REQUIRE(hInfo.Histogram.toMap() == expectedHist);
 }
 
 TEST_CASE("HistInfo::writeHitToHistogram Should Use DecodedContext Provided By WriteContext If Present") {
@@ -425,3 +443,100 @@ TEST_CASE("zeroTrailingContextShouldWorkWhenHitsEndWithCR") {
   REQUIRE(actualHitBuffer.hit() == "\nt\r");
   REQUIRE(actualHitBuffer.Context == "\r\nt\r");
 }
+
+TEST_CASE("ndjsonHitsWithPathAndContext") {
+  const STest s("foo");
+  std::ostringstream stream;
+  const std::string textToSearch = "this is \"foo\"\tand\nthis is bar";
+
+  HitOutputData data(stream, s.Prog.get(), '\t', "--", 0, 0, false, HitFormat::NDJSON);
+  data.setPath("path/to/\"input\"");
+  data.setBuffer(textToSearch.data(), textToSearch.size(), 0);
+
+  const LG_SearchHit searchHit{9, 12, 0};
+
+  SECTION("withPath") {
+    const LG_HITCALLBACK_FN fn = &callbackFn<WritePath, WriteContext, true>;
+    fn(&data, &searchHit);
+    fn(&data, &searchHit);
+    data.flush();
+
+    const std::string line = "{\"path\":\"path/to/\\\"input\\\"\",\"start\":9,\"end\":12,\"index\":0,\"pattern\":\"foo\",\"encoding\":\"US-ASCII\",\"context_offset\":0,\"context\":\"this is \\\"foo\\\"\\tand\"}\n";
+    REQUIRE(line + line == stream.str());
+  }
+
+  SECTION("noPath") {
+    const LG_HITCALLBACK_FN fn = &callbackFn<DoNotWritePath, NoContext, true>;
+    fn(&data, &searchHit);
+    data.flush();
+
+    REQUIRE("{\"start\":9,\"end\":12,\"index\":0,\"pattern\":\"foo\",\"encoding\":\"US-ASCII\"}\n" == stream.str());
+  }
+}
+
+TEST_CASE("ndjsonEscapesInvalidUTF8InPath") {
+  const STest s("foo");
+  std::ostringstream stream;
+  const std::string textToSearch = "foo";
+
+  HitOutputData data(stream, s.Prog.get(), '\t', "--", 0, 0, false, HitFormat::NDJSON);
+  // Latin-1 e-acute, valid UTF-8 e-acute, a lone continuation byte, a
+  // surrogate, and a truncated sequence at the end
+  data.setPath("caf\xE9/caf\xC3\xA9/\x80/\xED\xA0\x80/\xE2\x82");
+  data.setBuffer(textToSearch.data(), textToSearch.size(), 0);
+
+  const LG_SearchHit searchHit{0, 3, 0};
+  const LG_HITCALLBACK_FN fn = &callbackFn<WritePath, NoContext, true>;
+  fn(&data, &searchHit);
+  data.flush();
+
+  REQUIRE("{\"path\":\"caf\\u00e9/caf\xC3\xA9/\\u0080/\\u00ed\\u00a0\\u0080/\\u00e2\\u0082\",\"start\":0,\"end\":3,\"index\":0,\"pattern\":\"foo\",\"encoding\":\"US-ASCII\"}\n" == stream.str());
+}
+
+TEST_CASE("binaryHitsWithPatternTable") {
+  const STest s("foo");
+  std::ostringstream stream;
+  const std::string textToSearch = "this is foo";
+
+  HitOutputData data(stream, s.Prog.get(), '\t', "--", 0, 0, false, HitFormat::BINARY);
+  data.setPath("p");
+  data.setBuffer(textToSearch.data(), textToSearch.size(), 0);
+
+  const LG_SearchHit searchHit{8, 11, 0};
+  const LG_HITCALLBACK_FN fn = &callbackFn<WritePath, WriteContext, true>;
+  fn(&data, &searchHit);
+  fn(&data, &searchHit);
+  data.flush();
+
+  std::ostringstream expected;
+  const auto raw = [&expected](auto v) {
+    expected.write(reinterpret_cast<const char*>(&v), sizeof(v));
+  };
+
+  // pattern table
+  expected << "LGHT";
+  raw(uint32_t(1));
+  raw(uint32_t(1));
+  raw(uint64_t(0));
+  raw(uint32_t(3));
+  expected << "foo";
+  raw(uint32_t(8));
+  expected << "US-ASCII";
+
+  // the path once, then a hit and its context twice
+  expected << 'P';
+  raw(uint32_t(1));
+  expected << 'p';
+  for (int i = 0; i < 2; ++i) {
+    expected << 'H';
+    raw(uint64_t(8));
+    raw(uint64_t(11));
+    raw(uint32_t(0));
+    expected << 'C';
+    raw(uint64_t(0));
+    raw(uint32_t(11));
+    expected << "this is foo";
+  }
+
+  REQUIRE(expected.str() == stream.str());
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <string>
+
+#include "lineindex.h"
+
+TEST_CASE("countLines") {
+  const std::string text = "a\nbb\n\nccc\nd";
+  REQUIRE(4 == countLines(text.data(), text.data() + text.size()));
+  REQUIRE(0 == countLines(text.data(), text.data()));
+  REQUIRE(1 == countLines(text.data() + 1, text.data() + 2));
+
+  // long enough for an auto-vectorized loop to leave a tail
+  std::string big;
+  for (uint32_t i = 0; i < 1000; ++i) {
+    big += std::string(i % 37, 'x') + '\n';
+  }
+  big += "end";
+  REQUIRE(1000 == countLines(big.data(), big.data() + big.size()));
+}
+
+TEST_CASE("lineIndexBefore") {
+  const std::string text = "a\nbb\n\nccc\nd";
+  LineIndex idx;
+  idx.reset(text.data(), text.size());
+
+  REQUIRE(4 == idx.count());
+
+  const size_t expected[] = {0, 0, 1, 1, 1, 2, 3, 3, 3, 3, 4, 4};
+  for (size_t pos = 0; pos <= text.size(); ++pos) {
+    REQUIRE(expected[pos] == idx.before(pos));
+  }
+
+  // counted from the index once built
+  REQUIRE(4 == idx.count());
+
+  idx.reset(text.data(), 2);
+  REQUIRE(1 == idx.before(2));
+  REQUIRE(1 == idx.count());
+
+  idx.reset(nullptr, 0);
+  REQUIRE(0 == idx.before(0));
+  REQUIRE(0 == idx.count());
+}
@@ -187,6 +187,17 @@ TEST_CASE("sampleOptions") {
   REQUIRE(opts.LoopLimit == 5);
 }
 
+TEST_CASE("analyzeCommand") {
+  const char* argv[] = {"lightgrep", "-c", "analyze", "-p", "a+b", "-p", "xyz"};
+  Options opts;
+
+  po::options_description desc;
+  parse_opts(std::extent_v<decltype(argv)>, argv, desc, opts);
+
+  REQUIRE(Options::ANALYZE == opts.Command);
+  REQUIRE(2u == opts.CmdLinePatterns.size());
+}
+
 TEST_CASE("readFromStdinWhenNoInputsProvided") {
   const char* argv[] = {"lightgrep", "--program-file", "test-prog.txt"};
   Options opts;
@@ -234,6 +245,17 @@ TEST_CASE("histogramOption") {
   REQUIRE(opts.HistogramFile == "histogram.txt");
 }
 
+TEST_CASE("lineNumberOption") {
+  const char* argv[] = {"lightgrep", "-p", "test", "-n", "test_corpora.txt"};
+  Options opts;
+
+  boost::program_options::options_description desc;
+  parse_opts(std::extent_v<decltype(argv)>, argv, desc, opts);
+
+  REQUIRE(opts.LineNumbers);
+  REQUIRE(!opts.MemoryMapped);
+}
+
 TEST_CASE("Negative context option should align with grep behavior") {
   SECTION("C option should throw exception if negative") {
     const char* argv[] = {"lightgrep", "-p", "test", "-C", "-1", "test_corpora.txt"};
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include "outputbuffer.h"
+
+TEST_CASE("outputBufferAppendNum") {
+  const uint64_t values[] = {
+    0, 1, 9, 10, 11, 99, 100, 101, 999, 1000, 12345, 100000, 9876543210ull,
+    std::numeric_limits<uint64_t>::max()
+  };
+
+  for (const uint64_t v: values) {
+    std::ostringstream out;
+    {
+      OutputBuffer buf(out);
+      buf.appendNum(v);
+    }
+    REQUIRE(std::to_string(v) == out.str());
+  }
+}
+
+TEST_CASE("outputBufferHoldsOutputUntilFlushed") {
+  std::ostringstream out;
+  OutputBuffer buf(out);
+
+  buf.append("abc", 3);
+  buf.append('d');
+  REQUIRE("" == out.str());
+
+  buf.flush();
+  REQUIRE("abcd" == out.str());
+}
+
+TEST_CASE("outputBufferThreadedWritesEverythingInOrder") {
+  std::ostringstream out;
+  std::string expected;
+
+  {
+    // a small capacity, to spill to the writer thread many times
+    OutputBuffer buf(out, true, 64);
+    for (uint64_t i = 0; i < 10000; ++i) {
+      buf.appendNum(i);
+      buf.append('\n');
+      expected += std::to_string(i) + '\n';
+    }
+
+    // longer than the capacity
+    const std::string big(1000, 'x');
+    buf.append(big);
+    expected += big;
+
+    buf.flush();
+    REQUIRE(expected == out.str());
+
+    buf.append("tail", 4);
+    expected += "tail";
+  }
+
+  REQUIRE(expected == out.str());
+}
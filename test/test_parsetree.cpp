@@ -1,6 +1,8 @@
 #include <catch2/catch_test_macros.hpp>
 
+#include "parser.h"
 #include "parsetree.h"
+#include "pattern.h"
 
 TEST_CASE("nodesUpperBound_alpha") {
   REQUIRE(nodesUpperBound("abcd") == 8);
@@ -30,3 +32,23 @@ TEST_CASE("nodesUpperBound_whack_b") {
 TEST_CASE("nodesUpperBound_whack_B") {
   REQUIRE(nodesUpperBound("\\B") == 10);
 }
+
+TEST_CASE("treeKey_equal_trees") {
+  const auto key = [](const Pattern& p) {
+    ParseTree tree;
+    parseAndReduce(p, tree);
+    return treeKey(tree);
+  };
+
+  // written differently, or with different options, but the same tree
+  REQUIRE(key(Pattern("a.c", true)) == key(Pattern("a\\.c")));
+  REQUIRE(key(Pattern("(foo)")) == key(Pattern("foo")));
+  REQUIRE(key(Pattern("ab", false, true)) == key(Pattern("[Aa][Bb]")));
+
+  REQUIRE(key(Pattern("a.c", true)) != key(Pattern("a.c")));
+  REQUIRE(key(Pattern("a{2}")) != key(Pattern("a{3}")));
+  REQUIRE(key(Pattern("\\xFF")) != key(Pattern("\\zFF")));
+
+  // which differ only past the first 256 code points
+  REQUIRE(key(Pattern("k", false, true, true)) != key(Pattern("k", false, true, false)));
+}
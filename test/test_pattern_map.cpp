@@ -70,3 +70,71 @@ TEST_CASE("testPatternMapSerialization") {
     REQUIRE(std::memcmp(&p1[i], &(*p3)[i], sizeof(LG_PatternInfo)));
   }
 }
+
+TEST_CASE("testPatternMapDuplicates") {
+  PatternMap p1(4);
+  p1.addPattern("foo", "UTF-8", 0);
+  p1.addPattern("bar", "UTF-8", 1);
+  REQUIRE(!p1.hasDuplicates());
+
+  p1.addPattern("(foo)", "UTF-8", 2, 0);
+  p1.addPattern("foo", "UTF-8", 3, 0);
+  REQUIRE(p1.hasDuplicates());
+
+  const uint32_t originals[] = { 0, 1, 0, 0 };
+  for (size_t i = 0; i < 4; ++i) {
+    REQUIRE(originals[i] == p1.original(i));
+  }
+
+  const std::vector<char> buf = p1.marshall();
+  REQUIRE(buf.size() == p1.bufSize());
+
+  std::unique_ptr<PatternMap> p2 = PatternMap::unmarshall(buf.data(), buf.size());
+  REQUIRE(p1 == *p2);
+  REQUIRE(p2->hasDuplicates());
+
+  const PatternMap p3(*p2);
+  REQUIRE(p1 == p3);
+}
+
+TEST_CASE("testPatternMapUnmarshallRejectsMalformed") {
+  PatternMap p1(2);
+  p1.addPattern("foo", "UTF-8", 0);
+  p1.addPattern("foo", "UTF-8", 1, 0);
+
+  std::vector<char> buf = p1.marshall();
+  REQUIRE(PatternMap::unmarshall(buf.data(), buf.size()));
+
+  SECTION("truncated") {
+    // the patterns are the same size, after the magic and version; every
+    // other cut falls inside a field
+    const size_t between = 8 + (buf.size() - 8) / 2;
+    for (size_t len = 1; len < buf.size(); ++len) {
+      if (len != between && len != 8) {
+        REQUIRE(!PatternMap::unmarshall(buf.data(), len));
+      }
+    }
+  }
+
+  SECTION("unterminated") {
+    buf.resize(8 + 3);
+    REQUIRE(!PatternMap::unmarshall(buf.data(), buf.size()));
+  }
+
+  SECTION("badMagic") {
+    buf[0] = 'X';
+    REQUIRE(!PatternMap::unmarshall(buf.data(), buf.size()));
+  }
+
+  SECTION("badVersion") {
+    ++buf[4];
+    REQUIRE(!PatternMap::unmarshall(buf.data(), buf.size()));
+  }
+
+  SECTION("originalOutOfRange") {
+    // the original of the second pattern is its last four bytes
+    const uint32_t orig = 2;
+    std::memcpy(buf.data() + buf.size() - sizeof(orig), &orig, sizeof(orig));
+    REQUIRE(!PatternMap::unmarshall(buf.data(), buf.size()));
+  }
+}
@@ -17,6 +17,8 @@
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <cstring>
+
 #include "program.h"
 
 ProgramPtr makeProgram() {
@@ -59,3 +61,131 @@ TEST_CASE("testProgramSerialization") {
   // p1 and p2 have different buffers
   REQUIRE(&p1->front() != &p2->front());
 }
+
+TEST_CASE("testProgramSerializationWithFilterWindows") {
+  ProgramPtr p1(makeProgram());
+
+  FilterWindow pw{1, 2, 1, 0, std::vector<uint64_t>(256*256/64)};
+  pw.set('a' | ('b' << 8));
+  p1->FilterWindows.push_back(pw);
+
+  FilterWindow gw{0, 4, 0x9E3779B1, 16, std::vector<uint64_t>(65536/64)};
+  gw.set(FilterWindow::key(reinterpret_cast<const byte*>("abcd"), 4));
+  p1->FilterWindows.push_back(gw);
+
+  REQUIRE(4u == p1->filterSpan());
+
+  const std::vector<char> buf = p1->marshall();
+  REQUIRE(p1->bufSize() == buf.size());
+
+  ProgramPtr p2 = Program::unmarshall(buf.data(), buf.size());
+  REQUIRE(p2);
+  REQUIRE(*p1 == *p2);
+  REQUIRE(3u == p2->size());
+  REQUIRE(2u == p2->FilterWindows.size());
+
+  const byte* s = reinterpret_cast<const byte*>("xabcd");
+  REQUIRE(p2->FilterWindows[0].admits(s));
+  REQUIRE(!p2->FilterWindows[0].admits(s + 1));
+  REQUIRE(p2->FilterWindows[1].admits(s + 1));
+}
+
+TEST_CASE("testProgramSerializationWithFilterStride") {
+  ProgramPtr p1(makeProgram());
+  p1->FilterStride = 2;
+
+  const std::vector<char> buf = p1->marshall();
+  REQUIRE(p1->bufSize() == buf.size());
+
+  ProgramPtr p2 = Program::unmarshall(buf.data(), buf.size());
+  REQUIRE(*p1 == *p2);
+  REQUIRE(2u == p2->FilterStride);
+  REQUIRE(3u == p2->filterSpan());
+
+  const byte s[] = "a\0b";
+  REQUIRE(('a' | ('b' << 8)) == p2->filterKey(s));
+}
+
+TEST_CASE("testProgramUnmarshallRejectsOtherVersionsAndStrides") {
+  ProgramPtr p1(makeProgram());
+  std::vector<char> buf = p1->marshall();
+
+  SECTION("badMagic") {
+    buf[0] = 'X';
+    REQUIRE(!Program::unmarshall(buf.data(), buf.size()));
+  }
+
+  SECTION("badVersion") {
+    ++buf[4];
+    REQUIRE(!Program::unmarshall(buf.data(), buf.size()));
+  }
+
+  SECTION("badStride") {
+    // after the magic, version, MaxLabel, MaxCheck, and FilterOff
+    for (const uint32_t stride: {0u, 5u, 0xFFFFFFFFu}) {
+      std::memcpy(buf.data() + 20, &stride, sizeof(stride));
+      REQUIRE(!Program::unmarshall(buf.data(), buf.size()));
+    }
+
+    const uint32_t stride = 4;
+    std::memcpy(buf.data() + 20, &stride, sizeof(stride));
+    REQUIRE(Program::unmarshall(buf.data(), buf.size()));
+  }
+
+  SECTION("truncatedHead") {
+    REQUIRE(!Program::unmarshall(buf.data(), 30));
+  }
+}
+
+TEST_CASE("testProgramUnmarshallRejectsTruncatedWindows") {
+  ProgramPtr p1(makeProgram());
+
+  FilterWindow pw{1, 2, 1, 0, std::vector<uint64_t>(256*256/64)};
+  pw.set('a' | ('b' << 8));
+  p1->FilterWindows.push_back(pw);
+
+  FilterWindow gw{0, 4, 0x9E3779B1, 16, std::vector<uint64_t>(65536/64)};
+  p1->FilterWindows.push_back(gw);
+
+  std::vector<char> buf = p1->marshall();
+
+  // the magic, version, four fields, and the filter bitset
+  const size_t wbeg = 8 + 16 + 256*256/8;
+  // the instructions follow the windows
+  const size_t wend = buf.size() - p1->size()*sizeof(Instruction);
+
+  uint32_t wcount;
+  std::memcpy(&wcount, buf.data() + wbeg, sizeof(wcount));
+  REQUIRE(2u == wcount);
+
+  SECTION("truncated") {
+    for (size_t len = 0; len < wend; ++len) {
+      REQUIRE(!Program::unmarshall(buf.data(), len));
+    }
+  }
+
+  SECTION("tooManyWindows") {
+    const uint32_t wcount = 0x10000000;
+    std::memcpy(buf.data() + wbeg, &wcount, sizeof(wcount));
+    REQUIRE(!Program::unmarshall(buf.data(), buf.size()));
+  }
+
+  SECTION("tableTooLong") {
+    // the table size of the first window is the last of its five fields
+    const uint32_t tsize = 0x20000000;
+    std::memcpy(buf.data() + wbeg + 4 + 4*4, &tsize, sizeof(tsize));
+    REQUIRE(!Program::unmarshall(buf.data(), buf.size()));
+  }
+
+  SECTION("tableTooShortForShift") {
+    // hash four-byte keys into twice as many bits as the table holds
+    const uint32_t shift = 15;
+    const size_t gbeg = wbeg + 4 + 5*4 + pw.Table.size()*sizeof(uint64_t);
+    std::memcpy(buf.data() + gbeg + 3*4, &shift, sizeof(shift));
+    REQUIRE(!Program::unmarshall(buf.data(), buf.size()));
+  }
+
+  SECTION("partialInstruction") {
+    REQUIRE(!Program::unmarshall(buf.data(), buf.size() - 1));
+  }
+}
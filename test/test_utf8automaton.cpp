@@ -0,0 +1,115 @@
+/*
+ * Copyright 2024 Aon Cyber Solutions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <catch2/catch_test_macros.hpp>
+
+#include <random>
+#include <set>
+#include <string>
+
+#include "utf8automaton.h"
+#include "encoders/utf8.h"
+
+namespace {
+  // Every byte string the automaton accepts, checking on the way that the
+  // vertices leaving each one take disjoint bytes
+  void language(const UTF8Automaton& a, const std::vector<uint32_t>& vs, std::string& prefix, std::set<std::string>& lang) {
+    ByteSet seen;
+    for (const uint32_t v : vs) {
+      const UTF8Automaton::Vertex& vert = a.Vertices[v];
+      REQUIRE((seen & vert.Bytes).none());
+      seen |= vert.Bytes;
+
+      for (uint32_t b = 0; b < 256; ++b) {
+        if (vert.Bytes[b]) {
+          prefix.push_back(b);
+          if (vert.Final) {
+            REQUIRE(vert.Next.empty());
+            lang.insert(prefix);
+          }
+          language(a, vert.Next, prefix, lang);
+          prefix.pop_back();
+        }
+      }
+    }
+  }
+
+  void checkLanguage(const UnicodeSet& uset) {
+    const UTF8 enc;
+    const UnicodeSet valid(uset & enc.validCodePoints());
+
+    std::set<std::string> expected;
+    byte buf[4];
+    for (const UnicodeSet::range r : valid) {
+      for (uint32_t cp = r.first; cp < r.second; ++cp) {
+        expected.emplace(reinterpret_cast<const char*>(buf), enc.write(cp, buf));
+      }
+    }
+
+    const UTF8Automaton a(valid);
+    std::set<std::string> actual;
+    std::string prefix;
+    language(a, a.Heads, prefix, actual);
+    REQUIRE(expected == actual);
+
+    // successors come first
+    for (uint32_t v = 0; v < a.Vertices.size(); ++v) {
+      for (const uint32_t w : a.Vertices[v].Next) {
+        REQUIRE(w < v);
+      }
+    }
+  }
+}
+
+TEST_CASE("utf8AutomatonAny") {
+  const UTF8Automaton a(UnicodeSet{{0, 0xD800}, {0xE000, 0x110000}});
+
+  // one head per distinct lead byte range, and the continuation bytes
+  // shared by all of them
+  REQUIRE(8u == a.Heads.size());
+  REQUIRE(15u == a.Vertices.size());
+  REQUIRE(a.Heads.front() == a.Single);
+  REQUIRE(ByteSet({{0x00, 0x80}}) == a.Vertices[a.Single].Bytes);
+
+  checkLanguage(UnicodeSet{{0, 0xD800}, {0xE000, 0x110000}});
+}
+
+TEST_CASE("utf8AutomatonNoSingle") {
+  const UTF8Automaton a(UnicodeSet{{0x80, 0x100}});
+  REQUIRE(UTF8Automaton::NONE == a.Single);
+
+  // C2 and C3 take the same continuation bytes
+  REQUIRE(1u == a.Heads.size());
+  REQUIRE(ByteSet({0xC2, 0xC3}) == a.Vertices[a.Heads[0]].Bytes);
+  checkLanguage(UnicodeSet{{0x80, 0x100}});
+}
+
+TEST_CASE("utf8AutomatonLanguage") {
+  // range boundaries at each encoding length and continuation byte
+  checkLanguage(UnicodeSet{0x7F, 0x80, 0x7FF, 0x800, 0xFFFF, 0x10000, 0x10FFFF});
+  checkLanguage(UnicodeSet{{0x3F, 0x41}, {0xFBF, 0x1041}, {0x3FFFF, 0x40041}});
+
+  std::mt19937 gen(46);
+  std::uniform_int_distribution<uint32_t> cps(0, 0x10FFFF), lens(1, 300);
+  for (uint32_t i = 0; i < 20; ++i) {
+    UnicodeSet s;
+    for (uint32_t j = 0; j < 30; ++j) {
+      const uint32_t l = i < 10 ? cps(gen) % 0x3000 : cps(gen);
+      s.insert(l, std::min(l + lens(gen), 0x110000u));
+    }
+    checkLanguage(s);
+  }
+}
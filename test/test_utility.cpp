@@ -20,13 +20,16 @@
 #include <iostream>
 #include <fstream>
 #include <functional>
+#include <random>
 #include <sstream>
 
 #include "lightgrep/encodings.h"
 
 #include "codegen.h"
 #include "compiler.h"
+#include "fsmthingy.h"
 #include "nfaoptimizer.h"
+#include "parser.h"
 #include "states.h"
 #include "mockcallback.h"
 #include "vm_interface.h"
@@ -373,3 +376,153 @@ TEST_CASE("testMaxOutbound") {
   std::vector<std::vector<NFA::VertexDescriptor>> tbl = pivotStates(0, fsm);
   REQUIRE(2u == maxOutbound(tbl));
 }
+
+TEST_CASE("analyzePatternUsesOnlyItsOwnSubgraph") {
+  const std::vector<Pattern> pats{
+    {"ab+c", false, false, false, "ASCII"},
+    {"a(b|x)+", false, false, false, "ASCII"},
+    {"zz", false, false, false, "ASCII"}
+  };
+
+  // analysis happens on the merged graph, before finalization
+  FSMThingy fsm(0);
+  ParseTree tree;
+  for (uint32_t i = 0; i < pats.size(); ++i) {
+    parseAndReduce(pats[i], tree);
+    fsm.addPattern(tree, pats[i].Encoding.c_str(), i);
+  }
+
+  const NFA& g = *fsm.Fsm;
+
+  const PatternStats abc = analyzePattern(g, 0);
+  REQUIRE(1u == abc.Loops);
+  REQUIRE(3u == abc.MinLength);
+  REQUIRE(1u == abc.FilterPairs);
+  REQUIRE(1u == abc.MaxFanOut);
+
+  const PatternStats abx = analyzePattern(g, 1);
+  REQUIRE(1u == abx.Loops);
+  REQUIRE(2u == abx.MinLength);
+  REQUIRE(2u == abx.FilterPairs);
+
+  const PatternStats zz = analyzePattern(g, 2);
+  REQUIRE(0u == zz.Loops);
+  REQUIRE(2u == zz.MinLength);
+  REQUIRE(1u == zz.FilterPairs);
+  REQUIRE(1u == zz.MaxFanOut);
+
+  REQUIRE_THROWS(analyzePattern(g, 3));
+}
+
+TEST_CASE("filterWindowsForSaturatedPairs") {
+  // enough words that the best single pair window admits most pairs of
+  // lowercase letters
+  std::mt19937 rng(1);
+  std::vector<std::string> words;
+  for (uint32_t i = 0; i < 500; ++i) {
+    std::string w;
+    for (uint32_t j = 0, len = 5 + rng() % 4; j < len; ++j) {
+      w += 'a' + rng() % 26;
+    }
+    words.push_back(w);
+  }
+
+  FSMThingy fsm(0);
+  ParseTree tree;
+  for (uint32_t i = 0; i < words.size(); ++i) {
+    parseAndReduce(Pattern(words[i], true), tree);
+    fsm.addPattern(tree, "ASCII", i);
+  }
+
+  const NFA& g = *fsm.Fsm;
+
+  const std::vector<std::bitset<256*256>> pairs(pairWindows(g));
+  REQUIRE(5u == pairs.size());
+
+  const std::pair<uint32_t,std::bitset<256*256>> primary(bestPair(pairs));
+  REQUIRE(primary.second.count() > 300);
+
+  const std::vector<FilterWindow> windows(filterWindows(g, pairs, primary.first));
+  REQUIRE(!windows.empty());
+  REQUIRE(windows.size() <= 3);
+
+  // hashed 4-gram windows beat pairs of letters on letters
+  REQUIRE(4u == windows.front().Width);
+
+  // no false negatives
+  for (const std::string& w : words) {
+    for (const FilterWindow& fw : windows) {
+      REQUIRE(fw.admits(reinterpret_cast<const byte*>(w.data())));
+    }
+  }
+
+  // but most other words are rejected
+  uint32_t admitted = 0;
+  for (uint32_t i = 0; i < 1000; ++i) {
+    std::string w;
+    for (uint32_t j = 0; j < 8; ++j) {
+      w += 'a' + rng() % 26;
+    }
+
+    const byte* b = reinterpret_cast<const byte*>(w.data());
+    if (std::all_of(windows.begin(), windows.end(),
+          [b](const FilterWindow& fw) { return fw.admits(b); }))
+    {
+      ++admitted;
+    }
+  }
+  REQUIRE(admitted < 50);
+}
+
+TEST_CASE("noFilterWindowsWhenPrimaryIsSelective") {
+  FSMThingy fsm(0);
+  ParseTree tree;
+  parseAndReduce(Pattern("abcdef", true), tree);
+  fsm.addPattern(tree, "ASCII", 0);
+
+  const std::vector<std::bitset<256*256>> pairs(pairWindows(*fsm.Fsm));
+  REQUIRE(filterWindows(*fsm.Fsm, pairs, bestPair(pairs).first).empty());
+}
+
+TEST_CASE("widePairsSkipZeroBytes") {
+  NFAPtr fsm = createGraph({Pattern("ab", true, false, false, "UTF-16LE")}, true);
+  const NFA& g = *fsm;
+
+  // the best adjacent pair is half zero byte
+  const std::pair<uint32_t,std::bitset<256*256>> primary(bestPair(pairWindows(g)));
+  REQUIRE(zeroPadded(primary.second));
+
+  // the bytes two apart are a and b
+  const std::vector<std::bitset<256*256>> wide(pairWindows(g, 2));
+  REQUIRE(4u == wide.size());
+  REQUIRE(zeroPadded(wide[1]));
+
+  std::bitset<256*256> exp;
+  exp.set('a' | ('b' << 8));
+  REQUIRE(std::make_pair(0u, exp) == bestWidePair(wide));
+
+  // which the compiler uses as the primary filter
+  ProgramPtr prog = Compiler::createProgram(g);
+  REQUIRE(2u == prog->FilterStride);
+  REQUIRE(0u == prog->FilterOff);
+  REQUIRE(exp == prog->Filter);
+}
+
+TEST_CASE("narrowPairsAreNotZeroPadded") {
+  NFAPtr fsm = createGraph({"ab", "\\x00c"}, true);
+  REQUIRE(!zeroPadded(bestPair(*fsm).second));
+
+  ProgramPtr prog = Compiler::createProgram(*fsm);
+  REQUIRE(1u == prog->FilterStride);
+}
+
+TEST_CASE("shortWidePatternsKeepZeroPaddedPairs") {
+  // one character leaves the byte two on free, so pairing across the
+  // zero would admit 256 times the pairs
+  NFAPtr fsm = createGraph({Pattern("\\d", false, false, false, "UTF-16LE")}, true);
+  REQUIRE(zeroPadded(bestPair(*fsm).second));
+
+  ProgramPtr prog = Compiler::createProgram(*fsm);
+  REQUIRE(1u == prog->FilterStride);
+  REQUIRE(10u == prog->Filter.count());
+}
@@ -18,10 +18,15 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include "byteset.h"
+#include "compiler.h"
+#include "fsmthingy.h"
 #include "vm.h"
 #include "mockcallback.h"
+#include "parser.h"
+#include "pattern.h"
 #include "program.h"
 
+#include <algorithm>
 #include <iostream>
 
 TEST_CASE("executeByte") {
@@ -573,3 +578,199 @@ TEST_CASE("stitchedText") {
   REQUIRE(1u == hits.size());
   REQUIRE(SearchHit(2, 4, 0) == hits[0]);
 }
+
+TEST_CASE("dedupThreadsBoundsActive") {
+  ParseTree tree;
+  parseAndReduce(Pattern("(a|aa)+b"), tree);
+
+  FSMThingy fsm(0);
+  fsm.addPattern(tree, "ASCII", 0);
+  fsm.finalizeGraph(0);
+  ProgramPtr p = Compiler::createProgram(*fsm.Fsm);
+
+  const std::string text = std::string(500, 'a') + 'b';
+  const byte* const beg = reinterpret_cast<const byte*>(text.data());
+
+  std::vector<SearchHit> expected, actual;
+  uint32_t maxActive = 0;
+
+  Vm plain(p);
+  for (uint64_t i = 0; i < text.size(); ++i) {
+    plain.executeFrame(beg + i, i, &mockCallback, &expected);
+    plain.cleanup();
+    maxActive = std::max(maxActive, plain.numActive());
+  }
+  plain.closeOut(&mockCallback, &expected);
+
+  // without dedup, every start offset keeps at least one thread
+  REQUIRE(maxActive >= 500u);
+
+  Vm dedup(p);
+  dedup.setDedupThreads(true);
+  maxActive = 0;
+  for (uint64_t i = 0; i < text.size(); ++i) {
+    dedup.executeFrame(beg + i, i, &mockCallback, &actual);
+    dedup.cleanup();
+    maxActive = std::max(maxActive, dedup.numActive());
+  }
+  dedup.closeOut(&mockCallback, &actual);
+
+  REQUIRE(maxActive <= p->size());
+  REQUIRE(maxActive < 10u);
+
+  REQUIRE(1u == expected.size());
+  REQUIRE(SearchHit(0, 501, 0) == expected[0]);
+  REQUIRE(expected == actual);
+}
+
+TEST_CASE("dedupThreadsLocksEveryLabelAtAPC") {
+  // two labels which share the code for ".+b" after their first byte, so
+  // threads for both meet at the same PCs
+  ProgramPtr p(new Program(15, Instruction::makeRaw32(0)));
+  Program&   prog(*p);
+  prog[0]  = Instruction::makeAny();
+  prog[1]  = Instruction::makeFork(&prog[1], 6);
+  prog[3]  = Instruction::makeLabel(0);
+  prog[4]  = Instruction::makeJump(&prog[4], 7);
+  prog[6]  = Instruction::makeLabel(1);
+  prog[7]  = Instruction::makeAny();
+  prog[8]  = Instruction::makeFork(&prog[8], 7);
+  prog[10] = Instruction::makeByte('b');
+  prog[11] = Instruction::makeMatch();
+  prog[12] = Instruction::makeFinish();
+  prog[13] = Instruction::makeHalt();
+  prog[14] = Instruction::makeFinish();
+
+  prog.MaxLabel = 1;
+  prog.MaxCheck = 0;
+
+  prog.FilterOff = 0;
+  for (uint32_t i = 0; i < 256*256; ++i) {
+    prog.Filter.set(i);
+  }
+
+  const std::string text = std::string(500, 'a') + 'b';
+  const byte* const beg = reinterpret_cast<const byte*>(text.data());
+
+  std::vector<SearchHit> expected, actual;
+
+  Vm plain(p);
+  for (uint64_t i = 0; i < text.size(); ++i) {
+    plain.executeFrame(beg + i, i, &mockCallback, &expected);
+    plain.cleanup();
+  }
+  plain.closeOut(&mockCallback, &expected);
+
+  Vm dedup(p);
+  dedup.setDedupThreads(true);
+  uint32_t maxActive = 0;
+  for (uint64_t i = 0; i < text.size(); ++i) {
+    dedup.executeFrame(beg + i, i, &mockCallback, &actual);
+    dedup.cleanup();
+    maxActive = std::max(maxActive, dedup.numActive());
+  }
+  dedup.closeOut(&mockCallback, &actual);
+
+  // one thread per label at each PC
+  REQUIRE(maxActive < 10u);
+
+  REQUIRE(2u == expected.size());
+  REQUIRE(expected == actual);
+}
+
+TEST_CASE("maxThreadsShedsLowestPriority") {
+  ParseTree tree;
+  parseAndReduce(Pattern("(a|aa)+b"), tree);
+
+  FSMThingy fsm(0);
+  fsm.addPattern(tree, "ASCII", 0);
+  fsm.finalizeGraph(0);
+  ProgramPtr p = Compiler::createProgram(*fsm.Fsm);
+
+  const std::string text = std::string(500, 'a') + 'b' + "aab";
+  const byte* const beg = reinterpret_cast<const byte*>(text.data());
+
+  Vm v(p);
+  v.setMaxThreads(16);
+
+  std::vector<SearchHit> hits;
+  uint32_t maxActive = 0;
+  for (uint64_t i = 0; i < text.size(); ++i) {
+    v.executeFrame(beg + i, i, &mockCallback, &hits);
+    v.cleanup();
+    maxActive = std::max(maxActive, v.numActive());
+  }
+  v.closeOut(&mockCallback, &hits);
+
+  REQUIRE(maxActive <= 16u);
+  REQUIRE(v.droppedThreads() > 0u);
+
+  // the oldest thread survives, and the search recovers after the run
+  REQUIRE(2u == hits.size());
+  REQUIRE(SearchHit(0, 501, 0) == hits[0]);
+  REQUIRE(SearchHit(501, 504, 0) == hits[1]);
+
+  v.reset();
+  REQUIRE(0u == v.droppedThreads());
+}
+
+TEST_CASE("maxThreadsKeepsThreadsHoldingMatches") {
+  // "za*" matches on the 'z' while the older "(a|aa|z)+b" threads use up the
+  // budget, and must still report its match once it stops extending
+  FSMThingy fsm(0);
+  uint32_t label = 0;
+  for (const char* pat: {"(a|aa|z)+b", "za*"}) {
+    ParseTree tree;
+    parseAndReduce(Pattern(pat), tree);
+    fsm.addPattern(tree, "ASCII", label++);
+  }
+  fsm.finalizeGraph(0);
+  ProgramPtr p = Compiler::createProgram(*fsm.Fsm);
+
+  const std::string text = std::string(100, 'a') + 'z' + std::string(400, 'a') + 'b';
+  const byte* const beg = reinterpret_cast<const byte*>(text.data());
+
+  Vm v(p);
+  v.setMaxThreads(16);
+
+  std::vector<SearchHit> hits;
+  for (uint64_t i = 0; i < text.size(); ++i) {
+    v.executeFrame(beg + i, i, &mockCallback, &hits);
+    v.cleanup();
+  }
+  v.closeOut(&mockCallback, &hits);
+
+  REQUIRE(v.droppedThreads() > 0u);
+
+  std::sort(hits.begin(), hits.end());
+  REQUIRE(2u == hits.size());
+  REQUIRE(SearchHit(0, 502, 0) == hits[0]);
+  REQUIRE(SearchHit(100, 501, 1) == hits[1]);
+}
+
+TEST_CASE("maxThreadsSparesAnchoredThreads") {
+  // a budget of one leaves no room for the "a+b" thread behind the
+  // "(a|aa)+c" one, and dropping it would lose its hit, as nothing else
+  // starts at offset 0
+  FSMThingy fsm(0);
+  uint32_t label = 0;
+  for (const char* pat: {"(a|aa)+c", "a+b"}) {
+    ParseTree tree;
+    parseAndReduce(Pattern(pat), tree);
+    fsm.addPattern(tree, "ASCII", label++);
+  }
+  fsm.finalizeGraph(0);
+  ProgramPtr p = Compiler::createProgram(*fsm.Fsm);
+
+  const std::string text = std::string(50, 'a') + 'b';
+  const byte* const beg = reinterpret_cast<const byte*>(text.data());
+
+  Vm v(p);
+  v.setMaxThreads(1);
+
+  std::vector<SearchHit> hits;
+  v.startsWith(beg, beg + text.size(), 0, &mockCallback, &hits);
+
+  REQUIRE(1u == hits.size());
+  REQUIRE(SearchHit(0, 51, 1) == hits[0]);
+}